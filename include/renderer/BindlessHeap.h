@@ -0,0 +1,107 @@
+#pragma once
+
+#include <StarryManager.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <array>
+#include <vector>
+
+#include "DescriptorSet.h"
+
+#define BINDLESS_DEFAULT_TEXTURES 16384
+#define BINDLESS_DEFAULT_BUFFERS 4096
+
+namespace Render
+{
+	class Device;
+
+	struct BindlessConfig
+	{
+		bool enabled = false; // Needs Vulkan 1.2 descriptor indexing
+		uint32_t maxTextures = BINDLESS_DEFAULT_TEXTURES; // Clamped to the device's update after bind limits
+		uint32_t maxBuffers = BINDLESS_DEFAULT_BUFFERS;
+	};
+
+	/*
+		Every texture and buffer in two large descriptor arrays, bound once per layout
+		per frame at set 0 instead of one descriptor set per draw:
+			binding 0: sampler2D textures[], binding 1: storage buffers[]
+		TextureAtlas slots hold 2D array views, shaders read them through the sampler2DArray
+		alias of binding 0 in bindless.glsl.
+
+		Resources register themselves when they are created and keep their index in
+		DescriptorResource::getBindlessIndex(). Draws pick them by index, e.g. through
+		the sub-buffer material index (gl_InstanceIndex) or a push constant.
+
+		Each frame in flight has its own set. Changes are written into a frame's set
+		the next time it is recorded, when that frame's fence has already been waited on.
+	*/
+	class BindlessHeap : public Manager::StarryAsset
+	{
+		struct TextureSlot
+		{
+			VkDescriptorImageInfo info{};
+			uint32_t dirtyFrames = 0;
+		};
+
+		struct BufferSlot
+		{
+			std::array<VkDescriptorBufferInfo, MAX_FRAMES_IN_FLIGHT> info{};
+			uint32_t dirtyFrames = 0;
+		};
+
+		public:
+			BindlessHeap();
+			~BindlessHeap();
+
+			void init(Device* device, BindlessConfig config);
+			void destroy();
+
+			bool isActive() { return device != nullptr; }
+
+			uint32_t addTexture(VkImageView imageView, VkSampler sampler); // BINDLESS_INVALID_INDEX when full
+			void updateTexture(uint32_t index, VkImageView imageView, VkSampler sampler);
+			void removeTexture(uint32_t index);
+
+			// One buffer per frame in flight, e.g. a Uniform's, offsets default to 0
+			uint32_t addBuffer(const VkBuffer* frameBuffers, VkDeviceSize range, const VkDeviceSize* frameOffsets = nullptr);
+			void removeBuffer(uint32_t index);
+
+			uint32_t getTextureCapacity() { return static_cast<uint32_t>(textures.size()); }
+			uint32_t getBufferCapacity() { return static_cast<uint32_t>(buffers.size()); }
+
+			VkDescriptorSetLayout& getDescriptorSetLayout() { return descriptorSetLayout; }
+
+			void record(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t frame, uint32_t set = 0);
+
+			ASSET_NAME("Bindless Heap")
+		private:
+			void clampToLimits();
+			void createDescriptorSetLayout();
+			void createDescriptorSets();
+
+			void flush(uint32_t frame);
+
+			static uint32_t allocate(std::vector<uint32_t>& freeSlots, uint32_t& used, uint32_t capacity);
+
+			BindlessConfig config{};
+
+			std::vector<TextureSlot> textures;
+			std::vector<uint32_t> freeTextures;
+			std::vector<uint32_t> dirtyTextures;
+			uint32_t usedTextures = 0;
+
+			std::vector<BufferSlot> buffers;
+			std::vector<uint32_t> freeBuffers;
+			std::vector<uint32_t> dirtyBuffers;
+			uint32_t usedBuffers = 0;
+
+			VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+			VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+			std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> descriptorSets{};
+
+			Device* device = nullptr; // Owner
+	};
+}
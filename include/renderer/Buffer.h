@@ -10,10 +10,14 @@
 #include <vector>
 #include <array>
 #include <map>
+#include <memory>
+#include <string>
 
 #include <StarryManager.h>
 
 #include "VertexBufferData.h"
+#include "Meshlet.h"
+#include "MeshFile.h"
 
 // Helpful debug colors
 #define RED_COLOR glm::vec3(1.0f, 0.0f, 0.0f)
@@ -40,15 +44,31 @@ namespace Render
 			void loadData(VertexBufferData& data);
 			void removeData(size_t id);
 
-			void finalize();
+			// Mesh files are mapped at finalize and streamed straight into staging memory
+			void loadFile(const std::string& path);
+			void removeFile(const std::string& path);
 
-			size_t getNumVertices() { return vertices.empty() ? 0 : vertices.size(); }
-			size_t getNumIndices() { return indices.empty() ? 0 : indices.size(); }
+			void finalize(bool buildMeshlets = false);
+
+			size_t getNumVertices() { return fileVertexCount + vertices.size(); }
+			size_t getNumIndices() { return fileIndexCount + indices.size(); }
 
 			uint32_t bind(VkCommandBuffer commandBuffer);
 			
 			uint32_t getNumberSubBuffers() { return offsets[0].size(); }
 			void recordSubBuffer(VkCommandBuffer commandBuffer, uint32_t index);
+			uint32_t getMaterialIndex(uint32_t index) { return materials[index]; }
+
+			bool hasMeshlets() { return !meshletData.meshlets.empty(); }
+			uint32_t getNumMeshlets() { return static_cast<uint32_t>(meshletData.meshlets.size()); }
+			uint32_t getMeshletOffset(uint32_t index) { return meshletOffsets[index]; }
+			uint32_t getMeshletCount(uint32_t index) { return meshletCounts[index]; }
+
+			VkBuffer& getVertexBuffer() { return buffer; }
+			VkDeviceSize getVertexBufferSize() { return bufferSizeVertex; }
+			VkBuffer& getMeshletBuffer() { return meshletBuffer; }
+			VkBuffer& getMeshletVertexBuffer() { return meshletVertexBuffer; }
+			VkBuffer& getMeshletTriangleBuffer() { return meshletTriangleBuffer; }
 
 			virtual ASSET_NAME("Buffer")
 
@@ -63,12 +83,29 @@ namespace Render
 			void fillBufferData(VkDeviceMemory& bufferMemory);
 			void fillIndexBufferData(VkDeviceMemory& bufferMemory);
 
+			void appendSubBuffer(std::vector<Vertex>& subVertices, std::vector<uint32_t>& subIndices, uint32_t material = 0);
+			void openMeshFiles();
+
+			void createMeshletBuffers();
+			void destroyMeshletBuffers();
+
 			std::map<size_t, VertexBufferData> bufferData;
+
+			std::vector<std::string> meshFilePaths;
+			std::vector<std::unique_ptr<MeshFile>> meshFiles; // Mapped only between finalize and upload
+			size_t fileVertexCount = 0;
+			size_t fileIndexCount = 0;
 			
 			std::vector<Vertex> vertices;
 			std::vector<uint32_t> indices;
 			std::array<std::vector<uint32_t>, 2> offsets;
 			std::array<std::vector<uint32_t>, 2> sizes;
+			std::vector<uint32_t> materials; // firstInstance of each sub-buffer
+
+			bool useMeshlets = false;
+			MeshletData meshletData;
+			std::vector<uint32_t> meshletOffsets;
+			std::vector<uint32_t> meshletCounts;
 
 			VkBuffer stagingBufferVertex = VK_NULL_HANDLE;
 			VkDeviceMemory stagingBufferMemoryVertex = VK_NULL_HANDLE;
@@ -81,6 +118,13 @@ namespace Render
 			VkBuffer indexBuffer = VK_NULL_HANDLE;
 			VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
 
+			VkBuffer meshletBuffer = VK_NULL_HANDLE;
+			VkDeviceMemory meshletBufferMemory = VK_NULL_HANDLE;
+			VkBuffer meshletVertexBuffer = VK_NULL_HANDLE;
+			VkDeviceMemory meshletVertexBufferMemory = VK_NULL_HANDLE;
+			VkBuffer meshletTriangleBuffer = VK_NULL_HANDLE;
+			VkDeviceMemory meshletTriangleBufferMemory = VK_NULL_HANDLE;
+
 			VkDeviceSize bufferSizeVertex = 0;
 			VkDeviceSize bufferSizeIndex = 0;
 
@@ -55,6 +55,7 @@ namespace Render
             std::atomic<int> drawStage = 0;
 
             ImGui_ImplVulkan_InitInfo guiInfo{};
+            VkFormat guiColorFormat = VK_FORMAT_UNDEFINED; // Pointed to by guiInfo with dynamic rendering
             ImDrawData* drawData = nullptr;
 
             Manager::ResourceHandle<Device> device;
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <StarryManager.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <map>
+#include <vector>
+
+#define DESCRIPTOR_POOL_INITIAL_SETS 64
+#define DESCRIPTOR_POOL_MAX_SETS 4096
+
+namespace Render
+{
+	class Device;
+
+	/*
+		Hands out descriptor sets from a chain of pools. When the current pool runs out
+		a new one is created, each twice the size of the last up to DESCRIPTOR_POOL_MAX_SETS,
+		with its descriptor counts taken from the average set allocated so far.
+
+		Freed sets are kept per layout and handed out again once no frame in flight can
+		still use them, pools themselves are never freed until destroy.
+	*/
+	class DescriptorAllocator : public Manager::StarryAsset
+	{
+		struct RetiredSet
+		{
+			VkDescriptorSetLayout layout;
+			VkDescriptorSet set;
+			uint32_t framesLeft;
+		};
+
+		public:
+			DescriptorAllocator();
+			~DescriptorAllocator();
+
+			void init(Device* device);
+			void destroy();
+
+			bool isActive() { return device != nullptr; }
+
+			// Descriptor counts one set of this layout needs, used to size new pools
+			void registerLayout(VkDescriptorSetLayout layout, const std::vector<VkDescriptorPoolSize>& perSet);
+
+			bool allocate(VkDescriptorSetLayout layout, uint32_t count, VkDescriptorSet* sets);
+			void free(VkDescriptorSetLayout layout, uint32_t count, const VkDescriptorSet* sets);
+
+			// After the frame's fence was waited on
+			void advanceFrame();
+
+			uint32_t getPoolCount() { return static_cast<uint32_t>(pools.size()); }
+			uint64_t getLiveSets() { return liveSets; }
+
+			ASSET_NAME("Descriptor Allocator")
+		private:
+			bool createPool(VkDescriptorSetLayout layout, uint32_t count);
+			VkResult allocateFromPool(VkDescriptorSetLayout layout, uint32_t count, VkDescriptorSet* sets);
+
+			std::vector<VkDescriptorPool> pools;
+			uint32_t currentPoolSets = 0;
+
+			std::map<VkDescriptorSetLayout, std::vector<VkDescriptorPoolSize>> layouts;
+			std::map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>> freeSets;
+			std::vector<RetiredSet> retired;
+
+			// Observed usage
+			std::map<VkDescriptorType, uint64_t> allocatedDescriptors;
+			uint64_t allocatedSets = 0;
+			uint64_t liveSets = 0;
+
+			Device* device = nullptr; // Owner
+	};
+}
@@ -7,6 +7,8 @@
 
 #include <vector>
 
+#define BINDLESS_INVALID_INDEX UINT32_MAX
+
 namespace Render
 {
     class DescriptorResource
@@ -19,6 +21,36 @@ namespace Render
             virtual void destroy() = 0;
             
             virtual VkWriteDescriptorSet createWrite(int frame, VkDescriptorSet& descriptorSet) = 0; // to bind
-            virtual void update(int frame) {}
+            virtual void update(int frame) {} // Only called for frames marked dirty
+
+            // Offset passed to vkCmdBindDescriptorSets for dynamic descriptors, false when not dynamic
+            virtual bool getDynamicOffset(int frame, uint32_t& offset) { return false; }
+
+            // Every frame's copy is stale, update() runs once for each frame the next time it is bound
+            void markDirty() { dirtyFrames = ~0u; }
+            bool consumeDirty(int frame) { return consumeFrame(dirtyFrames, frame); }
+
+            // Every set holding this resource calls createWrite again for each frame the next time it is bound,
+            // e.g. after a new image view. Sets compare against the generation they last wrote, nothing is cleared
+            void requestRewrite() { writeGeneration++; }
+            uint32_t getWriteGeneration() { return writeGeneration; }
+
+            // Slot in the device's BindlessHeap, BINDLESS_INVALID_INDEX when not registered
+            uint32_t getBindlessIndex() { return bindlessIndex; }
+
+        protected:
+            uint32_t bindlessIndex = BINDLESS_INVALID_INDEX;
+
+        private:
+            static bool consumeFrame(uint32_t& frames, int frame)
+            {
+                uint32_t bit = 1u << frame;
+                bool requested = frames & bit;
+                frames &= ~bit;
+                return requested;
+            }
+
+            uint32_t dirtyFrames = 0;
+            uint32_t writeGeneration = 0;
     };
 }
\ No newline at end of file
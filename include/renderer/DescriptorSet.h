@@ -8,7 +8,6 @@
 #include <vector>
 
 #define MAX_FRAMES_IN_FLIGHT 2
-#define MAX_OBJECTS 64
 
 #include "DescriptorResource.h"
 
@@ -26,7 +25,8 @@ namespace Render
 
             void destroy();
 
-            void create(VkDescriptorSetAllocateInfo allocInfo);
+            void create(VkDescriptorSetLayout layout); // Returns any previous sets to the device's allocator first
+            void release();
             void clear();
 
             std::vector<VkWriteDescriptorSet> getInfo(int frame);
@@ -34,16 +34,23 @@ namespace Render
             void addDescriptorResource(std::weak_ptr<DescriptorResource>& descriptorResource);
 		    VkDescriptorSet& getDescriptorSet(uint32_t frame);
 
-            void record(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t frame);
+            void updateResources(uint32_t frame); // Without binding, for resources read through the BindlessHeap
+
+            // Dynamic descriptors in the order their resources were added
+            std::vector<uint32_t> getDynamicOffsets(uint32_t frame);
+
+            // Without explicit offsets the resources' own getDynamicOffset() are used
+            void record(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t frame, uint32_t set = 0,
+                const uint32_t* dynamicOffsets = nullptr, uint32_t dynamicOffsetCount = 0);
 
             virtual ASSET_NAME("Descriptor Set")
         protected:
 		    std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> descriptorSets;
+            VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
 
             Manager::ResourceHandle<Device> device;
 
             std::vector<std::weak_ptr<DescriptorResource>> descriptorResources;
-
-            static int amountOfObjects;
+            std::vector<std::array<uint32_t, MAX_FRAMES_IN_FLIGHT>> writtenGenerations; // Per resource and frame
     };
 }
\ No newline at end of file
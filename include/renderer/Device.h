@@ -16,6 +16,16 @@
 #include "Uniform.h"
 #include "TextureImage.h"
 #include "DescriptorSet.h"
+#include "TextureStreamer.h"
+#include "BindlessHeap.h"
+#include "DescriptorAllocator.h"
+#include "UniformRing.h"
+#include "FrameGlobals.h"
+#include "SamplerCache.h"
+#include "TextureCache.h"
+#include "ShaderCache.h"
+#include "PipelineCache.h"
+#include "ShaderWatcher.h"
 
 #include "Canvas.h"
 
@@ -44,6 +54,36 @@ namespace Render
 		std::weak_ptr<Window> window;
 
 		std::vector<DescriptorSetReservation> descriptorSetReservations;
+
+		TextureStreamerConfig textureStreaming{};
+		BindlessConfig bindless{};
+		TextureCacheConfig textureCache{};
+		PipelineCacheConfig pipelineCache{};
+
+		// Per frame in flight, used when a reservation is UNIFORM_BUFFER_DYNAMIC
+		VkDeviceSize uniformRingSize = UNIFORM_RING_DEFAULT_SIZE;
+
+		// Watch loaded SPIR-V and rebuild pipelines in the background when it changes
+		bool shaderHotReload = false;
+
+		// Begin rendering with attachments given directly where VK_KHR_dynamic_rendering is supported,
+		// no VkRenderPass or per image VkFramebuffer
+		bool dynamicRendering = true;
+	};
+
+	struct DeviceFeatures
+	{
+		bool meshShader = false;
+		bool drawIndirectCount = false;
+		bool multiDrawIndirect = false;
+		bool textureCompressionBC = false;
+		bool descriptorIndexing = false; // Update after bind, partially bound, non-uniform indexed sampled images and storage buffers
+		bool graphicsPipelineLibrary = false;
+		bool extendedDynamicState = false; // Cull mode, front face, topology within a class, depth test/write/compare
+		bool extendedDynamicState3 = false; // Polygon mode, color blend enable and equation
+		bool synchronization2 = false; // RenderGraph barriers, vkCmdPipelineBarrier otherwise
+		bool dynamicRendering = false; // Only when DeviceConfig::dynamicRendering asks for it
+		bool occlusionQueryPrecise = false; // Sample counts rather than any non-zero value
 	};
 
 	struct DrawInfo
@@ -53,6 +93,8 @@ namespace Render
 
 		VkCommandBuffer currentCommandBuffer = VK_NULL_HANDLE;
 
+		bool depthPrepass = false; // Set once the pre-pass ran, the main pass keeps its depth
+
 		operator VkCommandBuffer() { return currentCommandBuffer; }
 	};
 
@@ -82,20 +124,36 @@ namespace Render
 		uint32_t getCurrentFrame();
 
 		DeviceConfig& getConfig() { return m_config; }
+		DeviceFeatures& getFeatures() { return m_features; }
+		VkPhysicalDeviceProperties& getProperties() { return m_properties; }
+		TextureStreamer& getTextureStreamer() { return m_textureStreamer; }
+		BindlessHeap& getBindlessHeap() { return m_bindlessHeap; }
+		DescriptorAllocator& getDescriptorAllocator() { return m_descriptorAllocator; }
+		UniformRing& getUniformRing() { return m_uniformRing; }
+		FrameGlobals& getFrameGlobals() { return m_frameGlobals; }
+		SamplerCache& getSamplerCache() { return m_samplerCache; }
+		TextureCache& getTextureCache() { return m_textureCache; }
+		ShaderCache& getShaderCache() { return m_shaderCache; }
+		PipelineCache& getPipelineCache() { return m_pipelineCache; }
+		ShaderWatcher& getShaderWatcher() { return m_shaderWatcher; }
+
+		bool isExtensionEnabled(const char* extension);
 
 		void init(DeviceConfig config);
 		void destroy();
 
 		void beginFrame(DrawInfo& info);
 		void startSwapChainRenderPass(DrawInfo& info);
+		void startDepthPrepass(DrawInfo& info); // Clears and writes only the depth buffer
 
-		void endSwapChainRenderPass(DrawInfo& info);
+		void endSwapChainRenderPass(DrawInfo& info); // Ends either pass
 		void endFrame(DrawInfo& info);
 
 		void waitIdle();
 
 		void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
 		void copyBuffer(VkBuffer& srcBuffer, VkBuffer& dstBuffer, VkDeviceSize size);
+		void uploadBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
 		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
 		VkCommandBuffer beginSingleTimeCommands();
@@ -106,6 +164,8 @@ namespace Render
 
 		void fillImGuiInfo(ImGui_ImplVulkan_InitInfo* info);
 
+		void cmdDrawMeshTasks(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
+
 		ASSET_NAME("Render Device")
 
 		static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
@@ -139,10 +199,13 @@ namespace Render
 
 		QueueFamilyIndices findQueueFamilies(VkPhysicalDevice physicalDevice);
 		bool checkDeviceExtensionSupport(VkPhysicalDevice physicalDevice);
+		std::vector<const char*> getEnabledDeviceExtensions();
 
 		void createDescriptorSetLayout();
         void createDescriptorPool();
 
+		void setViewportAndScissor(DrawInfo& info);
+
 		DeviceConfig m_config = {};
 
 		std::vector<VkExtensionProperties> m_vkExtensions;
@@ -171,6 +234,36 @@ namespace Render
 			VK_KHR_SWAPCHAIN_EXTENSION_NAME
 		};
 #endif
+		// Enabled when the physical device supports them
+		const std::vector<const char*> m_optionalDeviceExtensions = {
+			VK_EXT_MESH_SHADER_EXTENSION_NAME,
+			VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
+			VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME,
+			VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME,
+			VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME,
+			VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME,
+			VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME
+		};
+		std::vector<const char*> m_enabledDeviceExtensions = {};
+
+		DeviceFeatures m_features = {};
+		VkPhysicalDeviceProperties m_properties = {};
+
+		PFN_vkCmdDrawMeshTasksEXT m_vkCmdDrawMeshTasks = nullptr;
+		PFN_vkCmdBeginRenderingKHR m_vkCmdBeginRendering = nullptr;
+		PFN_vkCmdEndRenderingKHR m_vkCmdEndRendering = nullptr;
+
+		TextureStreamer m_textureStreamer{};
+		BindlessHeap m_bindlessHeap{};
+		DescriptorAllocator m_descriptorAllocator{};
+		UniformRing m_uniformRing{};
+		FrameGlobals m_frameGlobals{};
+		SamplerCache m_samplerCache{};
+		TextureCache m_textureCache{};
+		ShaderCache m_shaderCache{};
+		PipelineCache m_pipelineCache{};
+		ShaderWatcher m_shaderWatcher{};
+
 		VkInstance m_instance = VK_NULL_HANDLE;
 		
 		VkSurfaceKHR m_surface = VK_NULL_HANDLE;
@@ -190,7 +283,7 @@ namespace Render
 		bool isFrameRendering = false;
 
 		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
-		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE; // ImGui only, object sets come from m_descriptorAllocator
 
 		VkPhysicalDeviceMemoryProperties m_memProperties = {};
 
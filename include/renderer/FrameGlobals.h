@@ -0,0 +1,72 @@
+#pragma once
+
+#include <StarryManager.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <array>
+
+#include "glm/glm.hpp"
+
+#include "DescriptorSet.h"
+
+namespace Render
+{
+	class Device;
+
+	struct FrameGlobalData
+	{
+		glm::mat4 view;
+		glm::mat4 proj;
+		glm::mat4 viewProj;
+		glm::vec4 time; // Seconds, delta seconds, frame count, unused
+	};
+
+	/*
+		Data that changes once per frame and is shared by every draw, e.g. the camera.
+		Layouts with LayoutConfig::frameSet bind it at set 0, their material sets
+		move to set 1 and per object data goes in push constants or a dynamic uniform:
+			layout(set = 0, binding = 0) uniform FrameGlobals { mat4 view; mat4 proj; mat4 viewProj; vec4 time; };
+
+		setData() is copied into a frame's buffer once, in beginFrame after its fence,
+		no matter how many layouts or objects read it.
+	*/
+	class FrameGlobals : public Manager::StarryAsset
+	{
+		public:
+			FrameGlobals();
+			~FrameGlobals();
+
+			void init(Device* device);
+			void destroy();
+
+			bool isActive() { return device != nullptr; }
+
+			void setData(const FrameGlobalData& data) { this->data = data; dirtyFrames = ~0u; }
+			const FrameGlobalData& getData() { return data; }
+
+			VkDescriptorSetLayout& getDescriptorSetLayout() { return descriptorSetLayout; }
+
+			void flush(uint32_t frame); // In beginFrame
+			void record(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t frame);
+
+			ASSET_NAME("Frame Globals")
+		private:
+			void createDescriptorSetLayout();
+			void createBuffers();
+			void createDescriptorSets();
+
+			FrameGlobalData data{};
+			uint32_t dirtyFrames = 0;
+
+			std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> buffers{};
+			std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> buffersMemory{};
+			std::array<void*, MAX_FRAMES_IN_FLIGHT> buffersMapped{};
+
+			VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+			std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> descriptorSets{};
+
+			Device* device = nullptr; // Owner
+	};
+}
@@ -5,6 +5,7 @@
 #include <GLFW/glfw3.h>
 
 #include <string>
+#include <vector>
 
 namespace Render
 {
@@ -20,19 +21,22 @@ namespace Render
 		virtual void destroy();
 
 		void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format,
-        VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties);
+        VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, uint32_t arrayLayers = 1);
 
 		void setImage(VkImage& image, bool isOwning);
-		void createImageView(VkFormat imageViewFormat, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
+		void createImageView(VkFormat imageViewFormat, VkImageAspectFlags aspectFlags, uint32_t mipLevels, uint32_t baseMipLevel = 0);
 
-		void transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
+		void transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels, uint32_t baseMipLevel = 0);
 
 		VkImage& getImage() { return image; }
 		VkImageView& getImageView() { return imageView; }
 
 		virtual ASSET_NAME("ImageBuffer")
 	protected:
+		void recordLayoutTransition(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMipLevel, uint32_t levelCount);
+
 		void copyBufferToImage(VkBuffer& buffer, VkImage& image, uint32_t width, uint32_t height);
+		void copyBufferToImage(VkBuffer& buffer, VkImage& image, const std::vector<VkBufferImageCopy>& regions);
 		void generateMipmaps(VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
 
 		VkDeviceSize imageSize = 0;
@@ -41,6 +45,8 @@ namespace Render
 		VkDeviceMemory imageMemory = VK_NULL_HANDLE;
 
 		VkImageView imageView = VK_NULL_HANDLE;
+		VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D;
+		uint32_t arrayLayers = 1; // Views, barriers and mip generation cover every layer
 
 		bool isOwning = true;
 
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <StarryManager.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "VertexBufferData.h"
+
+#define MESH_FILE_MAGIC 0x48534D53 // "SMSH"
+#define MESH_FILE_VERSION 1
+
+#define MESH_FILE_LZ4 0x1
+
+#define MESH_FILE_CHUNK_SIZE (4u << 20) // Raw bytes per LZ4 chunk
+#define MESH_FILE_CHUNK_STORED 0x80000000u // Chunk size flag, chunk did not compress
+
+namespace Render
+{
+	/*
+		Binary mesh container, little endian.
+
+		[MeshFileHeader][MeshFileSubMesh * subMeshCount][vertex blob][index blob]
+
+		Blobs hold Vertex and uint32_t indices exactly as Buffer uploads them, every
+		sub-mesh's indices are relative to its own vertexOffset. When MESH_FILE_LZ4 is
+		set each blob is a list of [uint32_t size][LZ4 block] chunks of
+		MESH_FILE_CHUNK_SIZE raw bytes (the last may be shorter).
+	*/
+	struct MeshFileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t flags;
+		uint32_t subMeshCount;
+
+		uint32_t vertexStride; // Must equal sizeof(Vertex)
+		uint32_t reserved;
+		uint64_t vertexCount;
+		uint64_t indexCount;
+
+		uint64_t vertexBlobOffset;
+		uint64_t vertexBlobSize; // Stored size
+		uint64_t indexBlobOffset;
+		uint64_t indexBlobSize;
+
+		glm::vec4 boundsMin;
+		glm::vec4 boundsMax;
+	};
+
+	struct MeshFileSubMesh {
+		uint32_t vertexOffset;
+		uint32_t vertexCount;
+		uint32_t indexOffset;
+		uint32_t indexCount;
+
+		glm::vec4 boundsMin;
+		glm::vec4 boundsMax;
+	};
+
+	static_assert(sizeof(MeshFileHeader) == 104, "MeshFileHeader layout changed, bump MESH_FILE_VERSION");
+	static_assert(sizeof(MeshFileSubMesh) == 48, "MeshFileSubMesh layout changed, bump MESH_FILE_VERSION");
+
+	/*
+		Read only memory map of a mesh file. read* copies (or decompresses) a blob
+		straight from the mapping into dst, which is meant to be mapped staging memory.
+		open() rejects files whose ranges or indices point outside their data, so
+		nothing invalid is ever copied to staging.
+	*/
+	class MeshFile : public Manager::StarryAsset
+	{
+		public:
+			MeshFile();
+			~MeshFile();
+
+			bool open(const std::string& path);
+			void close();
+
+			bool isOpen() { return mapped != nullptr; }
+
+			const MeshFileHeader& getHeader() { return header; }
+			const std::vector<MeshFileSubMesh>& getSubMeshes() { return subMeshes; }
+
+			uint64_t getVertexCount() { return header.vertexCount; }
+			uint64_t getIndexCount() { return header.indexCount; }
+
+			bool readVertices(void* dst);
+			bool readIndices(void* dst);
+
+			// Each entry of meshes becomes one sub-mesh
+			bool write(const std::string& path, std::vector<VertexBufferData>& meshes, bool compress);
+
+			ASSET_NAME("Mesh File")
+
+		private:
+			bool readBlob(uint64_t offset, uint64_t storedSize, uint64_t rawSize, void* dst);
+			bool validateIndices();
+
+			static size_t compressBound(size_t size);
+			static size_t compressBlock(const uint8_t* src, size_t srcSize, uint8_t* dst);
+			static bool decompressBlock(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+
+			static void appendBlob(std::vector<uint8_t>& out, const uint8_t* data, size_t size, bool compress);
+
+			std::string filePath;
+
+			MeshFileHeader header{};
+			std::vector<MeshFileSubMesh> subMeshes;
+			std::vector<uint8_t> decodedIndices; // Compressed files only, decoded while validating
+
+			const uint8_t* mapped = nullptr;
+			size_t mappedSize = 0;
+
+			void* fileHandle = nullptr; // HANDLE on Windows
+			void* mappingHandle = nullptr;
+			int fileDescriptor = -1;
+	};
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+#include "VertexBufferData.h"
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+namespace Render
+{
+	/*
+		GPU side meshlet, std430 compatible (64 bytes).
+		Triangles of a meshlet are stored contiguously in the index buffer so the
+		indexed path can draw one meshlet with a single indirect command, and as
+		packed local indices (3x uint8 in one uint32) for the mesh shader path.
+	*/
+	struct Meshlet {
+		glm::vec4 sphere; // xyz center, w radius
+		glm::vec4 cone; // xyz axis, w cutoff (sin of the cone angle, 1 = never backface culled)
+
+		uint32_t vertexOffset; // Into meshletVertices
+		uint32_t triangleOffset; // Into meshletTriangles
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+
+		uint32_t firstIndex; // Into the index buffer
+		int32_t vertexBase; // Sub-buffer vertex offset
+		uint32_t subBuffer;
+		uint32_t meshletBase; // First meshlet of the sub-buffer
+	};
+
+	struct MeshletData {
+		std::vector<Meshlet> meshlets;
+		std::vector<uint32_t> vertices; // Sub-buffer local vertex indices
+		std::vector<uint32_t> triangles; // Packed meshlet local indices
+
+		void clear();
+	};
+
+	class MeshletBuilder
+	{
+		public:
+			/*
+				Splits one sub-buffer into meshlets, appending to out. indices is rewritten
+				in meshlet order; firstIndex and vertexBase locate the sub-buffer inside
+				the master buffer.
+			*/
+			static void build(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+				uint32_t firstIndex, int32_t vertexBase, uint32_t subBuffer, MeshletData& out);
+
+		private:
+			static void computeBounds(const std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount, Meshlet& meshlet);
+	};
+}
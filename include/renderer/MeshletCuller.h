@@ -0,0 +1,139 @@
+#pragma once
+
+#include <StarryManager.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+#include <string>
+
+#include "Buffer.h"
+#include "Shader.h"
+#include "DescriptorSet.h"
+
+#define MESHLET_CULL_GROUP_SIZE 64
+#define MESHLET_TASK_GROUP_SIZE 32
+
+namespace Render
+{
+	class Device;
+
+	/*
+		Camera data read by the cull shaders (std140, binding 1).
+		screen.x is the projection scale in pixels, screen.y the smallest projected
+		diameter in pixels a meshlet may have before it is dropped.
+	*/
+	struct MeshletCullData {
+		glm::mat4 viewProj;
+		glm::vec4 frustum[6];
+		glm::vec4 cameraPosition;
+		glm::vec4 screen;
+
+		static MeshletCullData fromCamera(const glm::mat4& view, const glm::mat4& proj, float viewportHeight, float minPixels = 1.0f);
+	};
+
+	struct MeshletCullerConstructInfo
+	{
+		std::string computeShaderPath; // Empty when culling happens in the task shader
+	};
+
+	/*
+		Culls the meshlets of a Buffer by frustum, normal cone and projected size.
+		Compute path: writes VkDrawIndexedIndirectCommands per meshlet, compacted per
+		sub-buffer when drawIndirectCount is available.
+		Mesh shader path: only owns the geometry bindings, the task shader culls.
+
+		Bindings (set 0 for compute, set 1 for task/mesh):
+			0 meshlets, 1 cull data (uniform), 2 sub-buffer transforms, 3 draw commands,
+			4 draw counts, 5 meshlet vertices, 6 meshlet triangles, 7 vertices,
+			8 sub-buffer materials (the firstInstance Buffer::recordSubBuffer would pass)
+	*/
+	class MeshletCuller : public Manager::StarryAsset
+	{
+		struct FrameBuffer
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			void* mapped = nullptr;
+		};
+
+		struct CullPushData
+		{
+			uint32_t meshletCount;
+			uint32_t compact;
+		};
+
+		struct MeshPushData
+		{
+			uint32_t firstMeshlet;
+			uint32_t meshletCount;
+		};
+
+		public:
+			MeshletCuller();
+			~MeshletCuller();
+
+			void init(size_t deviceUUID, MeshletCullerConstructInfo info);
+			void ready(Buffer& buffer);
+			void destroy();
+
+			bool isActive();
+
+			void setCamera(const glm::mat4& view, const glm::mat4& proj, float viewportHeight);
+			void setTransform(uint32_t subBuffer, const glm::mat4& model);
+
+			// Outside of a render pass
+			void record(VkCommandBuffer commandBuffer, uint32_t frame);
+
+			// Compute path
+			void recordSubBuffer(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t index);
+
+			// Mesh shader path
+			void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t frame, uint32_t set = 1);
+			void recordMeshTasks(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t pushConstantOffset, uint32_t index);
+
+			VkDescriptorSetLayout& getDescriptorSetLayout() { return descriptorSetLayout; }
+
+			ASSET_NAME("Meshlet Culler")
+		private:
+			void createDescriptorSetLayout();
+			void createComputePipeline();
+			void createFrameBuffers();
+			void createDescriptorSets(Buffer& buffer);
+
+			void destroyFrameBuffers();
+
+			bool isReady = false;
+			bool compact = false;
+
+			uint32_t meshletCount = 0;
+			std::vector<uint32_t> meshletOffsets;
+			std::vector<uint32_t> meshletCounts;
+
+			MeshletCullData cullData{};
+			std::vector<glm::mat4> transforms;
+			std::vector<uint32_t> materials;
+
+			std::array<FrameBuffer, MAX_FRAMES_IN_FLIGHT> cullDataBuffers{};
+			std::array<FrameBuffer, MAX_FRAMES_IN_FLIGHT> transformBuffers{};
+			std::array<FrameBuffer, MAX_FRAMES_IN_FLIGHT> drawBuffers{};
+			std::array<FrameBuffer, MAX_FRAMES_IN_FLIGHT> countBuffers{};
+			FrameBuffer materialBuffer{}; // Written once in ready(), shared by every frame
+
+			Shader computeShader{};
+			std::string computeShaderPath;
+
+			VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+			VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+			std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> descriptorSets{};
+
+			VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+			VkPipeline computePipeline = VK_NULL_HANDLE;
+
+			Manager::ResourceHandle<Device> device{};
+	};
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <StarryManager.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Render
+{
+	class Device;
+
+	struct DepthPrepassStats
+	{
+		uint64_t prepassSamples = 0; // Passed the pre-pass, what the main pass would have shaded without it
+		uint64_t shadedSamples = 0; // Passed EQUAL in the main pass
+		uint64_t savedSamples = 0; // prepassSamples - shadedSamples
+	};
+
+	/*
+		Precise occlusion queries around every layout drawn in the depth pre-pass, one
+		in the pre-pass and one in the main pass around only the sub-buffers drawn with
+		EQUAL, see RenderLayout::Draw. Each layout gets a slot, each frame in flight its
+		own queries.
+
+		Results are read back in reset(), once the frame's fence says the queries it
+		recorded last time have finished, so nothing ever waits on the GPU. The stats
+		are MAX_FRAMES_IN_FLIGHT frames behind.
+
+		Without occlusionQueryPrecise the counts would only mean visible or not, the
+		queries are not created and the stats stay empty.
+	*/
+	class OcclusionQueries : public Manager::StarryAsset
+	{
+		public:
+			enum Pass {
+				PASS_PREPASS = 0,
+				PASS_MAIN = 1
+			};
+
+			OcclusionQueries();
+			~OcclusionQueries();
+
+			void init(size_t deviceUUID, uint32_t slots);
+			void destroy();
+
+			bool isActive() { return pool != VK_NULL_HANDLE; }
+
+			void reset(VkCommandBuffer commandBuffer, uint32_t frame); // Outside any render pass, before the frame's first begin()
+			void begin(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t slot, Pass pass);
+			void end(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t slot, Pass pass);
+
+			const DepthPrepassStats& getStats() { return stats; }
+
+			ASSET_NAME("Occlusion Queries")
+		private:
+			uint32_t queryIndex(uint32_t frame, uint32_t slot, Pass pass) { return (frame * slots + slot) * 2 + pass; }
+
+			VkQueryPool pool = VK_NULL_HANDLE;
+			uint32_t slots = 0;
+			std::vector<bool> recorded; // Per query, ended since the last reset
+
+			DepthPrepassStats stats{};
+
+			Manager::ResourceHandle<Device> device{};
+	};
+}
@@ -13,6 +13,9 @@
 #include "Shader.h"
 #include "RenderPass.h"
 #include "PushConstant.h"
+#include "PipelineCache.h"
+
+#include <map>
 
 #define ERROR_VOLATILE(x) x; if (getAlertSeverity() == FATAL) { return; }
 
@@ -25,6 +28,22 @@ namespace Render
 		size_t renderPassUUID;
 		size_t shaderUUID;
 		size_t pushConstantUUID;
+
+		// Bound at set 1 by mesh shader pipelines
+		VkDescriptorSetLayout meshletSetLayout = VK_NULL_HANDLE;
+
+		// Set 0 is the device's BindlessHeap instead of the per object layout
+		bool bindless = false;
+
+		// Set 0 is the device's FrameGlobals, every other set moves up by one
+		bool frameSet = false;
+
+		PipelineState state{}; // Default variant, bound by record()
+
+		std::vector<SpecializationConstant> specialization; // Applied to every variant
+
+		// Vertex stage only into the depth pre-pass, no color attachment
+		bool depthOnly = false;
 	};
 
 	class Pipeline : public Manager::StarryAsset {
@@ -41,17 +60,53 @@ namespace Render
 		VkPipelineLayout& getPipelineLayout() { return pipelineLayout; }
 		VkPipeline& getPipeline() { return graphicsPipeline; }
 
-		void record(VkCommandBuffer commandBuffer);
+		bool isMeshPipeline() { return meshPipeline; }
+		uint32_t getMeshletPushConstantOffset() { return meshletPushConstantOffset; }
+
+		uint32_t getObjectSet() { return objectSet; } // Material sets or the BindlessHeap
+		uint32_t getMeshletSet() { return meshletSet; }
+
+		// False while the pipeline still compiles, nothing is bound and the draw should be skipped.
+		// Dynamic parts of the state are set after the bind, see PipelineCacheConfig::dynamicState
+		bool record(VkCommandBuffer commandBuffer);
+		bool record(VkCommandBuffer commandBuffer, const PipelineState& state); // Per draw after record(), falls back to the default pipeline until the variant is compiled
+
+		bool isReady() { return getVariant(defaultState) != VK_NULL_HANDLE; }
+
+		VkPipeline getVariant(const PipelineState& state); // Queues the compile on first use, VK_NULL_HANDLE until done
+
+		// Hot reload: reload() queues the default state with the shader's new stages, swap() replaces
+		// every variant once it is compiled and returns true, the old ones are retired in the cache.
+		// Call swap() between frames, before the pipeline is recorded
+		void reload(Shader& shader);
+		bool swap();
 
 		ASSET_NAME("Pipeline")
 
 	private:
-		void constructPipelineLayout(RenderPass& renderPass, Shader& shader, PushConstant& pushConstant);
-
-		VkPipelineVertexInputStateCreateInfo createVertexInputInfo();
+		void refresh();
+		PipelineKey variantKey(const PipelineState& state); // Normalized by the cache
+		void constructPipelineLayout(RenderPass& renderPass, Shader& shader, PushConstant& pushConstant, PipelineConstructInfo& info);
 
 		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
 		VkPipeline graphicsPipeline = VK_NULL_HANDLE;
+		VkPipeline boundPipeline = VK_NULL_HANDLE; // Last bound by record(), only valid within one Draw
+
+		bool meshPipeline = false;
+		uint32_t meshletPushConstantOffset = 0;
+
+		PipelineKey baseKey{}; // Everything but the state
+		PipelineState defaultState{};
+		std::map<PipelineState, VkPipeline> variants;
+
+		uint64_t generation = 0; // PipelineCache generation the variants were read at
+
+		bool reloading = false;
+		PipelineKey pendingKey{};
+		std::vector<PipelineKey> abandoned; // Replaced by a newer reload, may still compile against old modules
+
+		uint32_t objectSet = 0;
+		uint32_t meshletSet = 1;
 
 		Manager::ResourceHandle<Device> device{};
 	};
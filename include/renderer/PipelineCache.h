@@ -0,0 +1,243 @@
+#pragma once
+
+#include <StarryManager.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstring>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "WorkerPool.h"
+
+namespace Render
+{
+	class Device;
+
+	enum BlendMode {
+		BLEND_OPAQUE = 0,
+		BLEND_ALPHA = 1, // src*a + dst*(1-a)
+		BLEND_ADDITIVE = 2
+	};
+
+	// Fixed function state of one graphics pipeline variant, defaults match the original catch-all pipeline
+	struct PipelineState
+	{
+		VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL; // Others need fillModeNonSolid
+		VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+		VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE; // Opposite for uniform buffer z flip
+
+		BlendMode blend = BLEND_ALPHA;
+
+		bool depthTest = true;
+		bool depthWrite = true;
+		VkCompareOp depthCompare = VK_COMPARE_OP_LESS;
+
+		VkSampleCountFlagBits samples = static_cast<VkSampleCountFlagBits>(0); // 0 = DeviceConfig::desiredMSAASamples, must match the render pass
+		float minSampleShading = 0.2f; // 0 disables sample shading
+
+		bool operator<(const PipelineState& other) const
+		{
+			return std::tie(topology, polygonMode, cullMode, frontFace, blend, depthTest, depthWrite, depthCompare, samples, minSampleShading) <
+				std::tie(other.topology, other.polygonMode, other.cullMode, other.frontFace, other.blend, other.depthTest, other.depthWrite, other.depthCompare, other.samples, other.minSampleShading);
+		}
+	};
+
+	// One 32 bit constant_id value, seen by every stage that declares it and ignored by the rest
+	struct SpecializationConstant
+	{
+		uint32_t id = 0;
+		uint32_t value = 0; // Raw bits, see of()
+
+		// e.g. SpecializationConstant::of(0, 4u) for a light count, of(1, true) for a feature toggle
+		template<typename T>
+		static SpecializationConstant of(uint32_t id, T value)
+		{
+			static_assert(std::is_same_v<T, bool> || (std::is_arithmetic_v<T> && sizeof(T) == 4), "Specialization constants are bool, int, uint or float");
+
+			SpecializationConstant constant{ id, 0 };
+			if constexpr (std::is_same_v<T, bool>) {
+				constant.value = value ? VK_TRUE : VK_FALSE;
+			}
+			else {
+				std::memcpy(&constant.value, &value, sizeof(T));
+			}
+			return constant;
+		}
+
+		bool operator<(const SpecializationConstant& other) const
+		{
+			return std::tie(id, value) < std::tie(other.id, other.value);
+		}
+	};
+
+	struct PipelineKey
+	{
+		PipelineState state{};
+		std::vector<std::pair<VkShaderStageFlagBits, VkShaderModule>> stages;
+		std::vector<SpecializationConstant> specialization; // Sorted by id, different values are different pipelines
+
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		VkRenderPass renderPass = VK_NULL_HANDLE; // Null with dynamic rendering, the formats describe the target instead
+
+		VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+		VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+
+		bool depthOnly = false; // No color attachment, e.g. the depth pre-pass
+
+		bool operator<(const PipelineKey& other) const
+		{
+			return std::tie(state, stages, specialization, layout, renderPass, colorFormat, depthFormat, depthOnly) <
+				std::tie(other.state, other.stages, other.specialization, other.layout, other.renderPass, other.colorFormat, other.depthFormat, other.depthOnly);
+		}
+	};
+
+	struct PipelineCacheConfig
+	{
+		std::string path = ""; // VkPipelineCache data is loaded from and saved to this file when set
+		uint32_t compileThreads = 0; // 0 = hardware concurrency - 1
+
+		// Link variants from cached VK_EXT_graphics_pipeline_library parts when the device supports it
+		bool pipelineLibraries = true;
+
+		// Set cull mode, front face, topology, depth, polygon mode and blend per draw through
+		// VK_EXT_extended_dynamic_state(3) where supported, variants differing only there share a pipeline
+		bool dynamicState = true;
+	};
+
+	/*
+		Graphics pipelines and pipeline layouts shared by every layout that asks for the
+		same state, created the first time a variant is used. Everything goes through
+		one VkPipelineCache so drivers can reuse compiled shaders between variants.
+
+		prepare() compiles on worker threads and get() never blocks, so a frame is never
+		stalled by a compile. Layouts prepare at Init and RenderContext::Ready() waits for
+		all of them with finish(), every layout compiles in parallel.
+
+		With VK_EXT_graphics_pipeline_library the vertex input, pre-rasterization, fragment
+		shader and fragment output parts are compiled once each and variants are fast
+		linked from them. A link time optimized pipeline is built behind it and replaces
+		the fast one, getGeneration() changes whenever a handle is replaced.
+
+		With extended dynamic state, normalize() folds the dynamic parts of a key to their
+		defaults and recordState() sets them after every bind.
+
+		Pipelines are counted but stay cached when unused, a command buffer in flight
+		may still be bound to them. trim() frees them once the device is idle, retired
+		ones are freed by advanceFrame() after MAX_FRAMES_IN_FLIGHT frames instead.
+	*/
+	class PipelineCache : public Manager::StarryAsset
+	{
+		using LayoutKey = std::pair<std::vector<VkDescriptorSetLayout>, std::vector<std::tuple<VkShaderStageFlags, uint32_t, uint32_t>>>;
+
+		struct LayoutEntry
+		{
+			VkPipelineLayout handle = VK_NULL_HANDLE;
+			uint32_t references = 0;
+		};
+
+		struct PipelineEntry
+		{
+			VkPipeline handle = VK_NULL_HANDLE;
+			uint32_t references = 0;
+
+			std::future<void> compiling; // Valid until the worker's result is collected
+			std::shared_ptr<VkPipeline> result; // Written by the worker
+			bool failed = false;
+
+			bool retired = false; // Destroyed by advanceFrame() once unused, e.g. built from reloaded shaders
+			uint32_t framesRetired = 0;
+
+			std::future<void> optimizing; // Link time optimized rebuild of a fast linked pipeline
+			std::shared_ptr<VkPipeline> optimized;
+		};
+
+		public:
+			PipelineCache();
+			~PipelineCache();
+
+			void init(Device* device, PipelineCacheConfig config);
+			void destroy();
+
+			bool isActive() { return device != nullptr; }
+
+			VkPipelineLayout acquireLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants);
+			void releaseLayout(VkPipelineLayout layout);
+
+			VkPipeline acquire(const PipelineKey& key); // Blocks until compiled, VK_NULL_HANDLE on failure
+			void prepare(const PipelineKey& key); // Takes a reference, compiles in the background
+			VkPipeline get(const PipelineKey& key); // VK_NULL_HANDLE while compiling or after a failure
+			void release(const PipelineKey& key, bool retire = false); // Retired pipelines are not kept for reuse
+
+			bool isPending(const PipelineKey& key);
+			bool hasFailed(const PipelineKey& key);
+
+			void finish(); // Waits for every queued compile
+
+			void advanceFrame(); // Destroys retired pipelines no frame in flight can still use
+			void trim(); // Only while the device is idle
+
+			void forgetModule(VkShaderModule module); // Before the ShaderCache destroys it
+
+			PipelineKey normalize(const PipelineKey& key); // Every key passed in must be normalized
+			void recordState(VkCommandBuffer commandBuffer, const PipelineState& state, bool meshPipeline);
+
+			VkPipelineCache getPipelineCache() { return pipelineCache; }
+			uint32_t getPipelineCount() { return static_cast<uint32_t>(pipelines.size()); }
+			uint64_t getGeneration() { return generation; }
+
+			ASSET_NAME("Pipeline Cache")
+		private:
+			VkPipeline createPipeline(const PipelineKey& key); // Worker safe, no alerts
+			bool collect(PipelineEntry& entry, bool wait);
+			void upgrade(PipelineEntry& entry, bool wait);
+
+			bool usesLibraries(const PipelineKey& key);
+			static PipelineKey libraryKey(VkGraphicsPipelineLibraryFlagsEXT part, const PipelineKey& key);
+			VkPipeline getLibrary(VkGraphicsPipelineLibraryFlagsEXT part, const PipelineKey& key); // Worker safe
+			VkPipeline linkPipeline(const PipelineKey& key, bool optimize); // Worker safe
+			void destroyLibraries();
+
+			void loadPipelineCache();
+			void savePipelineCache();
+			void loadDynamicState();
+
+			PipelineCacheConfig config{};
+			VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+			bool dynamicBasic = false; // VK_EXT_extended_dynamic_state
+			bool dynamicExtended = false; // VK_EXT_extended_dynamic_state3
+
+			PFN_vkCmdSetCullModeEXT m_vkCmdSetCullMode = nullptr;
+			PFN_vkCmdSetFrontFaceEXT m_vkCmdSetFrontFace = nullptr;
+			PFN_vkCmdSetPrimitiveTopologyEXT m_vkCmdSetPrimitiveTopology = nullptr;
+			PFN_vkCmdSetDepthTestEnableEXT m_vkCmdSetDepthTestEnable = nullptr;
+			PFN_vkCmdSetDepthWriteEnableEXT m_vkCmdSetDepthWriteEnable = nullptr;
+			PFN_vkCmdSetDepthCompareOpEXT m_vkCmdSetDepthCompareOp = nullptr;
+			PFN_vkCmdSetPolygonModeEXT m_vkCmdSetPolygonMode = nullptr;
+			PFN_vkCmdSetColorBlendEnableEXT m_vkCmdSetColorBlendEnable = nullptr;
+			PFN_vkCmdSetColorBlendEquationEXT m_vkCmdSetColorBlendEquation = nullptr;
+
+			std::map<LayoutKey, LayoutEntry> layouts;
+			std::map<PipelineKey, PipelineEntry> pipelines;
+			std::vector<std::pair<VkPipeline, uint32_t>> retiredHandles; // Replaced handle, frames since
+			uint64_t generation = 0;
+
+			std::map<std::pair<VkGraphicsPipelineLibraryFlagsEXT, PipelineKey>, std::shared_future<VkPipeline>> libraries;
+			std::vector<std::shared_future<VkPipeline>> staleLibraries;
+			std::mutex libraryMutex;
+
+			WorkerPool workers;
+
+			Device* device = nullptr; // Owner
+	};
+}
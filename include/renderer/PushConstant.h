@@ -7,6 +7,11 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <vector>
+#include <type_traits>
+
+#define PUSH_CONSTANT_GUARANTEED_SIZE 128 // maxPushConstantsSize every device supports
+
 namespace Render
 {
     struct PushConstantInfo {
@@ -25,14 +30,37 @@ namespace Render
 		static std::vector<VkPushConstantRange> decode(std::vector<PushConstantInfo> info);
 	};
 
+    /*
+        Per draw push constants, one user struct pushed before every sub-buffer, e.g.
+            struct ObjectData { glm::mat4 model; uint32_t drawIndex; uint32_t pad[3]; };
+            config.drawConstants = PushConstantBlock::of<ObjectData>();
+        and in GLSL a push_constant block with the same members after any PushConstantInfo ranges.
+    */
+    struct PushConstantBlock
+    {
+        uint32_t size = 0; // 0 when unused
+        VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        template<typename T>
+        static PushConstantBlock of(VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+        {
+            static_assert(std::is_trivially_copyable_v<T>, "Push constant blocks are copied byte for byte.");
+            static_assert(sizeof(T) % 4 == 0, "Push constant blocks must be a multiple of 4 bytes.");
+            static_assert(sizeof(T) <= PUSH_CONSTANT_GUARANTEED_SIZE, "Push constant block is larger than every device guarantees.");
+            return { static_cast<uint32_t>(sizeof(T)), stages };
+        }
+    };
+
     struct PushConstantConstructInfo {
         std::vector<PushConstantInfo> layouts;
+        PushConstantBlock drawBlock{};
     };
 
     struct PushConstantData 
     {
         void* data;
-        VkPushConstantRange layout;
+        uint32_t offset;
+        uint32_t size;
     };
 
     class PushConstant : public Manager::StarryAsset 
@@ -44,14 +72,36 @@ namespace Render
             void init(PushConstantConstructInfo info);
             void destroy();
             
+            // Every PushConstantInfo range in one vkCmdPushConstants, once per layout
             void record(VkCommandBuffer commandBuffer, VkPipelineLayout& layout);
+            // The draw block of one sub-buffer, sub-buffers past the last one set reuse it
+            void recordDraw(VkCommandBuffer commandBuffer, VkPipelineLayout& layout, uint32_t index);
 
             void addPushConstantData(void* data, int layoutIndex);
 
-            std::vector<VkPushConstantRange> getPushConstantRanges();
+            template<typename T>
+            void setDrawData(uint32_t index, const T& data)
+            {
+                if (sizeof(T) != drawBlock.size) {
+                    Alert("Draw push constant type does not match the layout's block.", WARNING);
+                    return;
+                }
+                setDrawBytes(index, &data);
+            }
+
+            // Everything packed into a single range, so every push names the same stages
+            const std::vector<VkPushConstantRange>& getPushConstantRanges() { return ranges; }
 
             ASSET_NAME("Push Constant")
         private:
+            void setDrawBytes(uint32_t index, const void* data);
+
             std::vector<PushConstantData> pcData{};
+            std::vector<char> block{}; // Staging for the PushConstantInfo part of the range
+            std::vector<VkPushConstantRange> ranges{};
+
+            PushConstantBlock drawBlock{};
+            uint32_t drawOffset = 0;
+            std::vector<char> drawData{}; // drawBlock.size bytes per sub-buffer
     };
 }
\ No newline at end of file
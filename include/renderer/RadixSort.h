@@ -0,0 +1,36 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace Render
+{
+	/*
+		Stable LSD radix sort of 64 bit keys carrying a 32 bit value, 8 bits per pass.
+		One pass over the keys counts every digit, passes whose digit is the same for
+		every key are skipped, so keys that only use a few bytes only pay for those.
+
+		The buffers are kept between sorts, sorting about as many items every frame
+		allocates nothing.
+	*/
+	class RadixSort
+	{
+		public:
+			void clear() { keys.clear(); values.clear(); }
+			void push(uint64_t key, uint32_t value) { keys.push_back(key); values.push_back(value); }
+
+			const std::vector<uint32_t>& sort(); // Values by ascending key, equal keys keep their push order
+
+			static uint32_t floatKey(float value); // Orders as unsigned like the float does, negatives included
+
+		private:
+			std::vector<uint64_t> keys;
+			std::vector<uint32_t> values;
+
+			std::vector<uint64_t> scratchKeys;
+			std::vector<uint32_t> scratchValues;
+
+			std::array<std::array<uint32_t, 256>, 8> histograms{};
+	};
+}
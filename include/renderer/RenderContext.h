@@ -3,9 +3,12 @@
 #include <StarryManager.h>
 
 #include <array>
+#include <functional>
 
 #include "Window.h"
 #include "Device.h"
+#include "RenderGraph.h"
+#include "OcclusionQueries.h"
 
 #include "RenderLayout.h"
 
@@ -21,7 +24,8 @@ namespace Render
 	struct DescriptorInfo {
 		enum DescriptorType {
 			UNIFORM_BUFFER,
-			IMAGE_SAMPLER
+			IMAGE_SAMPLER,
+			UNIFORM_BUFFER_DYNAMIC // Uniforms share the device's UniformRing, bound by offset
 		};
 
 		DescriptorType type;
@@ -47,11 +51,26 @@ namespace Render
 		std::vector<DescriptorInfo> descriptorInfo;
 		std::vector<PushConstantInfo> pushConstantInfo;
 
+		// Layouts with LayoutConfig::depthPrepass write depth in a pass of their own first, see GetDepthPrepassStats()
+		bool depthPrepass = false;
+
 		RenderConfig(MSAAOptions msaa, 
 			glm::vec3 clearColor, std::vector<DescriptorInfo> descriptorInfo, std::vector<PushConstantInfo> pushConstantInfo);
 		RenderConfig() {}
 	};
 
+	// The frame's built in images, handed to every RenderGraphSetup
+	struct RenderGraphTargets {
+		RenderResource backbuffer;
+		RenderResource color; // Multisampled, resolved into the backbuffer
+		RenderResource depth;
+
+		std::vector<RenderResource> mainReads; // Sampled by the layouts' Draw, keeps their writers alive
+	};
+
+	// Declares passes that run after every layout's Prepare (and the depth pre-pass) and before the main pass
+	using RenderGraphSetup = std::function<void(RenderGraph& graph, RenderGraphTargets& targets)>;
+
 	struct RenderState {
 		bool isInitialized = false;
 	};
@@ -65,17 +84,26 @@ namespace Render
 		void Init(std::shared_ptr<Window>& window, RenderConfig config);
 
 		void Add(std::shared_ptr<RenderLayout> layout);
+		void AddGraphSetup(RenderGraphSetup setup);
 
 		void Ready();
 		void Draw();
 
 		void WaitIdle() { m_renderDevice.waitIdle(); }
+
+		// Camera and time for every layout with LayoutConfig::frameSet
+		void UpdateFrameGlobals(const FrameGlobalData& data) { m_renderDevice.getFrameGlobals().setData(data); }
 		
 		void Destroy();
 
 		bool getErrorState() const { return Manager::AssetManager::get().lock()->isFatal(); }
 		void dumpAlerts() const { Manager::AssetManager::get().lock()->isFatal(); }
 
+		RenderGraph& GetRenderGraph() { return m_renderGraph; }
+
+		// Fragments the depth pre-pass kept from being shaded, a few frames behind. Empty without precise occlusion queries
+		const DepthPrepassStats& GetDepthPrepassStats() { return m_occlusionQueries.getStats(); }
+
 		std::array<unsigned int, 2> getExtent() { return { m_renderSwapchain.getExtent().width, m_renderSwapchain.getExtent().height }; }
 
 		ASSET_NAME("Render Context")
@@ -83,6 +111,9 @@ namespace Render
 		void checkSwapChainRecreation();
 		void recreateSwapchain();
 
+		void buildRenderGraph();
+		void compileRenderGraph();
+
 		RenderState m_state;
 		RenderConfig m_config;
 
@@ -91,6 +122,11 @@ namespace Render
 		Device m_renderDevice{};
 		SwapChain m_renderSwapchain{};
 		RenderPass m_renderPass{};
+		RenderGraph m_renderGraph{};
+		OcclusionQueries m_occlusionQueries{};
+
+		RenderGraphTargets m_graphTargets{};
+		std::vector<RenderGraphSetup> m_graphSetups;
 
 		std::map<uint32_t, std::weak_ptr<RenderLayout>> m_layouts;
 	};
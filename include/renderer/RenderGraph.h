@@ -0,0 +1,171 @@
+#pragma once
+
+#include <StarryManager.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Render
+{
+	class Device;
+	struct DrawInfo;
+
+	using RenderResource = uint32_t; // Index into the graph, valid until reset()
+
+	// How a pass touches an image, each maps to exactly one layout, stage and access
+	enum RenderUsage {
+		USAGE_COLOR_ATTACHMENT = 0,
+		USAGE_DEPTH_ATTACHMENT,
+		USAGE_DEPTH_READ, // Depth tested without writes
+		USAGE_SAMPLED,
+		USAGE_STORAGE, // Compute read and write in GENERAL
+		USAGE_TRANSFER_SRC,
+		USAGE_TRANSFER_DST,
+		USAGE_PRESENT
+	};
+
+	struct RenderResourceState
+	{
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+		VkAccessFlags2 access = VK_ACCESS_2_NONE; // Only legacy bits, so the synchronization 1 path can truncate
+
+		static RenderResourceState ofUsage(RenderUsage usage);
+		static bool ofLayout(VkImageLayout layout, RenderResourceState& state); // Usual stage and access of a layout, false if unknown
+
+		static bool isWrite(VkAccessFlags2 access);
+		static VkPipelineStageFlags toLegacyStages(VkPipelineStageFlags2 stages, VkPipelineStageFlags none);
+	};
+
+	struct RenderImageDesc
+	{
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+		VkExtent2D extent = { 0, 0 }; // 0 = the extent given to compile()
+		VkImageUsageFlags usage = 0; // On top of what the declared usages need
+	};
+
+	/*
+		A frame described as passes that declare which images they read and write.
+		compile() works out everything the passes would otherwise hand code:
+
+		Passes whose writes nothing reads are culled, starting from outputs and passes
+		with side effects. A pass that needs what an earlier pass wrote declares a read
+		as well as its write, a write alone does not keep earlier writers alive.
+
+		Transient images are created by the graph. Those only ever used as attachments
+		go to lazily allocated memory where the device has it, the rest share memory
+		blocks with transients whose passes do not overlap.
+
+		execute() records the passes in declaration order with one batched
+		synchronization2 barrier in front of each, holding only the layout changes and
+		hazards the declared usages need. Devices without it get the same barriers
+		through vkCmdPipelineBarrier.
+
+		Imported images (the swapchain's) keep their state between frames, setImportedImage()
+		restores the initial state given to importImage().
+	*/
+	class RenderGraph : public Manager::StarryAsset
+	{
+		struct Resource
+		{
+			std::string name;
+			RenderImageDesc desc{};
+			VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+			bool imported = false;
+			RenderResourceState initial{}; // Imported only
+			RenderResourceState state{};
+
+			bool isOutput = false;
+			RenderUsage output = USAGE_PRESENT;
+
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkImageUsageFlags usage = 0; // Every declared usage of the compiled passes
+
+			uint32_t firstPass = UINT32_MAX; // Positions in the compiled order
+			uint32_t lastPass = 0;
+			uint32_t block = UINT32_MAX;
+		};
+
+		struct Access
+		{
+			RenderResource resource;
+			RenderUsage usage;
+			bool write;
+		};
+
+		struct Pass
+		{
+			std::string name;
+			std::vector<Access> accesses;
+			std::function<void(DrawInfo&)> execute;
+			bool sideEffects = false; // Never culled, e.g. compute writing buffers the graph does not see
+			bool culled = false;
+		};
+
+		struct MemoryBlock
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint32_t memoryType = 0;
+			bool lazy = false; // One resource, never shared
+			uint32_t lastPass = 0; // Of the latest resource placed in it
+			RenderResourceState state{}; // Of whichever resource last used it, carried between frames
+		};
+
+		public:
+			RenderGraph();
+			~RenderGraph();
+
+			void init(size_t deviceUUID);
+			void destroy();
+
+			bool isActive() { return static_cast<bool>(device); }
+
+			void reset(); // Forgets every pass and resource, only while the device is idle
+
+			RenderResource createImage(const std::string& name, const RenderImageDesc& desc);
+			RenderResource importImage(const std::string& name, VkFormat format, RenderResourceState initial = {});
+			void setImportedImage(RenderResource resource, VkImage image, VkImageView view);
+			void setOutput(RenderResource resource, RenderUsage usage); // Kept alive and left in this usage at the end of the frame
+
+			uint32_t addPass(const std::string& name, std::function<void(DrawInfo&)> execute, bool sideEffects = false);
+			void read(uint32_t pass, RenderResource resource, RenderUsage usage);
+			void write(uint32_t pass, RenderResource resource, RenderUsage usage);
+
+			bool compile(VkExtent2D extent); // Only while the device is idle, again whenever the extent changes
+			void execute(DrawInfo& info);
+
+			VkImage getImage(RenderResource resource) { return resource < resources.size() ? resources[resource].image : VK_NULL_HANDLE; }
+			VkImageView getImageView(RenderResource resource) { return resource < resources.size() ? resources[resource].view : VK_NULL_HANDLE; }
+
+			bool isCulled(uint32_t pass) { return pass >= passes.size() || passes[pass].culled; }
+			VkDeviceSize getTransientMemory(); // Bytes actually allocated for transient images
+
+			ASSET_NAME("Render Graph")
+		private:
+			void cull();
+			bool allocate(VkExtent2D extent);
+			void destroyImages();
+
+			bool transition(RenderResource resource, const RenderResourceState& wanted, std::vector<bool>& touched, VkImageMemoryBarrier2& barrier);
+			void recordBarriers(VkCommandBuffer commandBuffer, const std::vector<VkImageMemoryBarrier2>& barriers);
+
+			std::vector<Resource> resources;
+			std::vector<Pass> passes;
+			std::vector<uint32_t> order; // Passes left after culling
+			std::vector<MemoryBlock> blocks;
+			bool compiled = false;
+
+			PFN_vkCmdPipelineBarrier2KHR m_vkCmdPipelineBarrier2 = nullptr;
+
+			Manager::ResourceHandle<Device> device{};
+	};
+}
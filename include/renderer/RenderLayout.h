@@ -6,7 +6,11 @@
 #include "Buffer.h"
 #include "ImageBuffer.h"
 #include "TextureImage.h"
+#include "TextureAtlas.h"
 #include "PushConstant.h"
+#include "MeshletCuller.h"
+#include "RadixSort.h"
+#include "OcclusionQueries.h"
 
 #include "Canvas.h"
 
@@ -29,6 +33,42 @@ namespace Render
 		std::string fragmentShader;
 
         DrawPriority priority = REGULAR;
+
+        // e.g. blend = BLEND_OPAQUE and minSampleShading = 0 for opaque geometry. Other variants through Pipeline::getVariant
+        PipelineState pipelineState{};
+
+        // constant_id values baked into the pipeline, e.g. light counts, feature toggles and loop bounds.
+        // Folded by the driver instead of branching at runtime, each distinct set is its own pipeline
+        std::vector<SpecializationConstant> specializationConstants;
+
+        // Pushed once per layout, then drawConstants once per sub-buffer, packed into one range in that order
+        std::vector<PushConstantInfo> pushConstants;
+        PushConstantBlock drawConstants{}; // e.g. PushConstantBlock::of<ObjectData>()
+
+        // Split sub-buffers into meshlets and cull them on the GPU
+        bool meshlets = false;
+        std::string meshletCullShader = ""; // Compute, used when mesh shaders are unavailable
+        std::string taskShader = "";
+        std::string meshShader = "";
+
+        // Bind the device's BindlessHeap once instead of a descriptor set per sub-buffer.
+        // Loaded descriptor sets still own and update their resources but are never allocated
+        bool bindless = false;
+
+        // Set 0 is the device's FrameGlobals (camera, time) written once per frame for every layout.
+        // Material sets or the BindlessHeap move to set 1, per object data belongs in drawConstants
+        bool frameSet = false;
+
+        // Drawn into the depth pre-pass when RenderConfig::depthPrepass is on, then shaded once per pixel with depth
+        // compare EQUAL and no depth writes. Only opaque sub-buffers testing and writing depth with LESS(_OR_EQUAL) take part.
+        // Both vertex shaders must compute the same position, declare gl_Position invariant
+        bool depthPrepass = false;
+        std::string prepassVertexShader = ""; // Position only, the vertex shader is used when empty
+
+        // With frameSet, every frame draw the sub-buffers given SetDrawBounds by the depth of those bounds in the
+        // FrameGlobals view, opaque front to back, then blended back to front. They only swap among their own load
+        // order positions, sub-buffers without bounds are never moved
+        bool sortDraws = false;
     };
 
     struct LayoutInitInfo
@@ -37,6 +77,7 @@ namespace Render
         size_t windowUUID;
         size_t swapChainUUID;
         size_t renderPassUUID;
+        bool depthPrepass = false; // RenderConfig::depthPrepass
     };
 
     class RenderLayout : Manager::StarryAsset
@@ -51,27 +92,65 @@ namespace Render
 
             void Load(std::shared_ptr<DescriptorSet>& descriptorSet);
 		    void Load(std::shared_ptr<VertexBufferData>& buffer);
+            void Load(std::shared_ptr<Uniform>& uniform); // Per sub-buffer in load order, bound by dynamic offset into the shared set
 		    void Load(std::shared_ptr<Canvas>& canvas);
+            void LoadMeshFile(const std::string& path); // Every sub-mesh becomes a sub-buffer
 
-            void Draw(DrawInfo& drawInfo);
+            void Prepare(DrawInfo& drawInfo); // Before the render pass begins
+            void Draw(DrawInfo& drawInfo, OcclusionQueries* queries = nullptr, uint32_t querySlot = 0); // Measures the EQUAL sub-buffers in querySlot
+            void DrawDepth(DrawInfo& drawInfo); // Inside the depth pre-pass, before Draw
 
 		    void UpdatePushConstants(void* data, int layoutIndex) { m_pushConstant.addPushConstantData(data, layoutIndex);}
 
+            // Copied, pushed before the sub-buffer is drawn. Sub-buffers past the last one set reuse it
+            template<typename T>
+            void UpdateDrawConstants(uint32_t subBuffer, const T& data) { m_pushConstant.setDrawData(subBuffer, data); }
+
+            // Drawn with this state instead of config.pipelineState. Where the device has extended dynamic state
+            // cull mode, front face, topology, depth, polygon mode and blend only change dynamic state, no new pipeline
+            void SetDrawState(uint32_t subBuffer, const PipelineState& state) { m_drawStates[subBuffer] = state; }
+            void ClearDrawState(uint32_t subBuffer) { m_drawStates.erase(subBuffer); }
+
+            // World space bounds used by LayoutConfig::sortDraws, xyz center and w radius. Without them the sub-buffer keeps its place
+            void SetDrawBounds(uint32_t subBuffer, const glm::vec4& sphere) { m_drawBounds[subBuffer] = sphere; }
+            void ClearDrawBounds(uint32_t subBuffer) { m_drawBounds.erase(subBuffer); }
+
+            void UpdateCullCamera(const glm::mat4& view, const glm::mat4& proj, float viewportHeight) { m_meshletCuller.setCamera(view, proj, viewportHeight); }
+            void UpdateCullTransform(uint32_t subBuffer, const glm::mat4& model) { m_meshletCuller.setTransform(subBuffer, model); }
+
             DrawPriority getPriority() { return config.priority; }
+            bool hasDepthPrepass() { return m_prepassActive; }
 
             ASSET_NAME("Render Layout")
 
         private:
+            void recordSubBuffers(DrawInfo& drawInfo, Pipeline& pipeline, bool depthPrepass, OcclusionQueries* queries = nullptr, uint32_t querySlot = 0);
+            void sortSubBuffers(uint32_t numSubBuffers);
+            PipelineState drawState(uint32_t subBuffer);
+
             Pipeline m_renderPipeline{};
 		    Shader m_shaders{};
+
+            Pipeline m_prepassPipeline{};
+            Shader m_prepassShaders{};
+            bool m_prepassActive = false;
+            bool m_prepassRecorded = false; // This frame, until Draw
+            std::vector<bool> m_prepassDrawn; // Per sub-buffer, drawn with EQUAL by Draw
 		    PushConstant m_pushConstant{};
 
 		    Buffer m_masterBufferData{};
+            MeshletCuller m_meshletCuller{};
 
             LayoutConfig config;
             LayoutInitInfo info;
 
 		    std::vector<std::weak_ptr<DescriptorSet>> m_descriptorSets;
+		    std::vector<std::weak_ptr<Uniform>> m_uniforms;
+            std::map<uint32_t, PipelineState> m_drawStates;
+            std::map<uint32_t, glm::vec4> m_drawBounds;
+
+            RadixSort m_drawSort{};
+            std::vector<uint32_t> m_drawOrder; // This frame's, shared by the depth pre-pass and Draw
 		    std::weak_ptr<Canvas> m_cnvs;
 
             Manager::ResourceHandle<Device> device{};
@@ -5,6 +5,8 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <array>
+
 namespace Render
 {
     class Device;
@@ -12,8 +14,18 @@ namespace Render
     struct RenderPassConstructInfo
     {
         std::array<VkFormat, 2> swapChainImageFormats;
+        bool depthPrepass = false; // Also builds the depth only pass and a main pass that loads its depth
     };
 
+    /*
+        The target the main pass draws into. With VK_KHR_dynamic_rendering there is no
+        VkRenderPass at all, pipelines are built from the formats and the Device begins
+        rendering with the attachments given directly.
+
+        With a depth pre-pass, the legacy path has three compatible render passes: the
+        main one, a depth only one, and the main one loading the pre-pass' depth instead
+        of clearing it. Pipelines built against the main one work in the loading one.
+    */
     class RenderPass : public Manager::StarryAsset
     {
         public:
@@ -24,12 +36,23 @@ namespace Render
             void destroy();
 
             VkRenderPass& getRenderPass() { return renderPass; }
+            VkRenderPass& getDepthRenderPass() { return depthRenderPass; }
+            VkRenderPass& getLoadDepthRenderPass() { return loadDepthRenderPass; }
+            bool isDynamic() { return renderPass == VK_NULL_HANDLE; }
+
+            VkFormat getColorFormat() { return formats[0]; }
+            VkFormat getDepthFormat() { return formats[1]; }
 
             ASSET_NAME("Render Pass")
         
         private:
-            void constructRenderPass(std::array<VkFormat, 2>& swapChainImageFormats);
+            VkRenderPass constructRenderPass(std::array<VkFormat, 2>& swapChainImageFormats, VkAttachmentLoadOp depthLoadOp);
+            VkRenderPass constructDepthRenderPass(VkFormat depthFormat);
+
             VkRenderPass renderPass = VK_NULL_HANDLE;
+            VkRenderPass depthRenderPass = VK_NULL_HANDLE;
+            VkRenderPass loadDepthRenderPass = VK_NULL_HANDLE;
+            std::array<VkFormat, 2> formats = { VK_FORMAT_UNDEFINED, VK_FORMAT_UNDEFINED };
 
             Manager::ResourceHandle<Device> device{};
     };
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <StarryManager.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <map>
+#include <tuple>
+
+namespace Render
+{
+	class Device;
+
+	struct SamplerKey
+	{
+		VkFilter magFilter = VK_FILTER_LINEAR;
+		VkFilter minFilter = VK_FILTER_LINEAR;
+		VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT; // U, V and W
+
+		float maxAnisotropy = -1.0f; // <= 1 disables, negative uses the device maximum
+		float minLod = 0.0f;
+		float maxLod = VK_LOD_CLAMP_NONE;
+		float mipLodBias = 0.0f;
+
+		bool operator<(const SamplerKey& other) const
+		{
+			return std::tie(magFilter, minFilter, mipmapMode, addressMode, maxAnisotropy, minLod, maxLod, mipLodBias) <
+				std::tie(other.magFilter, other.minFilter, other.mipmapMode, other.addressMode, other.maxAnisotropy, other.minLod, other.maxLod, other.mipLodBias);
+		}
+	};
+
+	/*
+		One VkSampler per distinct SamplerKey, shared by every texture that asks for it.
+		acquire() and release() count users. Unused samplers stay cached since
+		descriptor sets of frames in flight may still reference them, trim() frees them
+		once the device is idle.
+	*/
+	class SamplerCache : public Manager::StarryAsset
+	{
+		struct Entry
+		{
+			VkSampler sampler = VK_NULL_HANDLE;
+			uint32_t references = 0;
+		};
+
+		public:
+			SamplerCache();
+			~SamplerCache();
+
+			void init(Device* device);
+			void destroy();
+
+			bool isActive() { return device != nullptr; }
+
+			VkSampler acquire(const SamplerKey& key); // VK_NULL_HANDLE on failure
+			void release(VkSampler sampler);
+
+			void trim(); // Only while the device is idle
+
+			uint32_t getSamplerCount() { return static_cast<uint32_t>(entries.size()); }
+
+			ASSET_NAME("Sampler Cache")
+		private:
+			std::map<SamplerKey, Entry> entries;
+			std::map<VkSampler, SamplerKey> keys;
+
+			Device* device = nullptr; // Owner
+	};
+}
@@ -15,8 +15,15 @@ namespace Render
 
 	struct ShaderConstructInfo
 	{
-		std::string& vertexShaderPath;
-		std::string& fragmentShaderPath;
+		std::string vertexShaderPath;
+		std::string fragmentShaderPath; // Empty for vertex only, e.g. the depth pre-pass
+
+		// Replaces the vertex stage when the device supports VK_EXT_mesh_shader
+		std::string taskShaderPath = "";
+		std::string meshShaderPath = "";
+
+		// Compute only, all other paths are ignored
+		std::string computeShaderPath = "";
 	};
 
 	class Shader : public Manager::StarryAsset {
@@ -27,31 +34,40 @@ namespace Render
 			void init(size_t deviceUUID, ShaderConstructInfo info);
 			void destroy();
 
-			std::array<VkPipelineShaderStageCreateInfo, 2>& getShaderStages() { return shaderStages; }
+			std::vector<VkPipelineShaderStageCreateInfo>& getShaderStages() { return shaderStages; }
+			bool hasStage(VkShaderStageFlagBits stage);
+
+			// Hot reload: true when the ShaderCache reported new code and the stages now use it.
+			// The previous modules are kept until releaseRetired(), pipelines may still be built from them
+			bool reload();
+			void releaseRetired();
 
 			ASSET_NAME("Shader")
 
 		private:
-			VkShaderModule createShaderModule(const std::vector<char>& code, bool& error);
+			struct ShaderModule
+			{
+				VkShaderStageFlagBits stage;
+				std::string path;
+				std::vector<char> code = {}; // Only until the module is in the ShaderCache
+				VkShaderModule module = VK_NULL_HANDLE; // Owned by the ShaderCache
+			};
+
 			std::vector<char> readFile(const std::string& filename, bool& error);
 
 			void initShader();
 
 			void bindShaderStages();
 
-			void loadVertexShaderFromFile();
-			void loadFragmentShaderFromFile();
-
-			std::string vertexShaderPath;
-			std::string fragmentShaderPath;
+			void loadShaderFromFile(ShaderModule& shaderModule);
 
-			std::vector<char> vertexShaderCode = {};
-			std::vector<char> fragmentShaderCode = {};
+			std::vector<ShaderModule> modules = {};
 
-			VkShaderModule vertShaderModule = VK_NULL_HANDLE;
-			VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+			std::vector<VkPipelineShaderStageCreateInfo> shaderStages = {};
 
-			std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {};
+			std::vector<VkShaderModule> retired = {};
+			bool reloadPending = false;
+			int32_t listener = -1; // ShaderCache listener id
 
 			Manager::ResourceHandle<Device> device{};
 	};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <StarryManager.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Render
+{
+	class Device;
+
+	/*
+		Shader modules shared between every Shader that loads the same SPIR-V. Paths
+		are remembered, so a repeated path costs no disk IO, and modules are keyed by a
+		hash of their code, so identical SPIR-V under different paths is one module.
+
+		invalidate() forgets a path so its next acquire reads the file again, and tells
+		every listener, e.g. to rebuild pipelines. reload() swaps new code in under a path
+		and tells the listeners the same way. Modules are destroyed once no Shader holds
+		them and no path points at them.
+	*/
+	class ShaderCache : public Manager::StarryAsset
+	{
+		using ContentKey = std::pair<uint64_t, size_t>; // Hash, size
+
+		struct Entry
+		{
+			VkShaderModule module = VK_NULL_HANDLE;
+			uint32_t references = 0;
+			uint32_t paths = 0;
+		};
+
+		public:
+			using Listener = std::function<void(const std::string& path)>;
+
+			ShaderCache();
+			~ShaderCache();
+
+			void init(Device* device);
+			void destroy();
+
+			bool isActive() { return device != nullptr; }
+
+			VkShaderModule acquire(const std::string& path); // VK_NULL_HANDLE when the path was never inserted
+			VkShaderModule insert(const std::string& path, const std::vector<char>& code); // Holds one reference
+			void release(VkShaderModule module);
+
+			void invalidate(const std::string& path); // Pass "" to forget every path
+			void reload(const std::string& path, const std::vector<char>& code); // Unchanged code is ignored
+
+			uint32_t addListener(Listener listener);
+			void removeListener(uint32_t id);
+
+			uint32_t getModuleCount() { return static_cast<uint32_t>(entries.size()); }
+
+			static std::string canonicalPath(const std::string& path); // Listeners are told canonical paths by reload()
+
+			ASSET_NAME("Shader Cache")
+		private:
+			static ContentKey hashCode(const std::vector<char>& code);
+
+			void notify(const std::string& path);
+
+			void forgetPath(const ContentKey& key);
+			void destroyIfUnused(const ContentKey& key);
+
+			std::map<ContentKey, Entry> entries;
+			std::map<std::string, ContentKey> paths;
+			std::map<VkShaderModule, ContentKey> modules;
+
+			std::map<uint32_t, Listener> listeners;
+			uint32_t nextListener = 0;
+
+			Device* device = nullptr; // Owner
+	};
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <StarryManager.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Render
+{
+	class Device;
+
+	/*
+		Watches the SPIR-V files every Shader loaded and feeds changes into the
+		ShaderCache. A background thread waits on inotify (mtime polling elsewhere) and
+		reads changed files, poll() runs at the start of a frame and hands them to
+		ShaderCache::reload(), so the render thread never touches the disk.
+
+		Off by default, enabled with DeviceConfig::shaderHotReload.
+	*/
+	class ShaderWatcher : public Manager::StarryAsset
+	{
+		public:
+			ShaderWatcher();
+			~ShaderWatcher();
+
+			void init(Device* device);
+			void destroy();
+
+			bool isActive() { return device != nullptr; }
+
+			void watch(const std::string& path);
+
+			void poll(); // Render thread, between frames
+
+			ASSET_NAME("Shader Watcher")
+		private:
+			void run();
+			void read(const std::string& path);
+
+			std::set<std::string> files; // Canonical
+			std::map<std::string, std::vector<char>> changed; // Latest contents per file, written by the thread
+			std::mutex mutex;
+
+			std::thread thread;
+			std::atomic<bool> stopping = false;
+
+#ifdef __linux__
+			int notifyFd = -1;
+			std::map<int, std::string> directories; // Watch descriptor, directory
+#else
+			std::map<std::string, long long> writeTimes;
+#endif
+
+			Device* device = nullptr; // Owner
+	};
+}
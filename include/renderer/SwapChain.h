@@ -58,7 +58,7 @@ namespace Render
 			void destroy();
 
 			void constructSwapChain();
-			void generateFramebuffers(VkRenderPass& renderPass);
+			void generateFramebuffers(VkRenderPass& renderPass, VkRenderPass depthRenderPass = VK_NULL_HANDLE); // Depth only framebuffer for the pre-pass when given
 
 			void needRecreate();
 			bool shouldRecreate() { return recreate; }
@@ -67,6 +67,10 @@ namespace Render
 			void submitCommandBuffer(VkCommandBuffer& commandBuffer, uint32_t currentFrame);
 
 			VkFramebuffer& getFramebuffer() { return swapChainFramebuffers[swapChainImageIndex]; }
+			VkFramebuffer& getDepthFramebuffer() { return depthFramebuffer; }
+			ImageBuffer& getImageBuffer() { return swapChainImageBuffers[swapChainImageIndex]; } // Acquired this frame
+			ImageBuffer& getColorBuffer() { return *colorBuffer; }
+			ImageBuffer& getDepthBuffer() { return *depthBuffer; }
 			VkSwapchainKHR& getSwapChain() { return swapChain; }
 			std::array<VkFormat, 2>& getImageFormats() { return imageFormats; }
 			VkExtent2D& getExtent() { return swapChainExtent; }
@@ -109,6 +113,7 @@ namespace Render
 			std::shared_ptr<ImageBuffer> depthBuffer;
 
 			std::vector<VkFramebuffer> swapChainFramebuffers;
+			VkFramebuffer depthFramebuffer = VK_NULL_HANDLE;
 
 			uint32_t swapChainImageIndex;
 
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <StarryManager.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+
+#include "ImageBuffer.h"
+#include "DescriptorResource.h"
+#include "VertexBufferData.h"
+
+#define TEXTURE_ATLAS_INVALID_ENTRY UINT32_MAX
+
+namespace Render
+{
+	class Device;
+
+	struct TextureAtlasConfig
+	{
+		uint32_t layerSize = 1024; // Width and height of every array layer
+		uint32_t maxLayers = 16;
+		uint32_t maxEntrySize = 256; // Larger textures are rejected, load them as a TextureImage
+		uint32_t padding = 4; // Edge pixels repeated around each entry, also caps the mip count
+	};
+
+	struct TextureAtlasEntry
+	{
+		uint32_t layer;
+		glm::vec2 offset; // UV of the entry's top left corner
+		glm::vec2 scale; // UV extent of the entry
+	};
+
+	/*
+		Bottom-left skyline bin packer for one square layer. The skyline is the
+		list of top edges of the packed area, left to right, covering [0, size).
+	*/
+	class SkylinePacker
+	{
+		struct Node
+		{
+			uint32_t x;
+			uint32_t y;
+			uint32_t width;
+		};
+
+		public:
+			void reset(uint32_t size);
+			bool pack(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y);
+
+		private:
+			bool fits(size_t index, uint32_t width, uint32_t height, uint32_t& top);
+			void insert(size_t index, uint32_t x, uint32_t y, uint32_t width);
+
+			uint32_t size = 0;
+			std::vector<Node> skyline;
+	};
+
+	/*
+		Packs many small RGBA8 textures into the layers of one 2D array image so they
+		share an image, a sampler and one descriptor (binding 1, sampler2DArray).
+		Entries are packed when added and the layers uploaded at init.
+
+		remap() rewrites a mesh's UVs into its entry and stores the layer as the mesh's
+		material index, which the indexed draw passes as firstInstance. UVs must stay in
+		[0, 1], repeating textures do not survive packing.
+	*/
+	class TextureAtlas : public ImageBuffer, public DescriptorResource
+	{
+		struct Layer
+		{
+			SkylinePacker packer;
+			std::vector<unsigned char> pixels; // Freed after upload
+		};
+
+		public:
+			TextureAtlas(TextureAtlasConfig config = {});
+			~TextureAtlas();
+
+			void init(size_t deviceUUID) override;
+			void destroy() override;
+
+			uint32_t addTexture(const std::string& path); // TEXTURE_ATLAS_INVALID_ENTRY on failure
+			TextureAtlasEntry& getEntry(uint32_t entry) { return entries[entry]; }
+			uint32_t getLayerCount() { return static_cast<uint32_t>(layers.size()); }
+
+			void remap(VertexBufferData& data, uint32_t entry);
+
+			VkWriteDescriptorSet createWrite(int frame, VkDescriptorSet& descriptorSet) override;
+
+			const std::string getAssetName() override { return "Texture Atlas"; }
+		private:
+			void blit(Layer& layer, const unsigned char* pixels, uint32_t width, uint32_t height, uint32_t x, uint32_t y);
+			void upload();
+			void createSampler();
+
+			TextureAtlasConfig config;
+
+			std::vector<Layer> layers;
+			std::vector<TextureAtlasEntry> entries;
+
+			uint32_t mipLevels = 1;
+
+			VkSampler imageSampler = VK_NULL_HANDLE;
+
+			VkDescriptorImageInfo imageInfo{};
+	};
+}
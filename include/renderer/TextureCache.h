@@ -0,0 +1,86 @@
+#pragma once
+
+#include <StarryManager.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <map>
+#include <string>
+
+#define TEXTURE_CACHE_DEFAULT_EVICTION_FRAMES 120
+
+namespace Render
+{
+	class Device;
+
+	struct TextureCacheConfig
+	{
+		bool hashContents = false; // Key by file contents, identical files under different paths share one image
+		uint32_t evictionFrames = TEXTURE_CACHE_DEFAULT_EVICTION_FRAMES; // Unused images are kept this long, never less than MAX_FRAMES_IN_FLIGHT
+	};
+
+	struct CachedTexture
+	{
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mipLevels = 0;
+	};
+
+	/*
+		Fully resident texture images shared between every TextureImage loaded from the
+		same path (or the same contents with hashContents), so a repeated material costs
+		one decode, one upload and one allocation.
+
+		The cache owns the image, its memory and view once they are inserted. Users hold
+		a reference through acquire()/insert() and give it back with release(). An image
+		nobody references is destroyed after evictionFrames frames, loading it again
+		before then is free.
+
+		Textures that are still streaming mips are not cached, their view keeps changing.
+	*/
+	class TextureCache : public Manager::StarryAsset
+	{
+		struct Entry
+		{
+			CachedTexture texture{};
+			uint32_t references = 0;
+			uint32_t framesUnused = 0;
+		};
+
+		public:
+			TextureCache();
+			~TextureCache();
+
+			void init(Device* device, TextureCacheConfig config);
+			void destroy();
+
+			bool isActive() { return device != nullptr; }
+
+			std::string makeKey(const std::string& path); // Empty when the file can not be read
+
+			bool acquire(const std::string& key, CachedTexture& texture);
+			bool insert(const std::string& key, const CachedTexture& texture); // Takes ownership and holds one reference, false leaves it with the caller
+			void release(const std::string& key);
+
+			// After the frame's fence was waited on
+			void advanceFrame();
+
+			uint32_t getEntryCount() { return static_cast<uint32_t>(entries.size()); }
+
+			ASSET_NAME("Texture Cache")
+		private:
+			void destroyTexture(CachedTexture& texture);
+
+			TextureCacheConfig config{};
+
+			std::map<std::string, Entry> entries;
+
+			Device* device = nullptr; // Owner
+	};
+}
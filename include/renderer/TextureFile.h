@@ -0,0 +1,71 @@
+#pragma once
+
+#include <StarryManager.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+
+namespace Render
+{
+	struct TextureFileLevel {
+		uint64_t fileOffset;
+		uint64_t size;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	/*
+		Reader for block compressed textures with prebuilt mip chains.
+		Supports KTX2 (no supercompression) and DDS (legacy FourCC and DX10 headers)
+		holding BC1, BC3, BC5 or BC7 data. Levels are ordered largest first.
+	*/
+	class TextureFile : public Manager::StarryAsset
+	{
+		public:
+			TextureFile();
+			~TextureFile();
+
+			static bool isSupportedPath(const std::string& path); // .ktx2 or .dds
+
+			bool open(const std::string& path);
+			void close();
+
+			VkFormat getFormat() { return format; }
+			uint32_t getWidth() { return levels.empty() ? 0 : levels[0].width; }
+			uint32_t getHeight() { return levels.empty() ? 0 : levels[0].height; }
+			uint32_t getLevelCount() { return static_cast<uint32_t>(levels.size()); }
+			const std::vector<TextureFileLevel>& getLevels() { return levels; }
+
+			// Bytes needed to hold levels [firstLevel, end) back to back with copy alignment
+			VkDeviceSize getDataSize(uint32_t firstLevel = 0);
+
+			/*
+				Reads levels [firstLevel, end) into dst, packed as getDataSize describes, and
+				fills one copy region per level.
+			*/
+			bool readLevels(void* dst, std::vector<VkBufferImageCopy>& regions, uint32_t firstLevel = 0);
+			bool readLevel(uint32_t level, void* dst);
+
+			static uint32_t getBlockSize(VkFormat format);
+
+			ASSET_NAME("Texture File")
+
+		private:
+			bool parseKTX2();
+			bool parseDDS();
+
+			static VkFormat formatFromDXGI(uint32_t dxgiFormat);
+
+			std::string filePath;
+			std::ifstream file;
+			uint64_t fileSize = 0;
+
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			std::vector<TextureFileLevel> levels;
+	};
+}
@@ -2,12 +2,21 @@
 
 #include <StarryManager.h>
 
+#include <future>
+#include <memory>
+#include <vector>
+
 #include "ImageBuffer.h"
 #include "DescriptorResource.h"
+#include "TextureFile.h"
+#include "WorkerPool.h"
+
+#define TEXTURE_STREAM_INITIAL_BYTES (64 << 10) // Mip tail uploaded at load, the rest streams in
 
 namespace Render
 {
     class Device;
+    class TextureStreamer;
 
     class TextureImage : public ImageBuffer, public DescriptorResource
     {
@@ -19,20 +28,70 @@ namespace Render
             void destroy() override;
 
 			void storeFilePath(const std::string& path) { filePath = path; }
-            void loadFromFile();
+            void loadFromFile(); // .ktx2 and .dds keep their BCn data and mip chain
+
+            // Decodes every texture missing from the TextureCache on the TextureStreamer's workers and uploads each as soon as it is decoded.
+            // Textures loaded here skip loading again when their descriptor set initializes them
+            static void loadBatch(size_t deviceUUID, const std::vector<std::shared_ptr<TextureImage>>& textures);
 
             VkWriteDescriptorSet createWrite(int frame, VkDescriptorSet& descriptorSet) override;
 
+            // Largest on-screen extent in pixels, picks the finest mip worth streaming. 0 = unknown, stream all
+            void setScreenSize(float pixels) { screenSize = pixels; }
+
+            // Streaming, driven by TextureStreamer
+            bool isStreaming() { return streamer != nullptr && residentLevel > 0; }
+            uint32_t getResidentLevel() { return residentLevel; }
+            uint32_t getWantedLevel();
+            float getStreamPriority();
+            VkDeviceSize getNextLevelSize();
+            VkDeviceSize getStreamedBytes() { return streamedBytes; }
+
+            bool isNextLevelLoading();
+            bool isNextLevelLoaded();
+            void loadNextLevel(WorkerPool& workers);
+            VkImageView recordNextLevel(VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, VkDeviceSize offset, void* stagingData); // Returns the replaced view
+
             const std::string getAssetName() override {	return "Texture Image"; }
         private:
-            void loadImageToMemory(VkDeviceSize imageSize, Manager::ImageFile* file);
+            void loadImageToMemory(VkDeviceSize imageSize, const void* pixels);
+            void loadCompressedFromFile();
+
+            bool requestDecode(); // Calling thread, false when the TextureCache already had the image
+            void decode(); // Worker safe, reads and decodes into decodedData, no Vulkan, manager or cache calls
+            void upload(); // Calling thread, everything touching Vulkan, the device or the cache
+
+            // Shared through the device's TextureCache
+            bool loadFromCache();
+            void storeInCache();
 
             void createSampler();
 
+            void stopStreaming();
+
             uint32_t mipLevels = 0;
+            uint32_t width = 0;
+            uint32_t height = 0;
+            VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+
+            TextureFile streamFile; // Open while levels are still streaming
+            TextureStreamer* streamer = nullptr;
+            uint32_t residentLevel = 0; // Finest level in the image view
+            float screenSize = 0.0f;
+            VkDeviceSize streamedBytes = 0;
+
+            std::future<void> pendingLoad;
+            std::vector<char> pendingData;
+            bool pendingValid = false;
 
             std::string filePath;
-            Manager::ResourceHandle<FILETYPE> file;
+            std::string cacheKey;
+            bool isCached = false; // Image, memory and view belong to the TextureCache
+            std::string loadedPath;
+            bool isDecoded = false;
+            bool streamLevels = false; // Streamer active when requested, decode() leaves finer BCn levels for it
+            std::vector<uint8_t> decodedData; // RGBA8 pixels or the resident BCn levels, until upload()
+            std::vector<VkBufferImageCopy> decodedRegions; // BCn only, one per resident level
 
             VkBuffer stagingBuffer = VK_NULL_HANDLE;
             VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <StarryManager.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <array>
+#include <vector>
+
+#include "DescriptorSet.h"
+#include "WorkerPool.h"
+
+#define TEXTURE_STREAM_DEFAULT_BUDGET (16ull << 20) // Upload bytes per frame
+
+namespace Render
+{
+	class Device;
+	class TextureImage;
+
+	struct TextureStreamerConfig
+	{
+		VkDeviceSize uploadBudget = TEXTURE_STREAM_DEFAULT_BUDGET;
+		VkDeviceSize residentBudget = 0; // Streamed bytes allowed on the GPU, 0 = unlimited
+		uint32_t workerThreads = 0; // 0 = hardware concurrency - 1
+	};
+
+	/*
+		Streams the higher mips of compressed textures after they are created with only
+		their smallest levels. Worker threads read levels from disk, record() copies at
+		most uploadBudget bytes per frame into that frame's staging buffer and records the
+		uploads into the frame command buffer before any render pass.
+
+		Textures are served by priority: on-screen size divided by resident width, so the
+		most magnified texture gets its next level first. Replaced image views are kept
+		alive until no frame in flight can still reference them.
+	*/
+	class TextureStreamer : public Manager::StarryAsset
+	{
+		struct StagingBuffer
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			void* mapped = nullptr;
+		};
+
+		struct RetiredView
+		{
+			VkImageView view;
+			uint32_t framesLeft;
+		};
+
+		public:
+			TextureStreamer();
+			~TextureStreamer();
+
+			void init(Device* device, TextureStreamerConfig config);
+			void destroy();
+
+			bool isActive() { return device != nullptr; }
+
+			void add(TextureImage* texture);
+			void remove(TextureImage* texture);
+
+			WorkerPool& getWorkers() { return workers; }
+
+			void setUploadBudget(VkDeviceSize bytes) { config.uploadBudget = bytes; }
+			void setResidentBudget(VkDeviceSize bytes) { config.residentBudget = bytes; }
+			VkDeviceSize getResidentBytes() { return residentBytes; }
+
+			// Before any render pass of the frame
+			void record(VkCommandBuffer commandBuffer, uint32_t frame);
+
+			void retire(VkImageView view);
+
+			ASSET_NAME("Texture Streamer")
+		private:
+			void releaseRetired(bool all);
+			bool reserveStaging(uint32_t frame, VkDeviceSize size); // Replaces a smaller buffer, never once this frame recorded from it
+			void destroyStaging(StagingBuffer& staging);
+
+			TextureStreamerConfig config{};
+
+			std::vector<TextureImage*> textures;
+			std::vector<RetiredView> retired;
+
+			std::array<StagingBuffer, MAX_FRAMES_IN_FLIGHT> stagingBuffers{};
+
+			VkDeviceSize residentBytes = 0;
+
+			WorkerPool workers;
+
+			Device* device = nullptr; // Owner
+	};
+}
@@ -28,10 +28,15 @@ namespace Render
 		void init(size_t deviceUUID) override;
 		void destroy() override;
 
-		UniformData& getBuffer() { return buffer; }
-		void setData(const UniformData& ubo) { buffer = ubo; }
+		// Writable access marks every frame dirty, use getData() to only read
+		UniformData& getBuffer() { markDirty(); return buffer; }
+		const UniformData& getData() { return buffer; }
+		void setData(const UniformData& ubo) { buffer = ubo; markDirty(); }
 
 		void update(int frame) override;
+		bool getDynamicOffset(int frame, uint32_t& offset) override;
+
+		bool isInRing() { return inRing; } // Sliced from the device's UniformRing instead of owning buffers
 
 		VkWriteDescriptorSet createWrite(int frame, VkDescriptorSet& descriptorSet) override;
 
@@ -45,6 +50,9 @@ namespace Render
 		std::vector<VkDeviceMemory> uniformsMemory;
 		std::vector<void*> uniformsMapped;
 
+		bool inRing = false;
+		VkDeviceSize ringOffset = 0;
+
 		VkDescriptorBufferInfo bufferInfo{};
 
 		Manager::ResourceHandle<Device> device;
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <StarryManager.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+
+#include "DescriptorSet.h"
+
+#define UNIFORM_RING_DEFAULT_SIZE (4ull << 20) // Bytes per frame in flight
+
+namespace Render
+{
+	class Device;
+
+	/*
+		One persistently mapped buffer shared by every Uniform, split into one region per
+		frame in flight. Each Uniform owns the same slice in every region, aligned to
+		minUniformBufferOffsetAlignment, and is bound as VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+		with (region + slice) as its dynamic offset.
+
+		Every descriptor write points at the same buffer with the same range, so objects
+		differ only by dynamic offset and can share a descriptor set.
+	*/
+	class UniformRing : public Manager::StarryAsset
+	{
+		struct Slice
+		{
+			VkDeviceSize offset;
+			VkDeviceSize size;
+		};
+
+		public:
+			UniformRing();
+			~UniformRing();
+
+			void init(Device* device, VkDeviceSize frameSize);
+			void destroy();
+
+			bool isActive() { return device != nullptr; }
+
+			bool allocate(VkDeviceSize size, VkDeviceSize& offset); // Offset inside a frame region
+			void free(VkDeviceSize offset, VkDeviceSize size);
+
+			VkBuffer& getBuffer() { return buffer; }
+			VkDeviceSize getFrameOffset(uint32_t frame) { return frameSize * frame; }
+			void* getMapped(uint32_t frame, VkDeviceSize offset) { return static_cast<char*>(mapped) + getFrameOffset(frame) + offset; }
+
+			VkDeviceSize getAlignment() { return alignment; }
+			VkDeviceSize getUsedBytes() { return used; }
+
+			ASSET_NAME("Uniform Ring")
+		private:
+			VkDeviceSize align(VkDeviceSize size) { return (size + alignment - 1) / alignment * alignment; }
+
+			VkDeviceSize frameSize = 0;
+			VkDeviceSize alignment = 1;
+			VkDeviceSize head = 0;
+			VkDeviceSize used = 0;
+			std::vector<Slice> freeSlices;
+
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			void* mapped = nullptr;
+
+			Device* device = nullptr; // Owner
+	};
+}
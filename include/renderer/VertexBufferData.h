@@ -40,6 +40,10 @@ namespace Render
 
             size_t getID() { return id; }
 
+            // Reaches shaders as gl_InstanceIndex (firstInstance), e.g. a texture atlas layer
+            void setMaterialIndex(uint32_t index) { materialIndex = index; }
+            uint32_t getMaterialIndex() { return materialIndex; }
+
             bool isEmpty() { return vertices.empty() || indices.empty(); }
 
         private:
@@ -47,6 +51,7 @@ namespace Render
             std::vector<uint32_t> indices;
 
             size_t id;
+            uint32_t materialIndex = 0;
 
             static std::mt19937_64 randomGen;
     };
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+
+namespace Render
+{
+	/*
+		Fixed set of threads running submitted jobs in FIFO order.
+		Jobs do CPU side work (file IO, decoding) and may create Vulkan objects through
+		calls that are free threaded, like vkCreateGraphicsPipelines into an internally
+		synchronized VkPipelineCache. They must never allocate, record or submit command
+		buffers, nor use any object another thread may be using without its own lock.
+	*/
+	class WorkerPool
+	{
+		public:
+			WorkerPool();
+			~WorkerPool();
+
+			void init(uint32_t threadCount = 0); // 0 = hardware concurrency - 1, at least 1
+			void destroy(); // Finishes queued jobs, then joins
+
+			std::future<void> submit(std::function<void()> job);
+
+			bool isRunning() { return !threads.empty(); }
+			uint32_t getThreadCount() { return static_cast<uint32_t>(threads.size()); }
+
+		private:
+			void run();
+
+			std::vector<std::thread> threads;
+			std::queue<std::packaged_task<void()>> jobs;
+
+			std::mutex mutex;
+			std::condition_variable condition;
+			bool stopping = false;
+	};
+}
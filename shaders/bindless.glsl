@@ -0,0 +1,29 @@
+// Declarations for layouts with LayoutConfig::bindless, see BindlessHeap.h.
+// Indices come from DescriptorResource::getBindlessIndex(), e.g. a texture index set
+// as the sub-buffer material index arrives as gl_InstanceIndex (vertex) and must be
+// passed to the fragment stage as a flat varying.
+
+// Layouts that also use LayoutConfig::frameSet define BINDLESS_SET 1 before including this.
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+#ifndef BINDLESS_SET
+#define BINDLESS_SET 0
+#endif
+
+layout(set = BINDLESS_SET, binding = 0) uniform sampler2D bindlessTextures[];
+// Same binding for the slots holding a TextureAtlas, whose views are 2D arrays. A slot
+// must only be read through the declaration matching its view type
+layout(set = BINDLESS_SET, binding = 0) uniform sampler2DArray bindlessTextureArrays[];
+layout(set = BINDLESS_SET, binding = 1) readonly buffer BindlessBuffer { mat4 matrices[]; } bindlessBuffers[];
+
+vec4 sampleBindless(uint index, vec2 uv)
+{
+	return texture(bindlessTextures[nonuniformEXT(index)], uv);
+}
+
+// index is the atlas' getBindlessIndex(), layer the sub-buffer material index remap() stored
+vec4 sampleBindlessAtlas(uint index, vec2 uv, uint layer)
+{
+	return texture(bindlessTextureArrays[nonuniformEXT(index)], vec3(uv, float(layer)));
+}
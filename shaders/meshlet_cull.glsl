@@ -0,0 +1,60 @@
+// Shared meshlet culling code, see MeshletCuller.h for the binding layout.
+// Define MESHLET_SET before including (0 for compute, 1 for task shaders).
+
+struct Meshlet {
+	vec4 sphere;
+	vec4 cone;
+	uint vertexOffset;
+	uint triangleOffset;
+	uint vertexCount;
+	uint triangleCount;
+	uint firstIndex;
+	int vertexBase;
+	uint subBuffer;
+	uint meshletBase;
+};
+
+layout(set = MESHLET_SET, binding = 0) readonly buffer Meshlets { Meshlet meshlets[]; };
+
+layout(set = MESHLET_SET, binding = 1) uniform CullData {
+	mat4 viewProj;
+	vec4 frustum[6];
+	vec4 cameraPosition;
+	vec4 screen;
+} cull;
+
+layout(set = MESHLET_SET, binding = 2) readonly buffer Transforms { mat4 transforms[]; };
+
+// Per sub-buffer material index, the atlas layer or bindless index drawn as firstInstance
+layout(set = MESHLET_SET, binding = 8) readonly buffer Materials { uint materials[]; };
+
+bool isMeshletVisible(Meshlet meshlet)
+{
+	mat4 model = transforms[meshlet.subBuffer];
+
+	vec3 center = (model * vec4(meshlet.sphere.xyz, 1.0)).xyz;
+	float scale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));
+	float radius = meshlet.sphere.w * scale;
+
+	// Frustum
+	for (int i = 0; i < 6; i++) {
+		if (dot(cull.frustum[i].xyz, center) + cull.frustum[i].w < -radius) {
+			return false;
+		}
+	}
+
+	// Backface cone
+	vec3 axis = normalize(mat3(model) * meshlet.cone.xyz);
+	vec3 toCenter = center - cull.cameraPosition.xyz;
+	float distance = length(toCenter);
+	if (dot(toCenter, axis) >= meshlet.cone.w * distance + radius) {
+		return false;
+	}
+
+	// Projected size
+	if (distance > radius && 2.0 * radius * cull.screen.x / distance < cull.screen.y) {
+		return false;
+	}
+
+	return true;
+}
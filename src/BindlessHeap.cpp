@@ -0,0 +1,300 @@
+#include "BindlessHeap.h"
+
+#include "Device.h"
+
+#include <algorithm>
+
+namespace Render
+{
+	BindlessHeap::BindlessHeap()
+	{
+	}
+
+	BindlessHeap::~BindlessHeap()
+	{
+		destroy();
+	}
+
+	void BindlessHeap::init(Device* device, BindlessConfig config)
+	{
+		destroy();
+
+		this->device = device;
+		this->config = config;
+
+		clampToLimits();
+
+		textures.resize(this->config.maxTextures);
+		buffers.resize(this->config.maxBuffers);
+
+		createDescriptorSetLayout();
+		createDescriptorSets();
+
+		if (descriptorPool == VK_NULL_HANDLE) {
+			destroy();
+			return;
+		}
+
+		Alert("Bindless heap: " + std::to_string(textures.size()) + " textures, " +
+			std::to_string(buffers.size()) + " buffers.", INFO);
+	}
+
+	void BindlessHeap::destroy()
+	{
+		if (device) {
+			if (descriptorPool != VK_NULL_HANDLE) {
+				vkDestroyDescriptorPool(device->getDevice(), descriptorPool, nullptr);
+				descriptorPool = VK_NULL_HANDLE;
+			}
+			if (descriptorSetLayout != VK_NULL_HANDLE) {
+				vkDestroyDescriptorSetLayout(device->getDevice(), descriptorSetLayout, nullptr);
+				descriptorSetLayout = VK_NULL_HANDLE;
+			}
+		}
+		descriptorSets = {};
+
+		textures.clear();
+		freeTextures.clear();
+		dirtyTextures.clear();
+		usedTextures = 0;
+
+		buffers.clear();
+		freeBuffers.clear();
+		dirtyBuffers.clear();
+		usedBuffers = 0;
+
+		device = nullptr;
+	}
+
+	void BindlessHeap::clampToLimits()
+	{
+		VkPhysicalDeviceVulkan12Properties vulkan12{};
+		vulkan12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+		VkPhysicalDeviceProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &vulkan12;
+		vkGetPhysicalDeviceProperties2(device->getPhysicalDevice(), &properties);
+
+		config.maxTextures = std::min({ config.maxTextures,
+			vulkan12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+			vulkan12.maxPerStageDescriptorUpdateAfterBindSamplers,
+			vulkan12.maxDescriptorSetUpdateAfterBindSampledImages,
+			vulkan12.maxDescriptorSetUpdateAfterBindSamplers });
+		config.maxBuffers = std::min({ config.maxBuffers,
+			vulkan12.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+			vulkan12.maxDescriptorSetUpdateAfterBindStorageBuffers });
+
+		// Both arrays are visible to every stage, leave room for the meshlet set and the rest of the pipeline
+		uint32_t resources = vulkan12.maxPerStageUpdateAfterBindResources;
+		if (resources > 64 && config.maxTextures + config.maxBuffers > resources - 64) {
+			config.maxBuffers = std::min(config.maxBuffers, (resources - 64) / 4);
+			config.maxTextures = resources - 64 - config.maxBuffers;
+		}
+	}
+
+	void BindlessHeap::createDescriptorSetLayout()
+	{
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].descriptorCount = config.maxTextures;
+		bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[1].descriptorCount = config.maxBuffers;
+		bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+		// Slots nobody registered are never written, so the arrays only have to be partially bound
+		std::array<VkDescriptorBindingFlags, 2> bindingFlags = {
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+		};
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+		flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		flagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+		flagsInfo.pBindingFlags = bindingFlags.data();
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = &flagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		if (vkCreateDescriptorSetLayout(device->getDevice(), &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+			Alert("Failed to create bindless descriptor set layout!", CRITICAL);
+		}
+	}
+
+	void BindlessHeap::createDescriptorSets()
+	{
+		if (descriptorSetLayout == VK_NULL_HANDLE) return;
+
+		std::array<VkDescriptorPoolSize, 2> poolSizes{};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[0].descriptorCount = config.maxTextures * MAX_FRAMES_IN_FLIGHT;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[1].descriptorCount = config.maxBuffers * MAX_FRAMES_IN_FLIGHT;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+
+		if (vkCreateDescriptorPool(device->getDevice(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+			Alert("Failed to create bindless descriptor pool!", CRITICAL);
+			descriptorPool = VK_NULL_HANDLE;
+			return;
+		}
+
+		std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> layouts;
+		layouts.fill(descriptorSetLayout);
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+		allocInfo.pSetLayouts = layouts.data();
+
+		if (vkAllocateDescriptorSets(device->getDevice(), &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+			Alert("Failed to allocate bindless descriptor sets!", CRITICAL);
+			vkDestroyDescriptorPool(device->getDevice(), descriptorPool, nullptr);
+			descriptorPool = VK_NULL_HANDLE;
+		}
+	}
+
+	uint32_t BindlessHeap::allocate(std::vector<uint32_t>& freeSlots, uint32_t& used, uint32_t capacity)
+	{
+		if (!freeSlots.empty()) {
+			uint32_t slot = freeSlots.back();
+			freeSlots.pop_back();
+			return slot;
+		}
+		if (used < capacity) return used++;
+
+		return BINDLESS_INVALID_INDEX;
+	}
+
+	uint32_t BindlessHeap::addTexture(VkImageView imageView, VkSampler sampler)
+	{
+		if (!isActive()) return BINDLESS_INVALID_INDEX;
+
+		uint32_t index = allocate(freeTextures, usedTextures, getTextureCapacity());
+		if (index == BINDLESS_INVALID_INDEX) {
+			Alert("Bindless texture array is full.", WARNING);
+			return index;
+		}
+
+		updateTexture(index, imageView, sampler);
+		return index;
+	}
+
+	void BindlessHeap::updateTexture(uint32_t index, VkImageView imageView, VkSampler sampler)
+	{
+		if (!isActive() || index >= usedTextures) return;
+
+		auto& slot = textures[index];
+		slot.info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		slot.info.imageView = imageView;
+		slot.info.sampler = sampler;
+
+		if (slot.dirtyFrames == 0) dirtyTextures.push_back(index);
+		slot.dirtyFrames = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
+	}
+
+	void BindlessHeap::removeTexture(uint32_t index)
+	{
+		if (!isActive() || index >= usedTextures) return;
+
+		// A slot is only ever rewritten in a frame's own set after its fence, reuse is immediate
+		textures[index] = {};
+		dirtyTextures.erase(std::remove(dirtyTextures.begin(), dirtyTextures.end(), index), dirtyTextures.end());
+		freeTextures.push_back(index);
+	}
+
+	uint32_t BindlessHeap::addBuffer(const VkBuffer* frameBuffers, VkDeviceSize range, const VkDeviceSize* frameOffsets)
+	{
+		if (!isActive()) return BINDLESS_INVALID_INDEX;
+
+		uint32_t index = allocate(freeBuffers, usedBuffers, getBufferCapacity());
+		if (index == BINDLESS_INVALID_INDEX) {
+			Alert("Bindless buffer array is full.", WARNING);
+			return index;
+		}
+
+		auto& slot = buffers[index];
+		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			slot.info[i] = { frameBuffers[i], frameOffsets ? frameOffsets[i] : 0, range };
+		}
+
+		dirtyBuffers.push_back(index);
+		slot.dirtyFrames = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
+		return index;
+	}
+
+	void BindlessHeap::removeBuffer(uint32_t index)
+	{
+		if (!isActive() || index >= usedBuffers) return;
+
+		buffers[index] = {};
+		dirtyBuffers.erase(std::remove(dirtyBuffers.begin(), dirtyBuffers.end(), index), dirtyBuffers.end());
+		freeBuffers.push_back(index);
+	}
+
+	void BindlessHeap::flush(uint32_t frame)
+	{
+		if (dirtyTextures.empty() && dirtyBuffers.empty()) return;
+
+		uint32_t bit = 1u << frame;
+		std::vector<VkWriteDescriptorSet> writes;
+
+		auto write = [&](uint32_t binding, uint32_t index, VkDescriptorType type) -> VkWriteDescriptorSet& {
+			VkWriteDescriptorSet descriptorWrite{};
+			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrite.dstSet = descriptorSets[frame];
+			descriptorWrite.dstBinding = binding;
+			descriptorWrite.dstArrayElement = index;
+			descriptorWrite.descriptorType = type;
+			descriptorWrite.descriptorCount = 1;
+			writes.push_back(descriptorWrite);
+			return writes.back();
+		};
+
+		for (auto it = dirtyTextures.begin(); it != dirtyTextures.end();) {
+			auto& slot = textures[*it];
+			if (slot.dirtyFrames & bit) {
+				write(0, *it, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER).pImageInfo = &slot.info;
+				slot.dirtyFrames &= ~bit;
+			}
+			it = slot.dirtyFrames == 0 ? dirtyTextures.erase(it) : it + 1;
+		}
+
+		for (auto it = dirtyBuffers.begin(); it != dirtyBuffers.end();) {
+			auto& slot = buffers[*it];
+			if (slot.dirtyFrames & bit) {
+				write(1, *it, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER).pBufferInfo = &slot.info[frame];
+				slot.dirtyFrames &= ~bit;
+			}
+			it = slot.dirtyFrames == 0 ? dirtyBuffers.erase(it) : it + 1;
+		}
+
+		if (!writes.empty()) {
+			vkUpdateDescriptorSets(device->getDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+		}
+	}
+
+	void BindlessHeap::record(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t frame, uint32_t set)
+	{
+		if (!isActive()) return;
+
+		// This frame's set is idle here, the in flight fence was waited on in beginFrame
+		flush(frame);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, set, 1, &descriptorSets[frame], 0, nullptr);
+	}
+}
@@ -2,6 +2,8 @@
 
 #include "Device.h"
 
+#include <algorithm>
+
 #define ERROR_VOLATILE(x) x; if (getAlertSeverity() == FATAL) { return; }
 
 namespace Render 
@@ -53,10 +55,36 @@ namespace Render
 				vkFreeMemory((*device).getDevice(), stagingBufferMemoryIndex, nullptr);
 				stagingBufferMemoryIndex = VK_NULL_HANDLE;
 			}
+
+			destroyMeshletBuffers();
 		}
 		isReady = false;
 	}
 
+	void Buffer::destroyMeshletBuffers()
+	{
+		if (!device) return;
+
+		if (meshletBuffer != VK_NULL_HANDLE) {
+			vkDestroyBuffer((*device).getDevice(), meshletBuffer, nullptr);
+			meshletBuffer = VK_NULL_HANDLE;
+			vkFreeMemory((*device).getDevice(), meshletBufferMemory, nullptr);
+			meshletBufferMemory = VK_NULL_HANDLE;
+		}
+		if (meshletVertexBuffer != VK_NULL_HANDLE) {
+			vkDestroyBuffer((*device).getDevice(), meshletVertexBuffer, nullptr);
+			meshletVertexBuffer = VK_NULL_HANDLE;
+			vkFreeMemory((*device).getDevice(), meshletVertexBufferMemory, nullptr);
+			meshletVertexBufferMemory = VK_NULL_HANDLE;
+		}
+		if (meshletTriangleBuffer != VK_NULL_HANDLE) {
+			vkDestroyBuffer((*device).getDevice(), meshletTriangleBuffer, nullptr);
+			meshletTriangleBuffer = VK_NULL_HANDLE;
+			vkFreeMemory((*device).getDevice(), meshletTriangleBufferMemory, nullptr);
+			meshletTriangleBufferMemory = VK_NULL_HANDLE;
+		}
+	}
+
 	uint32_t Buffer::bind(VkCommandBuffer commandBuffer)
 	{
 		VkBuffer buffers[] = { buffer };
@@ -70,7 +98,7 @@ namespace Render
 
 	void Buffer::recordSubBuffer(VkCommandBuffer commandBuffer, uint32_t index)
 	{
-		vkCmdDrawIndexed(commandBuffer, sizes[1][index], 1, offsets[1][index], offsets[0][index], 0);
+		vkCmdDrawIndexed(commandBuffer, sizes[1][index], 1, offsets[1][index], offsets[0][index], materials[index]);
 	}
 
 	void Buffer::loadData(VertexBufferData& data) 
@@ -85,7 +113,19 @@ namespace Render
 		isReady = false;
 	}
 
-	void Buffer::finalize()
+	void Buffer::loadFile(const std::string& path)
+	{
+		meshFilePaths.push_back(path);
+		isReady = false;
+	}
+
+	void Buffer::removeFile(const std::string& path)
+	{
+		meshFilePaths.erase(std::remove(meshFilePaths.begin(), meshFilePaths.end(), path), meshFilePaths.end());
+		isReady = false;
+	}
+
+	void Buffer::finalize(bool buildMeshlets)
 	{
 		vertices.clear();
 		indices.clear();
@@ -93,28 +133,98 @@ namespace Render
 		offsets[1].clear();
 		sizes[0].clear();
 		sizes[1].clear();
+		materials.clear();
 
-		for(auto& data : bufferData) {
-			offsets[0].push_back(vertices.size());
-			sizes[0].push_back(data.second.getVertices().size());
-			vertices.insert(vertices.end(), data.second.getVertices().begin(), data.second.getVertices().end());
+		useMeshlets = buildMeshlets;
+		meshletData.clear();
+		meshletOffsets.clear();
+		meshletCounts.clear();
+
+		fileVertexCount = 0;
+		fileIndexCount = 0;
 
-			offsets[1].push_back(indices.size());
-			sizes[1].push_back(data.second.getIndices().size());
-			indices.insert(indices.end(), data.second.getIndices().begin(), data.second.getIndices().end());
+		// File sub-buffers come first so their blobs land at the start of staging memory
+		openMeshFiles();
+
+		for(auto& data : bufferData) {
+			appendSubBuffer(data.second.getVertices(), data.second.getIndices(), data.second.getMaterialIndex());
 		}
 
 		loadBufferToMemory();
 	}
 
+	void Buffer::appendSubBuffer(std::vector<Vertex>& subVertices, std::vector<uint32_t>& subIndices, uint32_t material)
+	{
+		materials.push_back(material);
+
+		offsets[0].push_back(fileVertexCount + vertices.size());
+		sizes[0].push_back(subVertices.size());
+		vertices.insert(vertices.end(), subVertices.begin(), subVertices.end());
+
+		offsets[1].push_back(fileIndexCount + indices.size());
+		if (!useMeshlets) {
+			sizes[1].push_back(subIndices.size());
+			indices.insert(indices.end(), subIndices.begin(), subIndices.end());
+			return;
+		}
+
+		// Triangles are reordered so every meshlet is a contiguous index range
+		std::vector<uint32_t> meshletIndices = subIndices;
+		meshletOffsets.push_back(meshletData.meshlets.size());
+		MeshletBuilder::build(subVertices, meshletIndices, offsets[1].back(), offsets[0].back(),
+			static_cast<uint32_t>(offsets[0].size() - 1), meshletData);
+		meshletCounts.push_back(meshletData.meshlets.size() - meshletOffsets.back());
+
+		sizes[1].push_back(meshletIndices.size());
+		indices.insert(indices.end(), meshletIndices.begin(), meshletIndices.end());
+	}
+
+	void Buffer::openMeshFiles()
+	{
+		meshFiles.clear();
+
+		for (auto& path : meshFilePaths) {
+			auto file = std::make_unique<MeshFile>();
+			if (!file->open(path)) continue;
+
+			if (useMeshlets) {
+				// Meshlet building rewrites indices on the CPU, decode instead of streaming
+				std::vector<Vertex> fileVertices(file->getVertexCount());
+				std::vector<uint32_t> fileIndices(file->getIndexCount());
+				if (!file->readVertices(fileVertices.data()) || !file->readIndices(fileIndices.data())) continue;
+
+				for (auto& subMesh : file->getSubMeshes()) {
+					std::vector<Vertex> subVertices(fileVertices.begin() + subMesh.vertexOffset,
+						fileVertices.begin() + subMesh.vertexOffset + subMesh.vertexCount);
+					std::vector<uint32_t> subIndices(fileIndices.begin() + subMesh.indexOffset,
+						fileIndices.begin() + subMesh.indexOffset + subMesh.indexCount);
+					appendSubBuffer(subVertices, subIndices);
+				}
+				continue;
+			}
+
+			for (auto& subMesh : file->getSubMeshes()) {
+				materials.push_back(0);
+				offsets[0].push_back(fileVertexCount + subMesh.vertexOffset);
+				sizes[0].push_back(subMesh.vertexCount);
+				offsets[1].push_back(fileIndexCount + subMesh.indexOffset);
+				sizes[1].push_back(subMesh.indexCount);
+			}
+			fileVertexCount += file->getVertexCount();
+			fileIndexCount += file->getIndexCount();
+
+			meshFiles.push_back(std::move(file));
+		}
+	}
+
 	void Buffer::createBuffer() 
 	{
-		if (vertices.empty()) {
+		if (getNumVertices() == 0) {
 			Alert("No vertex data loaded into Buffer!", FATAL);
 			return;
 		}
 
-		bufferSizeVertex = sizeof(vertices[0]) * vertices.size();
+		bufferSizeVertex = sizeof(Vertex) * getNumVertices();
 
 		if (device.wait() != Manager::State::YES) {
 			Alert("Device not avalible!", FATAL);
@@ -126,18 +236,20 @@ namespace Render
 		fillBufferData(stagingBufferMemoryVertex);
 
 		if (buffer == VK_NULL_HANDLE) {
-			(*device).createBuffer(bufferSizeVertex, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
+			VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+			if (useMeshlets) usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT; // Read by mesh shaders
+
+			(*device).createBuffer(bufferSizeVertex, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
 		}
 	}
 
 	void Buffer::createIndexBuffer() 
 	{
-		if (indices.empty()) {
+		if (getNumIndices() == 0) {
 			Alert("No index data loaded into Buffer!", FATAL);
 			return;
 		}
-		bufferSizeIndex = sizeof(indices[0]) * indices.size();
+		bufferSizeIndex = sizeof(uint32_t) * getNumIndices();
 
 		if (device.wait() != Manager::State::YES) {
 			Alert("Device not avalible!", FATAL);
@@ -171,6 +283,7 @@ namespace Render
 
 		(*device).copyBuffer(stagingBufferVertex, buffer, bufferSizeVertex);
 		(*device).copyBuffer(stagingBufferIndex, indexBuffer, bufferSizeIndex);
+		meshFiles.clear(); // Staging holds the data now, unmap the files
 		
 		if (device.wait() != Manager::State::YES) {
 			Alert("Device died before it was ready to be used.", FATAL);
@@ -186,16 +299,37 @@ namespace Render
 		stagingBufferIndex = VK_NULL_HANDLE;
 		stagingBufferMemoryIndex = VK_NULL_HANDLE;
 
+		if (useMeshlets) {
+			ERROR_VOLATILE(createMeshletBuffers());
+		}
+
 		isReady = true;
 	}
 
+	void Buffer::createMeshletBuffers()
+	{
+		destroyMeshletBuffers();
+
+		if (meshletData.meshlets.empty()) {
+			Alert("Meshlets requested but no triangles were found in Buffer.", WARNING);
+			return;
+		}
+
+		(*device).uploadBuffer(meshletData.meshlets.data(), sizeof(Meshlet) * meshletData.meshlets.size(),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshletBuffer, meshletBufferMemory);
+		(*device).uploadBuffer(meshletData.vertices.data(), sizeof(uint32_t) * meshletData.vertices.size(),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshletVertexBuffer, meshletVertexBufferMemory);
+		(*device).uploadBuffer(meshletData.triangles.data(), sizeof(uint32_t) * meshletData.triangles.size(),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshletTriangleBuffer, meshletTriangleBufferMemory);
+	}
+
 	void Buffer::fillBufferData(VkDeviceMemory& bufferMemory)
 	{
 		if (bufferMemory == VK_NULL_HANDLE) {
 			Alert("Vertex buffer not created before filling data!", FATAL);
 			return;
 		}
-		if (vertices.empty()) {
+		if (getNumVertices() == 0) {
 			Alert("No vertex data loaded into Buffer!", FATAL);
 			return;
 		}
@@ -207,7 +341,18 @@ namespace Render
 			return;
 		}
 		vkMapMemory((*device).getDevice(), bufferMemory, 0, bufferSizeVertex, 0, &data);
-		memcpy(data, vertices.data(), (size_t)bufferSizeVertex);
+
+		auto dst = static_cast<uint8_t*>(data);
+		for (auto& file : meshFiles) {
+			if (!file->readVertices(dst)) {
+				Alert("Mesh file vertices could not be read, sub-buffers will be garbage.", CRITICAL);
+			}
+			dst += file->getVertexCount() * sizeof(Vertex);
+		}
+		if (!vertices.empty()) {
+			memcpy(dst, vertices.data(), vertices.size() * sizeof(Vertex));
+		}
+
 		vkUnmapMemory((*device).getDevice(), bufferMemory);
 	}
 
@@ -217,7 +362,7 @@ namespace Render
 			Alert("Vertex buffer not created before filling data!", FATAL);
 			return;
 		}
-		if (indices.empty()) {
+		if (getNumIndices() == 0) {
 			Alert("No vertex data loaded into Buffer!", FATAL);
 			return;
 		}
@@ -229,7 +374,18 @@ namespace Render
 			return;
 		}
 		vkMapMemory((*device).getDevice(), bufferMemory, 0, bufferSizeIndex, 0, &data);
-		memcpy(data, indices.data(), (size_t)bufferSizeIndex);
+
+		auto dst = static_cast<uint8_t*>(data);
+		for (auto& file : meshFiles) {
+			if (!file->readIndices(dst)) {
+				Alert("Mesh file indices could not be read, sub-buffers will be garbage.", CRITICAL);
+			}
+			dst += file->getIndexCount() * sizeof(uint32_t);
+		}
+		if (!indices.empty()) {
+			memcpy(dst, indices.data(), indices.size() * sizeof(uint32_t));
+		}
+
 		vkUnmapMemory((*device).getDevice(), bufferMemory);
 	}
 }
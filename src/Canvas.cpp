@@ -23,6 +23,17 @@ namespace Render
         guiInfo.MinImageCount = swapChain.getImageCount();
         guiInfo.ImageCount = swapChain.getImageCount();
         guiInfo.PipelineInfoMain.RenderPass = renderPass.getRenderPass();
+
+        if (renderPass.isDynamic()) {
+            guiColorFormat = renderPass.getColorFormat();
+
+            guiInfo.UseDynamicRendering = true;
+            guiInfo.PipelineInfoMain.PipelineRenderingCreateInfo = {};
+            guiInfo.PipelineInfoMain.PipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+            guiInfo.PipelineInfoMain.PipelineRenderingCreateInfo.colorAttachmentCount = 1;
+            guiInfo.PipelineInfoMain.PipelineRenderingCreateInfo.pColorAttachmentFormats = &guiColorFormat;
+            guiInfo.PipelineInfoMain.PipelineRenderingCreateInfo.depthAttachmentFormat = renderPass.getDepthFormat();
+        }
     }
 
     void Canvas::init(size_t deviceUUID, CanvasConstructInfo info)
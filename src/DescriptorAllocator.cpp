@@ -0,0 +1,179 @@
+#include "DescriptorAllocator.h"
+
+#include "Device.h"
+
+#include <algorithm>
+
+namespace Render
+{
+	DescriptorAllocator::DescriptorAllocator()
+	{
+	}
+
+	DescriptorAllocator::~DescriptorAllocator()
+	{
+		destroy();
+	}
+
+	void DescriptorAllocator::init(Device* device)
+	{
+		destroy();
+
+		this->device = device;
+	}
+
+	void DescriptorAllocator::destroy()
+	{
+		if (device) {
+			for (auto pool : pools) {
+				vkDestroyDescriptorPool(device->getDevice(), pool, nullptr);
+			}
+		}
+		pools.clear();
+		currentPoolSets = 0;
+
+		layouts.clear();
+		freeSets.clear();
+		retired.clear();
+
+		allocatedDescriptors.clear();
+		allocatedSets = 0;
+		liveSets = 0;
+
+		device = nullptr;
+	}
+
+	void DescriptorAllocator::registerLayout(VkDescriptorSetLayout layout, const std::vector<VkDescriptorPoolSize>& perSet)
+	{
+		layouts[layout] = perSet;
+	}
+
+	bool DescriptorAllocator::allocate(VkDescriptorSetLayout layout, uint32_t count, VkDescriptorSet* sets)
+	{
+		if (!isActive()) {
+			Alert("Descriptor sets requested before the allocator was initialized.", CRITICAL);
+			return false;
+		}
+
+		// Recycled sets first
+		uint32_t recycled = 0;
+		auto& available = freeSets[layout];
+		while (recycled < count && !available.empty()) {
+			sets[recycled++] = available.back();
+			available.pop_back();
+		}
+		liveSets += recycled;
+		if (recycled == count) return true;
+
+		uint32_t remaining = count - recycled;
+		VkResult result = pools.empty() ? VK_ERROR_OUT_OF_POOL_MEMORY : allocateFromPool(layout, remaining, sets + recycled);
+
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+			if (createPool(layout, remaining)) {
+				result = allocateFromPool(layout, remaining, sets + recycled);
+			}
+		}
+
+		if (result != VK_SUCCESS) {
+			Alert("Failed to allocate descriptor sets!", CRITICAL);
+			free(layout, recycled, sets); // Hand back what was recycled, nothing used it
+			return false;
+		}
+
+		liveSets += remaining;
+		allocatedSets += remaining;
+		auto perSet = layouts.find(layout);
+		if (perSet != layouts.end()) {
+			for (auto& size : perSet->second) {
+				allocatedDescriptors[size.type] += static_cast<uint64_t>(size.descriptorCount) * remaining;
+			}
+		}
+		return true;
+	}
+
+	VkResult DescriptorAllocator::allocateFromPool(VkDescriptorSetLayout layout, uint32_t count, VkDescriptorSet* sets)
+	{
+		std::vector<VkDescriptorSetLayout> setLayouts(count, layout);
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = pools.back();
+		allocInfo.descriptorSetCount = count;
+		allocInfo.pSetLayouts = setLayouts.data();
+
+		return vkAllocateDescriptorSets(device->getDevice(), &allocInfo, sets);
+	}
+
+	bool DescriptorAllocator::createPool(VkDescriptorSetLayout layout, uint32_t count)
+	{
+		uint32_t maxSets = pools.empty() ? DESCRIPTOR_POOL_INITIAL_SETS : std::min(currentPoolSets * 2, static_cast<uint32_t>(DESCRIPTOR_POOL_MAX_SETS));
+		maxSets = std::max(maxSets, count);
+
+		// Average descriptors per set seen so far, never less than the pending request needs
+		std::map<VkDescriptorType, uint64_t> counts;
+		for (auto& observed : allocatedDescriptors) {
+			counts[observed.first] = (observed.second * maxSets + allocatedSets - 1) / allocatedSets;
+		}
+
+		auto perSet = layouts.find(layout);
+		if (perSet != layouts.end()) {
+			for (auto& size : perSet->second) {
+				counts[size.type] = std::max(counts[size.type], static_cast<uint64_t>(size.descriptorCount) * count);
+			}
+		}
+		else {
+			Alert("Descriptor set layout was not registered, guessing pool sizes.", WARNING);
+			counts[VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER] = std::max<uint64_t>(counts[VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER], maxSets);
+			counts[VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER] = std::max<uint64_t>(counts[VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER], maxSets);
+		}
+
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (auto& size : counts) {
+			if (size.second == 0) continue;
+			poolSizes.push_back({ size.first, static_cast<uint32_t>(std::min<uint64_t>(size.second, UINT32_MAX)) });
+		}
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = maxSets;
+
+		VkDescriptorPool pool = VK_NULL_HANDLE;
+		if (vkCreateDescriptorPool(device->getDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+			Alert("Failed to create descriptor pool!", CRITICAL);
+			return false;
+		}
+
+		pools.push_back(pool);
+		currentPoolSets = maxSets;
+
+		Alert("Descriptor pool " + std::to_string(pools.size()) + " created for " + std::to_string(maxSets) + " sets.", INFO);
+		return true;
+	}
+
+	void DescriptorAllocator::free(VkDescriptorSetLayout layout, uint32_t count, const VkDescriptorSet* sets)
+	{
+		if (!isActive()) return;
+
+		for (uint32_t i = 0; i < count; i++) {
+			if (sets[i] == VK_NULL_HANDLE) continue;
+
+			retired.push_back({ layout, sets[i], MAX_FRAMES_IN_FLIGHT });
+			liveSets--;
+		}
+	}
+
+	void DescriptorAllocator::advanceFrame()
+	{
+		for (auto it = retired.begin(); it != retired.end();) {
+			if (--it->framesLeft == 0) {
+				freeSets[it->layout].push_back(it->set);
+				it = retired.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+}
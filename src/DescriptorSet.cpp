@@ -8,22 +8,14 @@
 
 namespace Render
 {
-	int DescriptorSet::amountOfObjects = 0;
-
     DescriptorSet::DescriptorSet()
     {
 		clear();
-		amountOfObjects += 1;
-		if (amountOfObjects > MAX_OBJECTS) {
-			Alert("User created more descriptors than currently allowed.", CRITICAL);
-			delete this;
-		}
     }
 
     DescriptorSet::~DescriptorSet()
     {
-		clear();
-		amountOfObjects -= 1;
+		release();
     }
 
 	void DescriptorSet::init(size_t deviceUUID)
@@ -39,6 +31,8 @@ namespace Render
 
 	void DescriptorSet::destroy()
 	{
+		release();
+
 		for (auto descriptorResource : descriptorResources) {
 			if (auto ptr = descriptorResource.lock()) {
 				ptr->destroy();
@@ -46,16 +40,19 @@ namespace Render
 		}
 	}
 
-	void DescriptorSet::create(VkDescriptorSetAllocateInfo info)
+	void DescriptorSet::create(VkDescriptorSetLayout layout)
 	{
 		if (device.wait() != Manager::State::YES) {
 			Alert("Device died before it was ready to be used", FATAL);
 			return;
 		}
-		if (vkAllocateDescriptorSets((*device).getDevice(), &info, descriptorSets.data()) != VK_SUCCESS) {
+		release();
+
+		if (!(*device).getDescriptorAllocator().allocate(layout, MAX_FRAMES_IN_FLIGHT, descriptorSets.data())) {
 			Alert("Failed to allocate descriptor sets!", FATAL);
 			return;
 		}
+		descriptorSetLayout = layout;
 
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 			auto descriptorWrites = getInfo(i);
@@ -63,6 +60,16 @@ namespace Render
 		}
 	}
 
+	void DescriptorSet::release()
+	{
+		// Sets may still be used by frames in flight, the allocator holds them back until they are done
+		if (device && descriptorSetLayout != VK_NULL_HANDLE) {
+			(*device).getDescriptorAllocator().free(descriptorSetLayout, MAX_FRAMES_IN_FLIGHT, descriptorSets.data());
+		}
+		descriptorSetLayout = VK_NULL_HANDLE;
+		clear();
+	}
+
 	void DescriptorSet::clear()
 	{
 		descriptorSets = {VK_NULL_HANDLE, VK_NULL_HANDLE};
@@ -71,15 +78,17 @@ namespace Render
 	void DescriptorSet::addDescriptorResource(std::weak_ptr<DescriptorResource>& descriptorResource)
 	{
 		descriptorResources.emplace_back(descriptorResource);
+		writtenGenerations.emplace_back();
 	}
 
 	std::vector<VkWriteDescriptorSet> DescriptorSet::getInfo(int frame)
 	{ // TODO: Logging with custom types, Dump info in object
 
 		std::vector<VkWriteDescriptorSet> descriptorWrites;
-		for (auto descriptorResource : descriptorResources) {
-			if (auto ptr = descriptorResource.lock()) {
+		for (size_t i = 0; i < descriptorResources.size(); i++) {
+			if (auto ptr = descriptorResources[i].lock()) {
 				descriptorWrites.emplace_back(ptr->createWrite(frame, descriptorSets[frame]));
+				writtenGenerations[i][frame] = ptr->getWriteGeneration();
 			}
 		}
 
@@ -88,17 +97,60 @@ namespace Render
 
 	VkDescriptorSet& DescriptorSet::getDescriptorSet(uint32_t frame) 
 	{		
+		// Each set tracks what it wrote itself, a resource shared by several sets is rewritten in all of them
+		std::vector<VkWriteDescriptorSet> rewrites;
+		for (size_t i = 0; i < descriptorResources.size(); i++) {
+			if (auto ptr = descriptorResources[i].lock()) {
+				if (ptr->consumeDirty(frame)) ptr->update(frame);
+
+				uint32_t generation = ptr->getWriteGeneration();
+				if (writtenGenerations[i][frame] != generation) {
+					rewrites.emplace_back(ptr->createWrite(frame, descriptorSets[frame]));
+					writtenGenerations[i][frame] = generation;
+				}
+			}
+		}
+
+		// This frame's set is idle here, the in flight fence was waited on in beginFrame
+		if (!rewrites.empty()) {
+			vkUpdateDescriptorSets((*device).getDevice(), static_cast<uint32_t>(rewrites.size()), rewrites.data(), 0, nullptr);
+		}
+
+		return descriptorSets[frame];
+	}
+
+	void DescriptorSet::updateResources(uint32_t frame)
+	{
 		for (auto descriptorResource : descriptorResources) {
 			if (auto ptr = descriptorResource.lock()) {
-				ptr->update(frame);
+				if (ptr->consumeDirty(frame)) ptr->update(frame);
 			}
 		}
+	}
 
-		return descriptorSets[frame];
+	std::vector<uint32_t> DescriptorSet::getDynamicOffsets(uint32_t frame)
+	{
+		std::vector<uint32_t> offsets;
+		for (auto descriptorResource : descriptorResources) {
+			if (auto ptr = descriptorResource.lock()) {
+				uint32_t offset = 0;
+				if (ptr->getDynamicOffset(frame, offset)) offsets.push_back(offset);
+			}
+		}
+
+		return offsets;
 	}
 
-	void DescriptorSet::record(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t frame)
+	void DescriptorSet::record(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t frame, uint32_t set,
+		const uint32_t* dynamicOffsets, uint32_t dynamicOffsetCount)
 	{
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &(getDescriptorSet(frame)), 0, nullptr);
+		std::vector<uint32_t> offsets;
+		if (dynamicOffsets == nullptr) {
+			offsets = getDynamicOffsets(frame);
+			dynamicOffsets = offsets.data();
+			dynamicOffsetCount = static_cast<uint32_t>(offsets.size());
+		}
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, set, 1, &(getDescriptorSet(frame)), dynamicOffsetCount, dynamicOffsets);
 	}
 }
\ No newline at end of file
@@ -80,6 +80,17 @@ namespace Render
 	void Device::destroy()
 	{
 		if (m_instance) {
+			m_shaderWatcher.destroy();
+			m_textureStreamer.destroy();
+			m_textureCache.destroy();
+			m_pipelineCache.destroy(); // Joins compiles still reading shader modules
+			m_shaderCache.destroy();
+			m_uniformRing.destroy();
+			m_bindlessHeap.destroy();
+			m_frameGlobals.destroy();
+			m_samplerCache.destroy();
+			m_descriptorAllocator.destroy();
+
 			if (m_commandPool != VK_NULL_HANDLE) {
 				vkDestroyCommandPool(m_device, m_commandPool, nullptr);
 				m_commandPool = VK_NULL_HANDLE;
@@ -146,8 +157,39 @@ namespace Render
 		createCommmandPool();
 		createCommandBuffers();
 
+		m_descriptorAllocator.init(this);
+
 		createDescriptorSetLayout();
 		createDescriptorPool();
+
+		m_frameGlobals.init(this);
+		m_samplerCache.init(this);
+		m_textureCache.init(this, m_config.textureCache);
+		m_shaderCache.init(this);
+		m_pipelineCache.init(this, m_config.pipelineCache);
+
+		if (m_config.shaderHotReload) {
+			m_shaderWatcher.init(this);
+		}
+
+		m_textureStreamer.init(this, m_config.textureStreaming);
+
+		if (m_config.bindless.enabled) {
+			if (m_features.descriptorIndexing) {
+				m_bindlessHeap.init(this, m_config.bindless);
+			}
+			else {
+				Alert("Bindless descriptors requested but descriptor indexing is unavailable, falling back to per draw descriptor sets.", WARNING);
+			}
+		}
+
+		// After the bindless heap, ring slices are also registered as storage buffers
+		for (auto& reservation : m_config.descriptorSetReservations) {
+			if (reservation.types == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC) {
+				m_uniformRing.init(this, m_config.uniformRingSize);
+				break;
+			}
+		}
 	}
 
 	void Device::setupDebugMessenger() 
@@ -241,7 +283,7 @@ namespace Render
 		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.pEngineName = "No Engine";
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion = VK_API_VERSION_1_0;
+		appInfo.apiVersion = VK_API_VERSION_1_2;
 
 		VkInstanceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -425,6 +467,7 @@ namespace Render
 		}
 		Alert(messsage, INFO);
 		m_physicalDevice = candidates.rbegin()->second;
+		vkGetPhysicalDeviceProperties(m_physicalDevice, &m_properties);
 		m_config.desiredMSAASamples = getMaxUsableSampleCount();
 		m_queueFamilyIndices = findQueueFamilies(m_physicalDevice);
 	}
@@ -444,19 +487,170 @@ namespace Render
 			queueCreateInfos.push_back(queueCreateInfo);
 		}
 
-		VkPhysicalDeviceFeatures deviceFeatures{};
-		deviceFeatures.samplerAnisotropy = VK_TRUE;
-		deviceFeatures.sampleRateShading = VK_TRUE;
+		m_enabledDeviceExtensions = getEnabledDeviceExtensions();
+		bool isVulkan12 = m_properties.apiVersion >= VK_API_VERSION_1_2;
+
+		// Query optional features, each struct is chained only when its extension is enabled
+		void* supportedChain = nullptr;
+
+		VkPhysicalDeviceMeshShaderFeaturesEXT supportedMeshShader{};
+		supportedMeshShader.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+		if (isExtensionEnabled(VK_EXT_MESH_SHADER_EXTENSION_NAME)) {
+			supportedMeshShader.pNext = supportedChain;
+			supportedChain = &supportedMeshShader;
+		}
+
+		VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT supportedPipelineLibrary{};
+		supportedPipelineLibrary.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+		bool pipelineLibraryExtensions = isExtensionEnabled(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+			isExtensionEnabled(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+		if (pipelineLibraryExtensions) {
+			supportedPipelineLibrary.pNext = supportedChain;
+			supportedChain = &supportedPipelineLibrary;
+		}
+
+		VkPhysicalDeviceExtendedDynamicStateFeaturesEXT supportedDynamicState{};
+		supportedDynamicState.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+		if (isExtensionEnabled(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) {
+			supportedDynamicState.pNext = supportedChain;
+			supportedChain = &supportedDynamicState;
+		}
+
+		VkPhysicalDeviceExtendedDynamicState3FeaturesEXT supportedDynamicState3{};
+		supportedDynamicState3.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+		if (isExtensionEnabled(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME)) {
+			supportedDynamicState3.pNext = supportedChain;
+			supportedChain = &supportedDynamicState3;
+		}
+
+		VkPhysicalDeviceSynchronization2FeaturesKHR supportedSynchronization2{};
+		supportedSynchronization2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+		if (isExtensionEnabled(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME)) {
+			supportedSynchronization2.pNext = supportedChain;
+			supportedChain = &supportedSynchronization2;
+		}
+
+		VkPhysicalDeviceDynamicRenderingFeaturesKHR supportedDynamicRendering{};
+		supportedDynamicRendering.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+		if (isExtensionEnabled(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)) {
+			supportedDynamicRendering.pNext = supportedChain;
+			supportedChain = &supportedDynamicRendering;
+		}
+
+		VkPhysicalDeviceVulkan12Features supportedVulkan12{};
+		supportedVulkan12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		supportedVulkan12.pNext = supportedChain;
+
+		VkPhysicalDeviceFeatures2 supportedFeatures{};
+		supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supportedFeatures.pNext = isVulkan12 ? &supportedVulkan12 : nullptr;
+		vkGetPhysicalDeviceFeatures2(m_physicalDevice, &supportedFeatures);
+
+		m_features.meshShader = isVulkan12 && supportedMeshShader.meshShader && supportedMeshShader.taskShader;
+		m_features.drawIndirectCount = isVulkan12 && supportedVulkan12.drawIndirectCount;
+		m_features.multiDrawIndirect = supportedFeatures.features.multiDrawIndirect;
+		m_features.textureCompressionBC = supportedFeatures.features.textureCompressionBC;
+		m_features.descriptorIndexing = isVulkan12 && supportedVulkan12.descriptorIndexing &&
+			supportedVulkan12.runtimeDescriptorArray &&
+			supportedVulkan12.descriptorBindingPartiallyBound &&
+			supportedVulkan12.descriptorBindingSampledImageUpdateAfterBind &&
+			supportedVulkan12.descriptorBindingStorageBufferUpdateAfterBind &&
+			supportedVulkan12.shaderSampledImageArrayNonUniformIndexing;
+		m_features.graphicsPipelineLibrary = isVulkan12 && pipelineLibraryExtensions && supportedPipelineLibrary.graphicsPipelineLibrary;
+		m_features.extendedDynamicState = isVulkan12 && supportedDynamicState.extendedDynamicState;
+		m_features.extendedDynamicState3 = isVulkan12 && supportedDynamicState3.extendedDynamicState3PolygonMode &&
+			supportedDynamicState3.extendedDynamicState3ColorBlendEnable &&
+			supportedDynamicState3.extendedDynamicState3ColorBlendEquation;
+		m_features.synchronization2 = isVulkan12 && supportedSynchronization2.synchronization2;
+		m_features.dynamicRendering = isVulkan12 && m_config.dynamicRendering && supportedDynamicRendering.dynamicRendering;
+		m_features.occlusionQueryPrecise = supportedFeatures.features.occlusionQueryPrecise;
+
+		// Enable
+		void* enabledChain = nullptr;
+
+		VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+		meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+		meshShaderFeatures.taskShader = VK_TRUE;
+		meshShaderFeatures.meshShader = VK_TRUE;
+		if (m_features.meshShader) {
+			meshShaderFeatures.pNext = enabledChain;
+			enabledChain = &meshShaderFeatures;
+		}
+
+		VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures{};
+		pipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+		pipelineLibraryFeatures.graphicsPipelineLibrary = VK_TRUE;
+		if (m_features.graphicsPipelineLibrary) {
+			pipelineLibraryFeatures.pNext = enabledChain;
+			enabledChain = &pipelineLibraryFeatures;
+		}
+
+		VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures{};
+		dynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+		dynamicStateFeatures.extendedDynamicState = VK_TRUE;
+		if (m_features.extendedDynamicState) {
+			dynamicStateFeatures.pNext = enabledChain;
+			enabledChain = &dynamicStateFeatures;
+		}
+
+		VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamicState3Features{};
+		dynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+		dynamicState3Features.extendedDynamicState3PolygonMode = VK_TRUE;
+		dynamicState3Features.extendedDynamicState3ColorBlendEnable = VK_TRUE;
+		dynamicState3Features.extendedDynamicState3ColorBlendEquation = VK_TRUE;
+		if (m_features.extendedDynamicState3) {
+			dynamicState3Features.pNext = enabledChain;
+			enabledChain = &dynamicState3Features;
+		}
+
+		VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+		synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+		synchronization2Features.synchronization2 = VK_TRUE;
+		if (m_features.synchronization2) {
+			synchronization2Features.pNext = enabledChain;
+			enabledChain = &synchronization2Features;
+		}
+
+		VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+		dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+		dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+		if (m_features.dynamicRendering) {
+			dynamicRenderingFeatures.pNext = enabledChain;
+			enabledChain = &dynamicRenderingFeatures;
+		}
+
+		VkPhysicalDeviceVulkan12Features vulkan12Features{};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		vulkan12Features.drawIndirectCount = m_features.drawIndirectCount;
+		if (m_config.bindless.enabled && m_features.descriptorIndexing) {
+			vulkan12Features.descriptorIndexing = VK_TRUE;
+			vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+			vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+			vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+			vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		}
+		vulkan12Features.pNext = enabledChain;
+
+		VkPhysicalDeviceFeatures2 deviceFeatures{};
+		deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		deviceFeatures.features.samplerAnisotropy = VK_TRUE;
+		deviceFeatures.features.sampleRateShading = VK_TRUE;
+		deviceFeatures.features.multiDrawIndirect = m_features.multiDrawIndirect;
+		deviceFeatures.features.textureCompressionBC = m_features.textureCompressionBC;
+		deviceFeatures.features.occlusionQueryPrecise = m_features.occlusionQueryPrecise;
+		deviceFeatures.pNext = isVulkan12 ? &vulkan12Features : nullptr;
 
 		VkDeviceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		createInfo.pNext = &deviceFeatures;
 
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
-		createInfo.pEnabledFeatures = &deviceFeatures;
+		createInfo.pEnabledFeatures = nullptr;
 
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(m_deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = m_deviceExtensions.data();
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(m_enabledDeviceExtensions.size());
+		createInfo.ppEnabledExtensionNames = m_enabledDeviceExtensions.data();
 
 		if (m_enableValidationLayers) {
 			createInfo.enabledLayerCount = static_cast<uint32_t>(m_validationLayers.size());
@@ -466,8 +660,6 @@ namespace Render
 			createInfo.enabledLayerCount = 0;
 		}
 
-		// No device specific extensions needed yet
-
 		if (vkCreateDevice(m_physicalDevice, &createInfo, nullptr, &m_device) != VK_SUCCESS) {
 			Alert("Failed to create logical device!", FATAL);
 			return;
@@ -475,6 +667,66 @@ namespace Render
 
 		vkGetDeviceQueue(m_device, m_queueFamilyIndices.graphicsFamily.value(), 0, &m_graphicsQueue);
 		vkGetDeviceQueue(m_device, m_queueFamilyIndices.presentFamily.value(), 0, &m_presentQueue);
+
+		if (m_features.meshShader) {
+			m_vkCmdDrawMeshTasks = (PFN_vkCmdDrawMeshTasksEXT)vkGetDeviceProcAddr(m_device, "vkCmdDrawMeshTasksEXT");
+			m_features.meshShader = m_vkCmdDrawMeshTasks != nullptr;
+		}
+
+		if (m_features.dynamicRendering) {
+			m_vkCmdBeginRendering = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(m_device, "vkCmdBeginRenderingKHR");
+			m_vkCmdEndRendering = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(m_device, "vkCmdEndRenderingKHR");
+			m_features.dynamicRendering = m_vkCmdBeginRendering != nullptr && m_vkCmdEndRendering != nullptr;
+		}
+
+		Alert(std::string("Mesh shaders: ") + (m_features.meshShader ? "enabled" : "unavailable") +
+			", draw indirect count: " + (m_features.drawIndirectCount ? "enabled" : "unavailable") +
+			", BC textures: " + (m_features.textureCompressionBC ? "enabled" : "unavailable") +
+			", descriptor indexing: " + (m_features.descriptorIndexing ? "available" : "unavailable") +
+			", pipeline libraries: " + (m_features.graphicsPipelineLibrary ? "enabled" : "unavailable") +
+			", extended dynamic state: " + (m_features.extendedDynamicState3 ? "1 and 3" : (m_features.extendedDynamicState ? "1" : "unavailable")) +
+			", synchronization2: " + (m_features.synchronization2 ? "enabled" : "unavailable") +
+			", dynamic rendering: " + (m_features.dynamicRendering ? "enabled" : "off"), INFO);
+	}
+
+	std::vector<const char*> Device::getEnabledDeviceExtensions()
+	{
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+		std::vector<const char*> extensions(m_deviceExtensions.begin(), m_deviceExtensions.end());
+		for (const auto& optional : m_optionalDeviceExtensions) {
+			for (const auto& extension : availableExtensions) {
+				if (strcmp(optional, extension.extensionName) == 0) {
+					extensions.push_back(optional);
+					break;
+				}
+			}
+		}
+
+		return extensions;
+	}
+
+	bool Device::isExtensionEnabled(const char* extension)
+	{
+		for (const auto& enabled : m_enabledDeviceExtensions) {
+			if (strcmp(enabled, extension) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void Device::cmdDrawMeshTasks(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+	{
+		if (!m_features.meshShader) {
+			Alert("Mesh task draw recorded on a device without mesh shader support.", CRITICAL);
+			return;
+		}
+		m_vkCmdDrawMeshTasks(commandBuffer, groupCountX, groupCountY, groupCountZ);
 	}
 
 	void Device::createCommmandPool()
@@ -539,6 +791,13 @@ namespace Render
 			Alert("Failed to begin recording command buffer", FATAL);
 			return;
 		}
+
+		m_descriptorAllocator.advanceFrame();
+		m_frameGlobals.flush(m_currentFrame);
+		m_textureCache.advanceFrame();
+		m_shaderWatcher.poll();
+		m_pipelineCache.advanceFrame();
+		m_textureStreamer.record(info.currentCommandBuffer, m_currentFrame);
 	}
 
 	void Device::startSwapChainRenderPass(DrawInfo& info)
@@ -548,23 +807,115 @@ namespace Render
 			return;
 		}
 
-		VkRenderPassBeginInfo renderPassInfo{};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = info.renderPass.getRenderPass();
-		renderPassInfo.framebuffer = info.swapChain.getFramebuffer(); // Here
-
-		renderPassInfo.renderArea.offset = { 0, 0 };
-		renderPassInfo.renderArea.extent = info.swapChain.getExtent();
-
 		std::array<VkClearValue, 2> clearValues{};
 		clearValues[0].color = { {m_config.clearColor.x, m_config.clearColor.y, m_config.clearColor.z, 1.0f} };
 		clearValues[1].depthStencil = {1.0f, 0};
 
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues = clearValues.data();
+		if (info.renderPass.isDynamic()) {
+			// Single sampled targets render straight into the swapchain image, nothing to resolve
+			bool resolve = m_config.desiredMSAASamples != VK_SAMPLE_COUNT_1_BIT;
+			auto& swapChainImage = info.swapChain.getImageBuffer();
+
+			VkRenderingAttachmentInfoKHR colorAttachment{};
+			colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+			colorAttachment.imageView = resolve ? info.swapChain.getColorBuffer().getImageView() : swapChainImage.getImageView();
+			colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			colorAttachment.resolveMode = resolve ? VK_RESOLVE_MODE_AVERAGE_BIT : VK_RESOLVE_MODE_NONE;
+			colorAttachment.resolveImageView = resolve ? swapChainImage.getImageView() : VK_NULL_HANDLE;
+			colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			colorAttachment.storeOp = resolve ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+			colorAttachment.clearValue = clearValues[0];
+
+			VkRenderingAttachmentInfoKHR depthAttachment{};
+			depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+			depthAttachment.imageView = info.swapChain.getDepthBuffer().getImageView();
+			depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			depthAttachment.resolveMode = VK_RESOLVE_MODE_NONE;
+			depthAttachment.loadOp = info.depthPrepass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+			depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			depthAttachment.clearValue = clearValues[1];
+
+			VkRenderingInfoKHR renderingInfo{};
+			renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+			renderingInfo.renderArea.offset = { 0, 0 };
+			renderingInfo.renderArea.extent = info.swapChain.getExtent();
+			renderingInfo.layerCount = 1;
+			renderingInfo.colorAttachmentCount = 1;
+			renderingInfo.pColorAttachments = &colorAttachment;
+			renderingInfo.pDepthAttachment = &depthAttachment;
+
+			m_vkCmdBeginRendering(info.currentCommandBuffer, &renderingInfo);
+		}
+		else {
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			// Compatible with the main pass, so its framebuffers and pipelines work unchanged
+			renderPassInfo.renderPass = info.depthPrepass ? info.renderPass.getLoadDepthRenderPass() : info.renderPass.getRenderPass();
+			renderPassInfo.framebuffer = info.swapChain.getFramebuffer(); // Here
+
+			renderPassInfo.renderArea.offset = { 0, 0 };
+			renderPassInfo.renderArea.extent = info.swapChain.getExtent();
+
+			renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+			renderPassInfo.pClearValues = clearValues.data();
+
+			vkCmdBeginRenderPass(info.currentCommandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		}
+
+		setViewportAndScissor(info);
+	}
 
-		vkCmdBeginRenderPass(info.currentCommandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	void Device::startDepthPrepass(DrawInfo& info)
+	{
+		if (!isFrameRendering) {
+			Alert("Cannot start pass while a draw is not in progress.", CRITICAL);
+			return;
+		}
 
+		VkClearValue clearValue{};
+		clearValue.depthStencil = { 1.0f, 0 };
+
+		if (info.renderPass.isDynamic()) {
+			VkRenderingAttachmentInfoKHR depthAttachment{};
+			depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+			depthAttachment.imageView = info.swapChain.getDepthBuffer().getImageView();
+			depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			depthAttachment.resolveMode = VK_RESOLVE_MODE_NONE;
+			depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			depthAttachment.clearValue = clearValue;
+
+			VkRenderingInfoKHR renderingInfo{};
+			renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+			renderingInfo.renderArea.offset = { 0, 0 };
+			renderingInfo.renderArea.extent = info.swapChain.getExtent();
+			renderingInfo.layerCount = 1;
+			renderingInfo.colorAttachmentCount = 0;
+			renderingInfo.pDepthAttachment = &depthAttachment;
+
+			m_vkCmdBeginRendering(info.currentCommandBuffer, &renderingInfo);
+		}
+		else {
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = info.renderPass.getDepthRenderPass();
+			renderPassInfo.framebuffer = info.swapChain.getDepthFramebuffer();
+
+			renderPassInfo.renderArea.offset = { 0, 0 };
+			renderPassInfo.renderArea.extent = info.swapChain.getExtent();
+
+			renderPassInfo.clearValueCount = 1;
+			renderPassInfo.pClearValues = &clearValue;
+
+			vkCmdBeginRenderPass(info.currentCommandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		}
+
+		setViewportAndScissor(info);
+	}
+
+	void Device::setViewportAndScissor(DrawInfo& info)
+	{
 		VkViewport viewport{};
 		viewport.x = 0.0f;
 		viewport.y = 0.0f;
@@ -587,7 +938,12 @@ namespace Render
 			return;
 		}
 
-		vkCmdEndRenderPass(info.currentCommandBuffer);
+		if (info.renderPass.isDynamic()) {
+			m_vkCmdEndRendering(info.currentCommandBuffer);
+		}
+		else {
+			vkCmdEndRenderPass(info.currentCommandBuffer);
+		}
 	}
 
 	void Device::endFrame(DrawInfo& info)
@@ -680,6 +1036,30 @@ namespace Render
 		endSingleTimeCommands(commandBuffer);
 	}
 
+	void Device::uploadBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+	{
+		VkBuffer stagingBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+
+		ERROR_VOLATILE(createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory));
+
+		void* mapped;
+		vkMapMemory(m_device, stagingBufferMemory, 0, size, 0, &mapped);
+		memcpy(mapped, data, (size_t)size);
+		vkUnmapMemory(m_device, stagingBufferMemory);
+
+		if (buffer == VK_NULL_HANDLE) {
+			createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
+		}
+		if (buffer != VK_NULL_HANDLE) {
+			copyBuffer(stagingBuffer, buffer, size);
+		}
+
+		vkDestroyBuffer(m_device, stagingBuffer, nullptr);
+		vkFreeMemory(m_device, stagingBufferMemory, nullptr);
+	}
+
 	VkCommandBuffer Device::beginSingleTimeCommands() {
 		VkCommandBufferAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -750,20 +1130,22 @@ namespace Render
 		
 		if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
 			Alert("Failed to create descriptor set layout!", FATAL);
+			return;
+		}
+
+		std::vector<VkDescriptorPoolSize> perSet;
+		for (auto& binding : bindings) {
+			perSet.push_back({ binding.descriptorType, binding.descriptorCount });
 		}
+		m_descriptorAllocator.registerLayout(descriptorSetLayout, perSet);
 	}
 
     void Device::createDescriptorPool()
 	{
-		std::array<VkDescriptorPoolSize, 3> poolSizes{};
-		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * MAX_OBJECTS);
-        poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * MAX_OBJECTS);
-
-		// ImGUI
-		poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		poolSizes[2].descriptorCount = IMGUI_IMPL_VULKAN_MINIMUM_IMAGE_SAMPLER_POOL_SIZE;
+		// ImGUI, object descriptor sets are allocated through m_descriptorAllocator
+		std::array<VkDescriptorPoolSize, 1> poolSizes{};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[0].descriptorCount = IMGUI_IMPL_VULKAN_MINIMUM_IMAGE_SAMPLER_POOL_SIZE;
 
 		VkDescriptorPoolCreateInfo poolInfo{};
 		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -772,7 +1154,7 @@ namespace Render
 
 		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
 
-		poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * MAX_OBJECTS) + poolSizes[2].descriptorCount;
+		poolInfo.maxSets = poolSizes[0].descriptorCount;
 
 		if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
 			Alert("Failed to create descriptor pool!", FATAL);
@@ -782,21 +1164,12 @@ namespace Render
 
 	 void Device::createDescriptorSets(std::shared_ptr<DescriptorSet>& descriptorSet)
     {
-		if (descriptorPool == VK_NULL_HANDLE || descriptorSetLayout == VK_NULL_HANDLE) {
-			Alert("Descriptor pool or set layout not ready before allocating descriptor sets.", FATAL);
+		if (!m_descriptorAllocator.isActive() || descriptorSetLayout == VK_NULL_HANDLE) {
+			Alert("Descriptor allocator or set layout not ready before allocating descriptor sets.", FATAL);
 			return;
 		}
 
-		std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
-
-		VkDescriptorSetAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = descriptorPool;
-		allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-		allocInfo.pSetLayouts = layouts.data();
-
-		descriptorSet->clear();
-		descriptorSet->create(allocInfo);
+		descriptorSet->create(descriptorSetLayout);
     }
 
 	VKAPI_ATTR VkBool32 VKAPI_CALL Device::debugCallback(
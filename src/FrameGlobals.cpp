@@ -0,0 +1,131 @@
+#include "FrameGlobals.h"
+
+#include "Device.h"
+
+#include <cstring>
+
+namespace Render
+{
+	FrameGlobals::FrameGlobals()
+	{
+	}
+
+	FrameGlobals::~FrameGlobals()
+	{
+		destroy();
+	}
+
+	void FrameGlobals::init(Device* device)
+	{
+		destroy();
+
+		this->device = device;
+
+		createDescriptorSetLayout();
+		createBuffers();
+		createDescriptorSets();
+
+		dirtyFrames = ~0u;
+	}
+
+	void FrameGlobals::destroy()
+	{
+		if (device) {
+			if (descriptorSetLayout != VK_NULL_HANDLE) {
+				device->getDescriptorAllocator().free(descriptorSetLayout, MAX_FRAMES_IN_FLIGHT, descriptorSets.data());
+				vkDestroyDescriptorSetLayout(device->getDevice(), descriptorSetLayout, nullptr);
+				descriptorSetLayout = VK_NULL_HANDLE;
+			}
+
+			for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+				if (buffersMapped[i] != nullptr) vkUnmapMemory(device->getDevice(), buffersMemory[i]);
+				vkDestroyBuffer(device->getDevice(), buffers[i], nullptr);
+				vkFreeMemory(device->getDevice(), buffersMemory[i], nullptr);
+			}
+		}
+
+		buffers = {};
+		buffersMemory = {};
+		buffersMapped = {};
+		descriptorSets = {};
+		dirtyFrames = 0;
+
+		device = nullptr;
+	}
+
+	void FrameGlobals::createDescriptorSetLayout()
+	{
+		VkDescriptorSetLayoutBinding binding{};
+		binding.binding = 0;
+		binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		binding.descriptorCount = 1;
+		binding.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+		if (device->getFeatures().meshShader) binding.stageFlags |= VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+		binding.pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = 1;
+		layoutInfo.pBindings = &binding;
+
+		if (vkCreateDescriptorSetLayout(device->getDevice(), &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+			Alert("Failed to create frame globals descriptor set layout!", CRITICAL);
+			return;
+		}
+
+		device->getDescriptorAllocator().registerLayout(descriptorSetLayout, { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 } });
+	}
+
+	void FrameGlobals::createBuffers()
+	{
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			device->createBuffer(sizeof(FrameGlobalData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffers[i], buffersMemory[i]);
+
+			if (vkMapMemory(device->getDevice(), buffersMemory[i], 0, sizeof(FrameGlobalData), 0, &buffersMapped[i]) != VK_SUCCESS) {
+				Alert("Failed to map frame globals buffer!", CRITICAL);
+				buffersMapped[i] = nullptr;
+			}
+		}
+	}
+
+	void FrameGlobals::createDescriptorSets()
+	{
+		if (descriptorSetLayout == VK_NULL_HANDLE ||
+			!device->getDescriptorAllocator().allocate(descriptorSetLayout, MAX_FRAMES_IN_FLIGHT, descriptorSets.data())) {
+			Alert("Failed to allocate frame globals descriptor sets!", CRITICAL);
+			return;
+		}
+
+		// Each frame's set always points at that frame's buffer, only the contents change
+		std::array<VkDescriptorBufferInfo, MAX_FRAMES_IN_FLIGHT> bufferInfos{};
+		std::array<VkWriteDescriptorSet, MAX_FRAMES_IN_FLIGHT> writes{};
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			bufferInfos[i] = { buffers[i], 0, sizeof(FrameGlobalData) };
+
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = descriptorSets[i];
+			writes[i].dstBinding = 0;
+			writes[i].dstArrayElement = 0;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			writes[i].descriptorCount = 1;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+
+		vkUpdateDescriptorSets(device->getDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+
+	void FrameGlobals::flush(uint32_t frame)
+	{
+		uint32_t bit = 1u << frame;
+		if (!isActive() || !(dirtyFrames & bit) || buffersMapped[frame] == nullptr) return;
+
+		memcpy(buffersMapped[frame], &data, sizeof(data));
+		dirtyFrames &= ~bit;
+	}
+
+	void FrameGlobals::record(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t frame)
+	{
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[frame], 0, nullptr);
+	}
+}
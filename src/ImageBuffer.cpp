@@ -1,6 +1,7 @@
 #include "ImageBuffer.h"
 
 #include "Device.h"
+#include "RenderGraph.h"
 
 namespace Render
 {
@@ -38,8 +39,10 @@ namespace Render
     }
 
     void ImageBuffer::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format,
-        VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties)
+        VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, uint32_t arrayLayers)
     {
+        this->arrayLayers = arrayLayers;
+
         VkImageCreateInfo imageInfo{};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -47,7 +50,7 @@ namespace Render
         imageInfo.extent.height = height;
         imageInfo.extent.depth = 1;
         imageInfo.mipLevels = mipLevels;
-        imageInfo.arrayLayers = 1;
+        imageInfo.arrayLayers = arrayLayers;
         imageInfo.format = format;
         imageInfo.tiling = tiling;
         imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -85,18 +88,18 @@ namespace Render
         this->isOwning = isOwning;
     }
 
-    void ImageBuffer::createImageView(VkFormat imageViewFormat, VkImageAspectFlags aspectFlags, uint32_t mipLevels)
+    void ImageBuffer::createImageView(VkFormat imageViewFormat, VkImageAspectFlags aspectFlags, uint32_t mipLevels, uint32_t baseMipLevel)
     {
         VkImageViewCreateInfo viewInfo{};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
         viewInfo.image = image;
-        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.viewType = viewType;
         viewInfo.format = imageViewFormat;
         viewInfo.subresourceRange.aspectMask = aspectFlags;
-        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
         viewInfo.subresourceRange.levelCount = mipLevels;
         viewInfo.subresourceRange.baseArrayLayer = 0;
-        viewInfo.subresourceRange.layerCount = 1;
+        viewInfo.subresourceRange.layerCount = arrayLayers;
 
         if (device.wait() != Manager::State::YES) {
             Alert("Device died before it was ready to be used.", FATAL);
@@ -109,10 +112,17 @@ namespace Render
         }
     }
 
-    void ImageBuffer::transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
+    void ImageBuffer::transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels, uint32_t baseMipLevel)
     {
         VkCommandBuffer commandBuffer = (*device).beginSingleTimeCommands();
 
+        recordLayoutTransition(commandBuffer, oldLayout, newLayout, baseMipLevel, mipLevels);
+        
+        (*device).endSingleTimeCommands(commandBuffer);
+    }
+
+    void ImageBuffer::recordLayoutTransition(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMipLevel, uint32_t levelCount)
+    {
         VkImageMemoryBarrier barrier{};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
         barrier.oldLayout = oldLayout;
@@ -123,31 +133,25 @@ namespace Render
 
         barrier.image = image;
         barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = mipLevels;
+        barrier.subresourceRange.baseMipLevel = baseMipLevel;
+        barrier.subresourceRange.levelCount = levelCount;
         barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-
-        VkPipelineStageFlags sourceStage;
-        VkPipelineStageFlags destinationStage;
-
-        if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.subresourceRange.layerCount = arrayLayers;
 
-            sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        } else {
+        // Same stage and access per layout as the render graph
+        RenderResourceState source{};
+        RenderResourceState destination{};
+        if (!RenderResourceState::ofLayout(oldLayout, source) || !RenderResourceState::ofLayout(newLayout, destination)) {
             Alert("Unsupported layout transition!", CRITICAL);
             return;
         }
 
+        barrier.srcAccessMask = static_cast<VkAccessFlags>(RenderResourceState::isWrite(source.access) ? source.access : VK_ACCESS_2_NONE);
+        barrier.dstAccessMask = static_cast<VkAccessFlags>(destination.access);
+
+        VkPipelineStageFlags sourceStage = RenderResourceState::toLegacyStages(source.stages, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+        VkPipelineStageFlags destinationStage = RenderResourceState::toLegacyStages(destination.stages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
         vkCmdPipelineBarrier(
             commandBuffer,
             sourceStage, destinationStage,
@@ -156,9 +160,6 @@ namespace Render
             0, nullptr,
             1, &barrier
         );
-
-        
-        (*device).endSingleTimeCommands(commandBuffer);
     }
 
     void ImageBuffer::copyBufferToImage(VkBuffer& buffer, VkImage& image, uint32_t width, uint32_t height) {
@@ -194,7 +195,23 @@ namespace Render
         (*device).endSingleTimeCommands(commandBuffer);
     }
 
-    void ImageBuffer::generateMipmaps(VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) { // TODO: Pre-rendered MipMaps
+    void ImageBuffer::copyBufferToImage(VkBuffer& buffer, VkImage& image, const std::vector<VkBufferImageCopy>& regions)
+    {
+        VkCommandBuffer commandBuffer = (*device).beginSingleTimeCommands();
+
+        vkCmdCopyBufferToImage(
+            commandBuffer,
+            buffer,
+            image,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(regions.size()),
+            regions.data()
+        );
+
+        (*device).endSingleTimeCommands(commandBuffer);
+    }
+
+    void ImageBuffer::generateMipmaps(VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) { // Prebuilt chains are loaded through TextureFile instead
         VkFormatProperties formatProperties;
         vkGetPhysicalDeviceFormatProperties((*device).getPhysicalDevice(), imageFormat, &formatProperties);
         
@@ -211,7 +228,7 @@ namespace Render
         barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
         barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
+        barrier.subresourceRange.layerCount = arrayLayers;
         barrier.subresourceRange.levelCount = 1;
 
         int32_t mipWidth = texWidth;
@@ -236,13 +253,13 @@ namespace Render
             blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
             blit.srcSubresource.mipLevel = i - 1;
             blit.srcSubresource.baseArrayLayer = 0;
-            blit.srcSubresource.layerCount = 1;
+            blit.srcSubresource.layerCount = arrayLayers;
             blit.dstOffsets[0] = { 0, 0, 0 };
             blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
             blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
             blit.dstSubresource.mipLevel = i;
             blit.dstSubresource.baseArrayLayer = 0;
-            blit.dstSubresource.layerCount = 1;
+            blit.dstSubresource.layerCount = arrayLayers;
 
             vkCmdBlitImage(commandBuffer,
                 image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
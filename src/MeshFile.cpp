@@ -0,0 +1,380 @@
+#include "MeshFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include <lz4.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Render
+{
+	MeshFile::MeshFile()
+	{
+	}
+
+	MeshFile::~MeshFile()
+	{
+		close();
+	}
+
+	bool MeshFile::open(const std::string& path)
+	{
+		close();
+		filePath = path;
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			Alert("Failed to open mesh file: " + path, CRITICAL);
+			return false;
+		}
+		fileHandle = file;
+
+		LARGE_INTEGER size{};
+		GetFileSizeEx(file, &size);
+		mappedSize = static_cast<size_t>(size.QuadPart);
+		if (mappedSize < sizeof(MeshFileHeader)) {
+			Alert("Mesh file is too small: " + path, CRITICAL);
+			close();
+			return false;
+		}
+
+		mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mappingHandle == nullptr) {
+			Alert("Failed to map mesh file: " + path, CRITICAL);
+			close();
+			return false;
+		}
+		mapped = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+		fileDescriptor = ::open(path.c_str(), O_RDONLY);
+		if (fileDescriptor < 0) {
+			Alert("Failed to open mesh file: " + path, CRITICAL);
+			return false;
+		}
+
+		struct stat info{};
+		fstat(fileDescriptor, &info);
+		mappedSize = static_cast<size_t>(info.st_size);
+		if (mappedSize < sizeof(MeshFileHeader)) {
+			Alert("Mesh file is too small: " + path, CRITICAL);
+			close();
+			return false;
+		}
+
+		void* view = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+		if (view != MAP_FAILED) {
+			madvise(view, mappedSize, MADV_SEQUENTIAL | MADV_WILLNEED);
+			mapped = static_cast<const uint8_t*>(view);
+		}
+#endif
+		if (mapped == nullptr) {
+			Alert("Failed to map mesh file: " + path, CRITICAL);
+			close();
+			return false;
+		}
+
+		memcpy(&header, mapped, sizeof(MeshFileHeader));
+
+		if (header.magic != MESH_FILE_MAGIC || header.version != MESH_FILE_VERSION) {
+			Alert("Not a supported mesh file: " + path, CRITICAL);
+			close();
+			return false;
+		}
+		if (header.vertexStride != sizeof(Vertex)) {
+			Alert("Mesh file vertex layout does not match Vertex: " + path, CRITICAL);
+			close();
+			return false;
+		}
+
+		// Compared without sums, hostile offsets and sizes would wrap around
+		auto fits = [this](uint64_t offset, uint64_t size) { return size <= mappedSize && offset <= mappedSize - size; };
+		uint64_t tableSize = static_cast<uint64_t>(header.subMeshCount) * sizeof(MeshFileSubMesh);
+		if (!fits(sizeof(MeshFileHeader), tableSize) ||
+			!fits(header.vertexBlobOffset, header.vertexBlobSize) ||
+			!fits(header.indexBlobOffset, header.indexBlobSize)) {
+			Alert("Mesh file is truncated: " + path, CRITICAL);
+			close();
+			return false;
+		}
+
+		// Vertex offsets and indices are 32 bit, larger counts cannot be drawn and would overflow the raw sizes
+		if (header.vertexCount > std::numeric_limits<uint32_t>::max() || header.indexCount > std::numeric_limits<uint32_t>::max()) {
+			Alert("Mesh file is too large: " + path, CRITICAL);
+			close();
+			return false;
+		}
+		if (!(header.flags & MESH_FILE_LZ4) &&
+			(header.vertexBlobSize != header.vertexCount * sizeof(Vertex) || header.indexBlobSize != header.indexCount * sizeof(uint32_t))) {
+			Alert("Mesh file blob size mismatch: " + path, CRITICAL);
+			close();
+			return false;
+		}
+
+		subMeshes.resize(header.subMeshCount);
+		memcpy(subMeshes.data(), mapped + sizeof(MeshFileHeader), subMeshes.size() * sizeof(MeshFileSubMesh));
+
+		for (auto& subMesh : subMeshes) {
+			if (static_cast<uint64_t>(subMesh.vertexOffset) + subMesh.vertexCount > header.vertexCount ||
+				static_cast<uint64_t>(subMesh.indexOffset) + subMesh.indexCount > header.indexCount) {
+				Alert("Mesh file sub-mesh table is out of range: " + path, CRITICAL);
+				close();
+				return false;
+			}
+		}
+
+		// Rejected here, before anything reaches staging memory and the GPU reads past a sub-mesh's vertices
+		if (!validateIndices()) {
+			Alert("Mesh file index data is corrupt or out of range: " + path, CRITICAL);
+			close();
+			return false;
+		}
+
+		return true;
+	}
+
+	bool MeshFile::validateIndices()
+	{
+		const uint8_t* data = mapped + header.indexBlobOffset;
+		if (header.flags & MESH_FILE_LZ4) {
+			// Kept for readIndices(), the blob is decompressed once
+			decodedIndices.resize(static_cast<size_t>(header.indexCount * sizeof(uint32_t)));
+			if (!readBlob(header.indexBlobOffset, header.indexBlobSize, decodedIndices.size(), decodedIndices.data())) return false;
+			data = decodedIndices.data();
+		}
+
+		// Indices are relative to their sub-mesh's vertexOffset
+		for (auto& subMesh : subMeshes) {
+			const uint8_t* subIndices = data + static_cast<size_t>(subMesh.indexOffset) * sizeof(uint32_t);
+			for (uint32_t i = 0; i < subMesh.indexCount; i++) {
+				uint32_t index;
+				memcpy(&index, subIndices + static_cast<size_t>(i) * sizeof(uint32_t), sizeof(uint32_t));
+				if (index >= subMesh.vertexCount) return false;
+			}
+		}
+		return true;
+	}
+
+	void MeshFile::close()
+	{
+#ifdef _WIN32
+		if (mapped != nullptr) UnmapViewOfFile(mapped);
+		if (mappingHandle != nullptr) CloseHandle(static_cast<HANDLE>(mappingHandle));
+		if (fileHandle != nullptr) CloseHandle(static_cast<HANDLE>(fileHandle));
+#else
+		if (mapped != nullptr) munmap(const_cast<uint8_t*>(mapped), mappedSize);
+		if (fileDescriptor >= 0) ::close(fileDescriptor);
+#endif
+		mapped = nullptr;
+		mappedSize = 0;
+		fileHandle = nullptr;
+		mappingHandle = nullptr;
+		fileDescriptor = -1;
+
+		header = {};
+		subMeshes.clear();
+		decodedIndices.clear();
+		decodedIndices.shrink_to_fit();
+	}
+
+	bool MeshFile::readVertices(void* dst)
+	{
+		return readBlob(header.vertexBlobOffset, header.vertexBlobSize, header.vertexCount * sizeof(Vertex), dst);
+	}
+
+	bool MeshFile::readIndices(void* dst)
+	{
+		if (!decodedIndices.empty()) {
+			memcpy(dst, decodedIndices.data(), decodedIndices.size());
+			return true;
+		}
+		return readBlob(header.indexBlobOffset, header.indexBlobSize, header.indexCount * sizeof(uint32_t), dst);
+	}
+
+	bool MeshFile::readBlob(uint64_t offset, uint64_t storedSize, uint64_t rawSize, void* dst)
+	{
+		if (!isOpen()) {
+			Alert("Mesh file read before it was opened!", CRITICAL);
+			return false;
+		}
+
+		const uint8_t* src = mapped + offset;
+		uint8_t* out = static_cast<uint8_t*>(dst);
+
+		if (!(header.flags & MESH_FILE_LZ4)) {
+			if (storedSize != rawSize) {
+				Alert("Mesh file blob size mismatch: " + filePath, CRITICAL);
+				return false;
+			}
+			memcpy(out, src, static_cast<size_t>(rawSize));
+			return true;
+		}
+
+		const uint8_t* end = src + storedSize;
+		uint64_t written = 0;
+		while (written < rawSize) {
+			if (end - src < 4) break;
+
+			uint32_t chunkSize;
+			memcpy(&chunkSize, src, sizeof(uint32_t));
+			src += sizeof(uint32_t);
+
+			bool stored = chunkSize & MESH_FILE_CHUNK_STORED;
+			chunkSize &= ~MESH_FILE_CHUNK_STORED;
+
+			size_t rawChunk = static_cast<size_t>(std::min<uint64_t>(MESH_FILE_CHUNK_SIZE, rawSize - written));
+			if (chunkSize > static_cast<size_t>(end - src)) break;
+
+			if (stored) {
+				if (chunkSize != rawChunk) break;
+				memcpy(out + written, src, rawChunk);
+			}
+			else if (!decompressBlock(src, chunkSize, out + written, rawChunk)) {
+				break;
+			}
+
+			src += chunkSize;
+			written += rawChunk;
+		}
+
+		if (written != rawSize) {
+			Alert("Mesh file blob is corrupt: " + filePath, CRITICAL);
+			return false;
+		}
+		return true;
+	}
+
+	bool MeshFile::write(const std::string& path, std::vector<VertexBufferData>& meshes, bool compress)
+	{
+		MeshFileHeader out{};
+		out.magic = MESH_FILE_MAGIC;
+		out.version = MESH_FILE_VERSION;
+		out.flags = compress ? MESH_FILE_LZ4 : 0;
+		out.subMeshCount = static_cast<uint32_t>(meshes.size());
+		out.vertexStride = sizeof(Vertex);
+		out.boundsMin = glm::vec4(std::numeric_limits<float>::max());
+		out.boundsMax = glm::vec4(std::numeric_limits<float>::lowest());
+
+		std::vector<MeshFileSubMesh> table;
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+
+		for (auto& mesh : meshes) {
+			if (vertices.size() + mesh.getVertices().size() > std::numeric_limits<uint32_t>::max()) {
+				Alert("Mesh file sub-mesh offsets exceed 32 bits: " + path, CRITICAL);
+				return false;
+			}
+
+			MeshFileSubMesh subMesh{};
+			subMesh.vertexOffset = static_cast<uint32_t>(vertices.size());
+			subMesh.vertexCount = static_cast<uint32_t>(mesh.getVertices().size());
+			subMesh.indexOffset = static_cast<uint32_t>(indices.size());
+			subMesh.indexCount = static_cast<uint32_t>(mesh.getIndices().size());
+			subMesh.boundsMin = glm::vec4(std::numeric_limits<float>::max());
+			subMesh.boundsMax = glm::vec4(std::numeric_limits<float>::lowest());
+
+			for (auto& vertex : mesh.getVertices()) {
+				subMesh.boundsMin = glm::min(subMesh.boundsMin, glm::vec4(vertex.position, 0.0f));
+				subMesh.boundsMax = glm::max(subMesh.boundsMax, glm::vec4(vertex.position, 0.0f));
+			}
+			out.boundsMin = glm::min(out.boundsMin, subMesh.boundsMin);
+			out.boundsMax = glm::max(out.boundsMax, subMesh.boundsMax);
+
+			vertices.insert(vertices.end(), mesh.getVertices().begin(), mesh.getVertices().end());
+			indices.insert(indices.end(), mesh.getIndices().begin(), mesh.getIndices().end());
+			table.push_back(subMesh);
+		}
+
+		out.vertexCount = vertices.size();
+		out.indexCount = indices.size();
+
+		std::vector<uint8_t> vertexBlob;
+		std::vector<uint8_t> indexBlob;
+		appendBlob(vertexBlob, reinterpret_cast<const uint8_t*>(vertices.data()), vertices.size() * sizeof(Vertex), compress);
+		appendBlob(indexBlob, reinterpret_cast<const uint8_t*>(indices.data()), indices.size() * sizeof(uint32_t), compress);
+
+		out.vertexBlobOffset = sizeof(MeshFileHeader) + table.size() * sizeof(MeshFileSubMesh);
+		out.vertexBlobSize = vertexBlob.size();
+		out.indexBlobOffset = out.vertexBlobOffset + out.vertexBlobSize;
+		out.indexBlobSize = indexBlob.size();
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			Alert("Failed to open mesh file for writing: " + path, CRITICAL);
+			return false;
+		}
+
+		file.write(reinterpret_cast<const char*>(&out), sizeof(MeshFileHeader));
+		file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(MeshFileSubMesh));
+		file.write(reinterpret_cast<const char*>(vertexBlob.data()), vertexBlob.size());
+		file.write(reinterpret_cast<const char*>(indexBlob.data()), indexBlob.size());
+
+		if (!file.good()) {
+			Alert("Failed to write mesh file: " + path, CRITICAL);
+			return false;
+		}
+		return true;
+	}
+
+	void MeshFile::appendBlob(std::vector<uint8_t>& out, const uint8_t* data, size_t size, bool compress)
+	{
+		if (!compress) {
+			out.insert(out.end(), data, data + size);
+			return;
+		}
+
+		std::vector<uint8_t> scratch(compressBound(MESH_FILE_CHUNK_SIZE));
+		for (size_t offset = 0; offset < size; offset += MESH_FILE_CHUNK_SIZE) {
+			size_t rawChunk = std::min<size_t>(MESH_FILE_CHUNK_SIZE, size - offset);
+			size_t packed = compressBlock(data + offset, rawChunk, scratch.data());
+
+			uint32_t chunkSize = static_cast<uint32_t>(packed);
+			const uint8_t* chunk = scratch.data();
+			if (packed >= rawChunk) { // Incompressible, store it as is
+				chunkSize = static_cast<uint32_t>(rawChunk) | MESH_FILE_CHUNK_STORED;
+				packed = rawChunk;
+				chunk = data + offset;
+			}
+
+			const uint8_t* sizeBytes = reinterpret_cast<const uint8_t*>(&chunkSize);
+			out.insert(out.end(), sizeBytes, sizeBytes + sizeof(uint32_t));
+			out.insert(out.end(), chunk, chunk + packed);
+		}
+	}
+
+	// LZ4 block format through liblz4, files written by earlier versions decode unchanged
+
+	size_t MeshFile::compressBound(size_t size)
+	{
+		return static_cast<size_t>(LZ4_compressBound(static_cast<int>(size)));
+	}
+
+	size_t MeshFile::compressBlock(const uint8_t* src, size_t srcSize, uint8_t* dst)
+	{
+		int packed = LZ4_compress_default(reinterpret_cast<const char*>(src), reinterpret_cast<char*>(dst),
+			static_cast<int>(srcSize), static_cast<int>(compressBound(srcSize)));
+		return packed > 0 ? static_cast<size_t>(packed) : srcSize; // 0 means it did not fit, stored instead
+	}
+
+	bool MeshFile::decompressBlock(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+	{
+		if (srcSize > static_cast<size_t>(std::numeric_limits<int>::max())) return false;
+
+		// Bounds checked against both buffers, malformed chunks fail instead of reading or writing past them
+		int written = LZ4_decompress_safe(reinterpret_cast<const char*>(src), reinterpret_cast<char*>(dst),
+			static_cast<int>(srcSize), static_cast<int>(dstSize));
+		return written >= 0 && static_cast<size_t>(written) == dstSize;
+	}
+}
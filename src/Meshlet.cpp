@@ -0,0 +1,142 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Render
+{
+	void MeshletData::clear()
+	{
+		meshlets.clear();
+		vertices.clear();
+		triangles.clear();
+	}
+
+	void MeshletBuilder::build(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+		uint32_t firstIndex, int32_t vertexBase, uint32_t subBuffer, MeshletData& out)
+	{
+		std::vector<uint32_t> reordered;
+		reordered.reserve(indices.size());
+
+		std::vector<int16_t> localIndex(vertices.size(), -1); // -1 = not in the current meshlet
+		std::vector<uint32_t> usedVertices;
+		std::vector<uint32_t> triangles;
+		usedVertices.reserve(MESHLET_MAX_VERTICES);
+		triangles.reserve(MESHLET_MAX_TRIANGLES);
+
+		size_t meshletStart = 0;
+		uint32_t meshletBase = static_cast<uint32_t>(out.meshlets.size());
+
+		auto flush = [&]() {
+			if (triangles.empty()) return;
+
+			Meshlet meshlet{};
+			meshlet.vertexOffset = static_cast<uint32_t>(out.vertices.size());
+			meshlet.triangleOffset = static_cast<uint32_t>(out.triangles.size());
+			meshlet.vertexCount = static_cast<uint32_t>(usedVertices.size());
+			meshlet.triangleCount = static_cast<uint32_t>(triangles.size());
+			meshlet.firstIndex = firstIndex + static_cast<uint32_t>(meshletStart);
+			meshlet.vertexBase = vertexBase;
+			meshlet.subBuffer = subBuffer;
+			meshlet.meshletBase = meshletBase;
+
+			computeBounds(vertices, reordered.data() + meshletStart, reordered.size() - meshletStart, meshlet);
+
+			out.vertices.insert(out.vertices.end(), usedVertices.begin(), usedVertices.end());
+			out.triangles.insert(out.triangles.end(), triangles.begin(), triangles.end());
+			out.meshlets.push_back(meshlet);
+
+			for (auto vertex : usedVertices) {
+				localIndex[vertex] = -1;
+			}
+			usedVertices.clear();
+			triangles.clear();
+			meshletStart = reordered.size();
+		};
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+			if (a >= vertices.size() || b >= vertices.size() || c >= vertices.size()) continue;
+
+			size_t newVertices = (localIndex[a] < 0) +
+				(localIndex[b] < 0 && b != a) +
+				(localIndex[c] < 0 && c != a && c != b);
+
+			if (usedVertices.size() + newVertices > MESHLET_MAX_VERTICES || triangles.size() + 1 > MESHLET_MAX_TRIANGLES) {
+				flush();
+			}
+
+			uint32_t packed = 0;
+			uint32_t corner = 0;
+			for (auto vertex : { a, b, c }) {
+				if (localIndex[vertex] < 0) {
+					localIndex[vertex] = static_cast<int16_t>(usedVertices.size());
+					usedVertices.push_back(vertex);
+				}
+				packed |= static_cast<uint32_t>(localIndex[vertex]) << (corner * 8);
+				corner++;
+			}
+			triangles.push_back(packed);
+
+			reordered.push_back(a);
+			reordered.push_back(b);
+			reordered.push_back(c);
+		}
+		flush();
+
+		indices = std::move(reordered);
+	}
+
+	void MeshletBuilder::computeBounds(const std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount, Meshlet& meshlet)
+	{
+		glm::vec3 minimum(std::numeric_limits<float>::max());
+		glm::vec3 maximum(std::numeric_limits<float>::lowest());
+		for (size_t i = 0; i < indexCount; i++) {
+			minimum = glm::min(minimum, vertices[indices[i]].position);
+			maximum = glm::max(maximum, vertices[indices[i]].position);
+		}
+
+		glm::vec3 center = (minimum + maximum) * 0.5f;
+		float radius = 0.0f;
+		for (size_t i = 0; i < indexCount; i++) {
+			radius = std::max(radius, glm::length(vertices[indices[i]].position - center));
+		}
+		meshlet.sphere = glm::vec4(center, radius);
+
+		// Normal cone, see "Optimizing the Graphics Pipeline with Compute" (Wihlidal) and meshoptimizer
+		std::vector<glm::vec3> normals;
+		normals.reserve(indexCount / 3);
+
+		glm::vec3 axis(0.0f);
+		for (size_t i = 0; i + 2 < indexCount; i += 3) {
+			glm::vec3 a = vertices[indices[i]].position;
+			glm::vec3 b = vertices[indices[i + 1]].position;
+			glm::vec3 c = vertices[indices[i + 2]].position;
+
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float area = glm::length(normal);
+			if (area <= 0.0f) continue; // Degenerate
+
+			normal /= area;
+			normals.push_back(normal);
+			axis += normal;
+		}
+
+		float axisLength = glm::length(axis);
+		if (normals.empty() || axisLength <= 0.0f) {
+			meshlet.cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+			return;
+		}
+		axis /= axisLength;
+
+		float minDot = 1.0f;
+		for (auto& normal : normals) {
+			minDot = std::min(minDot, glm::dot(normal, axis));
+		}
+
+		// Cones wider than ~85 degrees can never be rejected
+		float cutoff = minDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+		meshlet.cone = glm::vec4(axis, cutoff);
+	}
+}
@@ -0,0 +1,389 @@
+#include "MeshletCuller.h"
+
+#include "Device.h"
+
+#include <cstring>
+#include <cmath>
+
+#define ERROR_VOLATILE(x) x; if (getAlertSeverity() == FATAL) { return; }
+
+namespace Render
+{
+	MeshletCullData MeshletCullData::fromCamera(const glm::mat4& view, const glm::mat4& proj, float viewportHeight, float minPixels)
+	{
+		MeshletCullData data{};
+		data.viewProj = proj * view;
+
+		// Gribb-Hartmann plane extraction, depth zero to one
+		auto row = [&](int i) { return glm::vec4(data.viewProj[0][i], data.viewProj[1][i], data.viewProj[2][i], data.viewProj[3][i]); };
+		data.frustum[0] = row(3) + row(0);
+		data.frustum[1] = row(3) - row(0);
+		data.frustum[2] = row(3) + row(1);
+		data.frustum[3] = row(3) - row(1);
+		data.frustum[4] = row(2);
+		data.frustum[5] = row(3) - row(2);
+
+		for (auto& plane : data.frustum) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+
+		data.cameraPosition = glm::vec4(glm::vec3(glm::inverse(view)[3]), 1.0f);
+		data.screen = glm::vec4(std::abs(proj[1][1]) * viewportHeight * 0.5f, minPixels, 0.0f, 0.0f);
+
+		return data;
+	}
+
+	MeshletCuller::MeshletCuller()
+	{
+	}
+
+	MeshletCuller::~MeshletCuller()
+	{
+		destroy();
+	}
+
+	void MeshletCuller::init(size_t deviceUUID, MeshletCullerConstructInfo info)
+	{
+		device = Request<Device>(deviceUUID, "self");
+		if (device.wait() != Manager::State::YES) {
+			Alert("Device died before it was ready to be used.", FATAL);
+			return;
+		}
+		computeShaderPath = info.computeShaderPath;
+
+		ERROR_VOLATILE(createDescriptorSetLayout());
+
+		if (!computeShaderPath.empty()) {
+			createComputePipeline();
+		}
+		else if (!(*device).getFeatures().meshShader) {
+			Alert("Meshlets without a cull shader need mesh shader support, meshlets will be drawn unculled.", WARNING);
+		}
+	}
+
+	void MeshletCuller::ready(Buffer& buffer)
+	{
+		isReady = false;
+		destroyFrameBuffers();
+
+		if (!buffer.hasMeshlets()) {
+			Alert("Buffer has no meshlets to cull.", WARNING);
+			return;
+		}
+
+		meshletCount = buffer.getNumMeshlets();
+		meshletOffsets.clear();
+		meshletCounts.clear();
+		materials.clear();
+		for (uint32_t i = 0; i < buffer.getNumberSubBuffers(); i++) {
+			meshletOffsets.push_back(buffer.getMeshletOffset(i));
+			meshletCounts.push_back(buffer.getMeshletCount(i));
+			materials.push_back(buffer.getMaterialIndex(i));
+		}
+		transforms.resize(buffer.getNumberSubBuffers(), glm::mat4(1.0f));
+
+		compact = (*device).getFeatures().drawIndirectCount;
+
+		ERROR_VOLATILE(createFrameBuffers());
+		ERROR_VOLATILE(createDescriptorSets(buffer));
+
+		isReady = true;
+	}
+
+	void MeshletCuller::destroy()
+	{
+		isReady = false;
+		destroyFrameBuffers();
+		computeShader.destroy();
+
+		if (device) {
+			if (computePipeline != VK_NULL_HANDLE) {
+				vkDestroyPipeline((*device).getDevice(), computePipeline, nullptr);
+				computePipeline = VK_NULL_HANDLE;
+			}
+			if (pipelineLayout != VK_NULL_HANDLE) {
+				vkDestroyPipelineLayout((*device).getDevice(), pipelineLayout, nullptr);
+				pipelineLayout = VK_NULL_HANDLE;
+			}
+			if (descriptorSetLayout != VK_NULL_HANDLE) {
+				vkDestroyDescriptorSetLayout((*device).getDevice(), descriptorSetLayout, nullptr);
+				descriptorSetLayout = VK_NULL_HANDLE;
+			}
+		}
+	}
+
+	void MeshletCuller::destroyFrameBuffers()
+	{
+		if (!device) return;
+
+		auto release = [&](FrameBuffer& frameBuffer) {
+			if (frameBuffer.mapped) {
+				vkUnmapMemory((*device).getDevice(), frameBuffer.memory);
+				frameBuffer.mapped = nullptr;
+			}
+			if (frameBuffer.buffer != VK_NULL_HANDLE) {
+				vkDestroyBuffer((*device).getDevice(), frameBuffer.buffer, nullptr);
+				frameBuffer.buffer = VK_NULL_HANDLE;
+			}
+			if (frameBuffer.memory != VK_NULL_HANDLE) {
+				vkFreeMemory((*device).getDevice(), frameBuffer.memory, nullptr);
+				frameBuffer.memory = VK_NULL_HANDLE;
+			}
+		};
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			release(cullDataBuffers[i]);
+			release(transformBuffers[i]);
+			release(drawBuffers[i]);
+			release(countBuffers[i]);
+		}
+		release(materialBuffer);
+
+		if (descriptorPool != VK_NULL_HANDLE) {
+			vkDestroyDescriptorPool((*device).getDevice(), descriptorPool, nullptr);
+			descriptorPool = VK_NULL_HANDLE;
+			descriptorSets = {};
+		}
+	}
+
+	bool MeshletCuller::isActive()
+	{
+		if (!isReady) return false;
+		return computePipeline != VK_NULL_HANDLE || (computeShaderPath.empty() && (*device).getFeatures().meshShader);
+	}
+
+	void MeshletCuller::setCamera(const glm::mat4& view, const glm::mat4& proj, float viewportHeight)
+	{
+		cullData = MeshletCullData::fromCamera(view, proj, viewportHeight);
+	}
+
+	void MeshletCuller::setTransform(uint32_t subBuffer, const glm::mat4& model)
+	{
+		if (subBuffer >= transforms.size()) {
+			Alert("Meshlet transform index out of range.", WARNING);
+			return;
+		}
+		transforms[subBuffer] = model;
+	}
+
+	void MeshletCuller::createDescriptorSetLayout()
+	{
+		VkShaderStageFlags stages = VK_SHADER_STAGE_COMPUTE_BIT;
+		if ((*device).getFeatures().meshShader) {
+			stages |= VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+		}
+
+		std::array<VkDescriptorSetLayoutBinding, 9> bindings{};
+		for (uint32_t i = 0; i < bindings.size(); i++) {
+			bindings[i].binding = i;
+			bindings[i].descriptorType = i == 1 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = stages;
+			bindings[i].pImmutableSamplers = nullptr;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		if (vkCreateDescriptorSetLayout((*device).getDevice(), &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+			Alert("Failed to create meshlet descriptor set layout!", FATAL);
+		}
+	}
+
+	void MeshletCuller::createComputePipeline()
+	{
+		ShaderConstructInfo shaderInfo{};
+		shaderInfo.computeShaderPath = computeShaderPath;
+		ERROR_VOLATILE(computeShader.init((*device).getUUID(), shaderInfo));
+
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(CullPushData);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout((*device).getDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			Alert("Failed to create meshlet cull pipeline layout!", FATAL);
+			return;
+		}
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage = computeShader.getShaderStages()[0];
+		pipelineInfo.layout = pipelineLayout;
+
+		if (vkCreateComputePipelines((*device).getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+			Alert("Failed to create meshlet cull pipeline!", FATAL);
+			return;
+		}
+	}
+
+	void MeshletCuller::createFrameBuffers()
+	{
+		VkDeviceSize transformsSize = sizeof(glm::mat4) * transforms.size();
+		VkDeviceSize drawsSize = sizeof(VkDrawIndexedIndirectCommand) * meshletCount;
+		VkDeviceSize countsSize = sizeof(uint32_t) * meshletCounts.size();
+		VkDeviceSize materialsSize = sizeof(uint32_t) * materials.size();
+
+		auto hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			ERROR_VOLATILE((*device).createBuffer(sizeof(MeshletCullData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible,
+				cullDataBuffers[i].buffer, cullDataBuffers[i].memory));
+			vkMapMemory((*device).getDevice(), cullDataBuffers[i].memory, 0, sizeof(MeshletCullData), 0, &cullDataBuffers[i].mapped);
+
+			ERROR_VOLATILE((*device).createBuffer(transformsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible,
+				transformBuffers[i].buffer, transformBuffers[i].memory));
+			vkMapMemory((*device).getDevice(), transformBuffers[i].memory, 0, transformsSize, 0, &transformBuffers[i].mapped);
+
+			ERROR_VOLATILE((*device).createBuffer(drawsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawBuffers[i].buffer, drawBuffers[i].memory));
+
+			ERROR_VOLATILE((*device).createBuffer(countsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, countBuffers[i].buffer, countBuffers[i].memory));
+		}
+
+		// Materials only change when the buffer is loaded again, which calls ready() again
+		ERROR_VOLATILE((*device).createBuffer(materialsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible,
+			materialBuffer.buffer, materialBuffer.memory));
+		vkMapMemory((*device).getDevice(), materialBuffer.memory, 0, materialsSize, 0, &materialBuffer.mapped);
+		memcpy(materialBuffer.mapped, materials.data(), static_cast<size_t>(materialsSize));
+	}
+
+	void MeshletCuller::createDescriptorSets(Buffer& buffer)
+	{
+		std::array<VkDescriptorPoolSize, 2> poolSizes{};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		poolSizes[0].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[1].descriptorCount = 8 * MAX_FRAMES_IN_FLIGHT;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+
+		if (vkCreateDescriptorPool((*device).getDevice(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+			Alert("Failed to create meshlet descriptor pool!", FATAL);
+			return;
+		}
+
+		std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> layouts;
+		layouts.fill(descriptorSetLayout);
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+		allocInfo.pSetLayouts = layouts.data();
+
+		if (vkAllocateDescriptorSets((*device).getDevice(), &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+			Alert("Failed to allocate meshlet descriptor sets!", FATAL);
+			return;
+		}
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			std::array<VkDescriptorBufferInfo, 9> bufferInfos = {{
+				{ buffer.getMeshletBuffer(), 0, VK_WHOLE_SIZE },
+				{ cullDataBuffers[i].buffer, 0, VK_WHOLE_SIZE },
+				{ transformBuffers[i].buffer, 0, VK_WHOLE_SIZE },
+				{ drawBuffers[i].buffer, 0, VK_WHOLE_SIZE },
+				{ countBuffers[i].buffer, 0, VK_WHOLE_SIZE },
+				{ buffer.getMeshletVertexBuffer(), 0, VK_WHOLE_SIZE },
+				{ buffer.getMeshletTriangleBuffer(), 0, VK_WHOLE_SIZE },
+				{ buffer.getVertexBuffer(), 0, VK_WHOLE_SIZE },
+				{ materialBuffer.buffer, 0, VK_WHOLE_SIZE }
+			}};
+
+			std::array<VkWriteDescriptorSet, 9> descriptorWrites{};
+			for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+				descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				descriptorWrites[binding].dstSet = descriptorSets[i];
+				descriptorWrites[binding].dstBinding = binding;
+				descriptorWrites[binding].dstArrayElement = 0;
+				descriptorWrites[binding].descriptorType = binding == 1 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				descriptorWrites[binding].descriptorCount = 1;
+				descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+			}
+
+			vkUpdateDescriptorSets((*device).getDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+		}
+	}
+
+	void MeshletCuller::record(VkCommandBuffer commandBuffer, uint32_t frame)
+	{
+		if (!isActive()) return;
+
+		memcpy(cullDataBuffers[frame].mapped, &cullData, sizeof(MeshletCullData));
+		memcpy(transformBuffers[frame].mapped, transforms.data(), sizeof(glm::mat4) * transforms.size());
+
+		if (computePipeline == VK_NULL_HANDLE) return; // Task shader culls
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+
+		if (compact) {
+			vkCmdFillBuffer(commandBuffer, countBuffers[frame].buffer, 0, VK_WHOLE_SIZE, 0);
+
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+				1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[frame], 0, nullptr);
+
+		CullPushData pushData = { meshletCount, compact ? 1u : 0u };
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushData), &pushData);
+
+		vkCmdDispatch(commandBuffer, (meshletCount + MESHLET_CULL_GROUP_SIZE - 1) / MESHLET_CULL_GROUP_SIZE, 1, 1);
+
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+			1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	void MeshletCuller::recordSubBuffer(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t index)
+	{
+		const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		VkDeviceSize offset = static_cast<VkDeviceSize>(meshletOffsets[index]) * stride;
+
+		if (compact) {
+			vkCmdDrawIndexedIndirectCount(commandBuffer, drawBuffers[frame].buffer, offset,
+				countBuffers[frame].buffer, index * sizeof(uint32_t), meshletCounts[index], stride);
+		}
+		else if ((*device).getFeatures().multiDrawIndirect) {
+			vkCmdDrawIndexedIndirect(commandBuffer, drawBuffers[frame].buffer, offset, meshletCounts[index], stride);
+		}
+		else {
+			for (uint32_t i = 0; i < meshletCounts[index]; i++) {
+				vkCmdDrawIndexedIndirect(commandBuffer, drawBuffers[frame].buffer, offset + i * stride, 1, stride);
+			}
+		}
+	}
+
+	void MeshletCuller::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t frame, uint32_t set)
+	{
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, set, 1, &descriptorSets[frame], 0, nullptr);
+	}
+
+	void MeshletCuller::recordMeshTasks(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t pushConstantOffset, uint32_t index)
+	{
+		MeshPushData pushData = { meshletOffsets[index], meshletCounts[index] };
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT,
+			pushConstantOffset, sizeof(MeshPushData), &pushData);
+
+		(*device).cmdDrawMeshTasks(commandBuffer, (meshletCounts[index] + MESHLET_TASK_GROUP_SIZE - 1) / MESHLET_TASK_GROUP_SIZE, 1, 1);
+	}
+}
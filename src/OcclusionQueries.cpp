@@ -0,0 +1,104 @@
+#include "OcclusionQueries.h"
+
+#include "Device.h"
+
+#include <algorithm>
+
+namespace Render
+{
+	OcclusionQueries::OcclusionQueries() {}
+
+	OcclusionQueries::~OcclusionQueries()
+	{
+		destroy();
+	}
+
+	void OcclusionQueries::init(size_t deviceUUID, uint32_t slots)
+	{
+		destroy();
+
+		device = Request<Device>(deviceUUID, "self");
+		if (device.wait() != Manager::State::YES) {
+			Alert("Device died before it was ready to be used.", FATAL);
+			return;
+		}
+
+		if (!(*device).getFeatures().occlusionQueryPrecise) {
+			Alert("Precise occlusion queries are unavailable, depth pre-pass stats stay empty.", INFO);
+			return;
+		}
+		if (slots == 0) return;
+
+		VkQueryPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		poolInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
+		poolInfo.queryCount = MAX_FRAMES_IN_FLIGHT * slots * 2;
+
+		if (vkCreateQueryPool((*device).getDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+			Alert("Failed to create occlusion query pool, depth pre-pass stats stay empty.", WARNING);
+			pool = VK_NULL_HANDLE;
+			return;
+		}
+
+		this->slots = slots;
+		recorded.assign(poolInfo.queryCount, false);
+	}
+
+	void OcclusionQueries::destroy()
+	{
+		if (device && pool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool((*device).getDevice(), pool, nullptr);
+		}
+		pool = VK_NULL_HANDLE;
+		slots = 0;
+		recorded.clear();
+		stats = {};
+	}
+
+	void OcclusionQueries::reset(VkCommandBuffer commandBuffer, uint32_t frame)
+	{
+		if (!isActive() || frame >= MAX_FRAMES_IN_FLIGHT) return;
+
+		// Only slots measured in both passes, a layout missing from either would skew the difference
+		DepthPrepassStats frameStats{};
+		bool measured = false;
+		for (uint32_t slot = 0; slot < slots; slot++) {
+			uint32_t first = queryIndex(frame, slot, PASS_PREPASS);
+			if (!recorded[first] || !recorded[first + 1]) continue;
+
+			uint64_t samples[2] = { 0, 0 };
+			if (vkGetQueryPoolResults((*device).getDevice(), pool, first, 2, sizeof(samples), samples, sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) continue;
+
+			frameStats.prepassSamples += samples[PASS_PREPASS];
+			frameStats.shadedSamples += samples[PASS_MAIN];
+			measured = true;
+		}
+
+		if (measured) {
+			frameStats.savedSamples = frameStats.prepassSamples > frameStats.shadedSamples ?
+				frameStats.prepassSamples - frameStats.shadedSamples : 0;
+			stats = frameStats;
+		}
+
+		uint32_t first = queryIndex(frame, 0, PASS_PREPASS);
+		vkCmdResetQueryPool(commandBuffer, pool, first, slots * 2);
+		std::fill(recorded.begin() + first, recorded.begin() + first + slots * 2, false);
+	}
+
+	void OcclusionQueries::begin(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t slot, Pass pass)
+	{
+		if (!isActive() || frame >= MAX_FRAMES_IN_FLIGHT || slot >= slots) return;
+
+		vkCmdBeginQuery(commandBuffer, pool, queryIndex(frame, slot, pass), VK_QUERY_CONTROL_PRECISE_BIT);
+	}
+
+	void OcclusionQueries::end(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t slot, Pass pass)
+	{
+		if (!isActive() || frame >= MAX_FRAMES_IN_FLIGHT || slot >= slots) return;
+
+		uint32_t query = queryIndex(frame, slot, pass);
+		vkCmdEndQuery(commandBuffer, pool, query);
+		recorded[query] = true;
+	}
+}
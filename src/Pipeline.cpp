@@ -2,6 +2,8 @@
 
 #include "Device.h"
 
+#include <algorithm>
+
 namespace Render 
 {
 	Pipeline::Pipeline()
@@ -28,181 +30,259 @@ namespace Render
 			Alert("Resources died before they were ready to be used.", FATAL);
 			return;
 		}
-		constructPipelineLayout(*renderPass, *shader, *pushConstant);
+		constructPipelineLayout(*renderPass, *shader, *pushConstant, info);
 	}
 
 	void Pipeline::destroy()
 	{
+		// Shared through the device's PipelineCache, which keeps them until it is trimmed
 		if (device) {
-			vkDestroyPipelineLayout((*device).getDevice(), pipelineLayout, nullptr);
-
-			vkDestroyPipeline((*device).getDevice(), graphicsPipeline, nullptr);
+			auto& pipelineCache = (*device).getPipelineCache();
+			for (auto& variant : variants) {
+				pipelineCache.release(variantKey(variant.first));
+			}
+			if (reloading) pipelineCache.release(pendingKey, true);
+			if (pipelineLayout != VK_NULL_HANDLE) pipelineCache.releaseLayout(pipelineLayout);
 		}
+		variants.clear();
+		reloading = false;
+		abandoned.clear();
+
+		pipelineLayout = VK_NULL_HANDLE;
+		graphicsPipeline = VK_NULL_HANDLE;
 	}
 
-	void Pipeline::record(VkCommandBuffer commandBuffer)
+	bool Pipeline::record(VkCommandBuffer commandBuffer)
 	{
+		refresh();
+		if (graphicsPipeline == VK_NULL_HANDLE) {
+			graphicsPipeline = getVariant(defaultState);
+			if (graphicsPipeline == VK_NULL_HANDLE) return false;
+		}
+
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+		boundPipeline = graphicsPipeline;
+
+		(*device).getPipelineCache().recordState(commandBuffer, defaultState, meshPipeline);
+		return true;
 	}
 
-	void Pipeline::constructPipelineLayout(RenderPass& renderPass, Shader& shader, PushConstant& pushConstant)
+	bool Pipeline::record(VkCommandBuffer commandBuffer, const PipelineState& state)
 	{
-		if (graphicsPipeline != VK_NULL_HANDLE || getAlertSeverity() == FATAL) {
-			Alert("Warning: constructPipeline called more than once. All calls other than the first are skipped.", WARNING);
-			return;
+		refresh();
+		VkPipeline pipeline = getVariant(state);
+		if (pipeline == VK_NULL_HANDLE) {
+			pipeline = graphicsPipeline != VK_NULL_HANDLE ? graphicsPipeline : getVariant(defaultState);
+			if (pipeline == VK_NULL_HANDLE) return false;
 		}
 
-		auto msaaSamples = (*device).getConfig().desiredMSAASamples;
-
-		// Verts
-		auto bindingDescription = Vertex::getBindingDescriptions();
-		auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
-		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputInfo.vertexBindingDescriptionCount = 1;
-		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-		// Input assembly
-		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST; //Triangle
-		inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-		std::vector<VkDynamicState> dynamicStates = {
-			VK_DYNAMIC_STATE_VIEWPORT,
-			VK_DYNAMIC_STATE_SCISSOR
-		};
-
-		VkPipelineDynamicStateCreateInfo dynamicState{};
-		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-		dynamicState.pDynamicStates = dynamicStates.data();
-
-		VkPipelineViewportStateCreateInfo viewportState{};
-		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportState.viewportCount = 1;
-		viewportState.scissorCount = 1;
-
-		// Rasterizer
-		VkPipelineRasterizationStateCreateInfo rasterizer{};
-		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterizer.depthClampEnable = VK_FALSE;
-		rasterizer.rasterizerDiscardEnable = VK_FALSE;
-		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-		rasterizer.lineWidth = 1.0f;
-		rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE; // Opposite for uniform buffer z flip
-		rasterizer.depthBiasEnable = VK_FALSE;
-		rasterizer.depthBiasConstantFactor = 0.0f; // Optional
-		rasterizer.depthBiasClamp = 0.0f; // Optional
-		rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
-
-		VkPipelineMultisampleStateCreateInfo multisampling{};
-		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		multisampling.sampleShadingEnable = VK_TRUE;
-		multisampling.rasterizationSamples = msaaSamples;
-		multisampling.minSampleShading = .2f;
-		multisampling.pSampleMask = nullptr; // Optional
-		multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
-		multisampling.alphaToOneEnable = VK_FALSE; // Optional
-
-		// Color Blending
-		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-		colorBlendAttachment.blendEnable = VK_TRUE;
-		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA; // Incoming Fragment
-		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA; // Existing Fragment
-		colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD; // src*a + dst*(1-a)
-		// TODO: Sort all semi-transparent objects by distance to camera
-		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-		colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
-
-		VkPipelineColorBlendStateCreateInfo colorBlending{};
-		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		colorBlending.logicOpEnable = VK_FALSE;
-		colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
-		colorBlending.attachmentCount = 1;
-		colorBlending.pAttachments = &colorBlendAttachment;
-		colorBlending.blendConstants[0] = 0.0f; // Optional
-		colorBlending.blendConstants[1] = 0.0f; // Optional
-		colorBlending.blendConstants[2] = 0.0f; // Optional
-		colorBlending.blendConstants[3] = 0.0f; // Optional
-
-		// Layout
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 0; // Optional
+		// With dynamic state most variants are the same pipeline, only the state is set again
+		if (pipeline != boundPipeline) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			boundPipeline = pipeline;
+		}
 
-		auto pcLayouts = pushConstant.getPushConstantRanges();
-		pipelineLayoutInfo.pushConstantRangeCount = pcLayouts.size();
-		pipelineLayoutInfo.pPushConstantRanges = pcLayouts.size() == 0 ? nullptr : pcLayouts.data();
+		(*device).getPipelineCache().recordState(commandBuffer, state, meshPipeline);
+		return true;
+	}
 
-		if ((*device).getDescriptorSetLayout() == VK_NULL_HANDLE) {
-			Alert("Descriptor has error before pipeline construction!", FATAL);
-			return;
+	PipelineKey Pipeline::variantKey(const PipelineState& state)
+	{
+		PipelineKey key = baseKey;
+		key.state = state;
+		return (*device).getPipelineCache().normalize(key);
+	}
+
+	VkPipeline Pipeline::getVariant(const PipelineState& state)
+	{
+		if (!device || pipelineLayout == VK_NULL_HANDLE) return VK_NULL_HANDLE;
+
+		// First use of this state by this layout, other layouts may already have compiled it
+		PipelineKey key = variantKey(state);
+
+		auto& pipelineCache = (*device).getPipelineCache();
+		auto it = variants.find(state);
+		if (it == variants.end()) {
+			pipelineCache.prepare(key);
+			it = variants.insert({ state, VK_NULL_HANDLE }).first;
 		}
-		pipelineLayoutInfo.setLayoutCount = 1;
-		pipelineLayoutInfo.pSetLayouts = &((*device).getDescriptorSetLayout());
 
-		if (device.wait() != Manager::State::YES) {
-			Alert("Device died before it was ready to be used.", FATAL);
-			return;
+		// Never blocks, a failed compile stays null and was alerted by the cache
+		if (it->second == VK_NULL_HANDLE) {
+			it->second = pipelineCache.get(key);
 		}
+		return it->second;
+	}
 
-		if (vkCreatePipelineLayout((*device).getDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-			Alert("Failed to create pipeline layout!", FATAL);
-			return;
+	void Pipeline::refresh()
+	{
+		// Fast linked variants are replaced by their optimized link in the background
+		if (!device || generation == (*device).getPipelineCache().getGeneration()) return;
+
+		auto& pipelineCache = (*device).getPipelineCache();
+		generation = pipelineCache.getGeneration();
+
+		for (auto& variant : variants) {
+			if (variant.second == VK_NULL_HANDLE) continue;
+
+			variant.second = pipelineCache.get(variantKey(variant.first));
+		}
+
+		auto it = variants.find(defaultState);
+		graphicsPipeline = it != variants.end() ? it->second : VK_NULL_HANDLE;
+	}
+
+	void Pipeline::reload(Shader& shader)
+	{
+		if (!device || pipelineLayout == VK_NULL_HANDLE) return;
+
+		auto& pipelineCache = (*device).getPipelineCache();
+		if (reloading) {
+			pipelineCache.release(pendingKey, true);
+			abandoned.push_back(pendingKey);
 		}
 
-		VkPipelineDepthStencilStateCreateInfo depthStencil{};
-		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-		depthStencil.depthTestEnable = VK_TRUE;
-		depthStencil.depthWriteEnable = VK_TRUE;
-		depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+		pendingKey = baseKey;
+		pendingKey.state = defaultState;
+		pendingKey.stages.clear();
+		for (auto& stage : shader.getShaderStages()) {
+			pendingKey.stages.emplace_back(stage.stage, stage.module);
+		}
+		pendingKey = pipelineCache.normalize(pendingKey);
 
-		depthStencil.depthBoundsTestEnable = VK_FALSE; // Depth bound test
-		depthStencil.minDepthBounds = 0.0f; // Optional
-		depthStencil.maxDepthBounds = 1.0f; // Optional
+		pipelineCache.prepare(pendingKey);
+		reloading = true;
+	}
 
-		depthStencil.stencilTestEnable = VK_FALSE;
-		depthStencil.front = {}; // Optional
-		depthStencil.back = {}; // Optional
+	bool Pipeline::swap()
+	{
+		if (!reloading) return false;
+
+		auto& pipelineCache = (*device).getPipelineCache();
+		VkPipeline pipeline = pipelineCache.get(pendingKey);
+		if (pipeline == VK_NULL_HANDLE) {
+			if (pipelineCache.hasFailed(pendingKey)) {
+				Alert("Reloaded shaders failed to compile, keeping the previous pipeline.", WARNING);
+				pipelineCache.release(pendingKey, true);
+				reloading = false;
+			}
+			return false;
+		}
 
-		// Creation
-		VkGraphicsPipelineCreateInfo pipelineInfo{};
-		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 2;
-		pipelineInfo.pStages = shader.getShaderStages().data();
+		// The caller frees the old modules after a swap, nothing may still be compiling with them
+		for (auto& key : abandoned) {
+			if (pipelineCache.isPending(key)) return false;
+		}
+		for (auto& variant : variants) {
+			if (variant.second == VK_NULL_HANDLE && pipelineCache.isPending(variantKey(variant.first))) return false;
+		}
 
-		pipelineInfo.pVertexInputState = &vertexInputInfo;
-		pipelineInfo.pInputAssemblyState = &inputAssembly;
-		pipelineInfo.pViewportState = &viewportState;
-		pipelineInfo.pRasterizationState = &rasterizer;
-		pipelineInfo.pMultisampleState = &multisampling;
+		// Frames in flight may still be bound to the old variants
+		for (auto& variant : variants) {
+			pipelineCache.release(variantKey(variant.first), true);
+		}
+		variants.clear();
+		abandoned.clear();
+
+		baseKey.stages = pendingKey.stages;
+		variants[defaultState] = pipeline;
+		graphicsPipeline = pipeline;
+		reloading = false;
+		return true;
+	}
 
-		pipelineInfo.pDepthStencilState = &depthStencil;
+	void Pipeline::constructPipelineLayout(RenderPass& renderPass, Shader& shader, PushConstant& pushConstant, PipelineConstructInfo& info)
+	{
+		if (pipelineLayout != VK_NULL_HANDLE || getAlertSeverity() == FATAL) {
+			Alert("Warning: constructPipeline called more than once. All calls other than the first are skipped.", WARNING);
+			return;
+		}
 
-		pipelineInfo.pColorBlendState = &colorBlending;
-		pipelineInfo.pDynamicState = &dynamicState;
+		meshPipeline = shader.hasStage(VK_SHADER_STAGE_MESH_BIT_EXT);
 
-		pipelineInfo.layout = pipelineLayout;
-		pipelineInfo.renderPass = renderPass.getRenderPass();
-		pipelineInfo.subpass = 0;
+		auto pcLayouts = pushConstant.getPushConstantRanges();
+		for (auto& range : pcLayouts) {
+			if (range.offset + range.size > (*device).getProperties().limits.maxPushConstantsSize) {
+				Alert("Push constants exceed the device's maxPushConstantsSize!", FATAL);
+				return;
+			}
+		}
+		if (meshPipeline) {
+			meshletPushConstantOffset = 0;
+			for (auto& range : pcLayouts) {
+				meshletPushConstantOffset = std::max(meshletPushConstantOffset, range.offset + range.size);
+			}
+
+			VkPushConstantRange meshletRange{};
+			meshletRange.stageFlags = VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+			meshletRange.offset = meshletPushConstantOffset;
+			meshletRange.size = 2 * sizeof(uint32_t); // First meshlet, meshlet count
+			pcLayouts.push_back(meshletRange);
+
+			// The task shader cannot see the layout's own ranges, its block offset is baked in at compile time
+			if (meshletPushConstantOffset != 0) {
+				Alert("Meshlet push constants start at offset " + std::to_string(meshletPushConstantOffset) +
+					", the task shader must be compiled with -DMESHLET_PUSH_CONSTANT_OFFSET=" + std::to_string(meshletPushConstantOffset) + ".", INFO);
+			}
+		}
 
-		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
-		pipelineInfo.basePipelineIndex = -1; // Optional
+		// Ordered by update frequency: per frame, per material, then per pass data
+		std::vector<VkDescriptorSetLayout> setLayouts;
+		if (info.frameSet) {
+			if ((*device).getFrameGlobals().getDescriptorSetLayout() == VK_NULL_HANDLE) {
+				Alert("Frame globals have no descriptor set layout!", FATAL);
+				return;
+			}
+			setLayouts.push_back((*device).getFrameGlobals().getDescriptorSetLayout());
+		}
 
-		if (device.wait() != Manager::State::YES) {
-			Alert("Device died before it was ready to be used.", FATAL);
+		VkDescriptorSetLayout objectSetLayout = info.bindless ? (*device).getBindlessHeap().getDescriptorSetLayout() : (*device).getDescriptorSetLayout();
+		if (objectSetLayout == VK_NULL_HANDLE) {
+			Alert("Descriptor has error before pipeline construction!", FATAL);
 			return;
 		}
-		if (vkCreateGraphicsPipelines((*device).getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-			Alert("Failed to create graphics pipeline!", FATAL);
+		objectSet = static_cast<uint32_t>(setLayouts.size());
+		setLayouts.push_back(objectSetLayout);
+
+		meshletSet = static_cast<uint32_t>(setLayouts.size());
+		if (meshPipeline) {
+			if (info.meshletSetLayout == VK_NULL_HANDLE) {
+				Alert("Mesh shader pipeline requires the meshlet descriptor set layout!", FATAL);
+				return;
+			}
+			setLayouts.push_back(info.meshletSetLayout);
+		}
+
+		// Layouts with the same sets and push constants share one, so their pipelines can be shared too
+		auto& pipelineCache = (*device).getPipelineCache();
+		pipelineLayout = pipelineCache.acquireLayout(setLayouts, pcLayouts);
+		if (pipelineLayout == VK_NULL_HANDLE) {
+			Alert("Failed to create pipeline layout!", FATAL);
 			return;
 		}
+
+		baseKey.layout = pipelineLayout;
+		baseKey.renderPass = info.depthOnly ? renderPass.getDepthRenderPass() : renderPass.getRenderPass();
+		baseKey.colorFormat = info.depthOnly ? VK_FORMAT_UNDEFINED : renderPass.getColorFormat();
+		baseKey.depthFormat = renderPass.getDepthFormat();
+		baseKey.depthOnly = info.depthOnly;
+		baseKey.stages.clear();
+		for (auto& stage : shader.getShaderStages()) {
+			baseKey.stages.emplace_back(stage.stage, stage.module);
+		}
+
+		// Sorted so the same values in a different order share a pipeline
+		baseKey.specialization = info.specialization;
+		std::sort(baseKey.specialization.begin(), baseKey.specialization.end());
+		for (size_t i = 1; i < baseKey.specialization.size(); i++) {
+			if (baseKey.specialization[i].id == baseKey.specialization[i - 1].id) {
+				Alert("Specialization constant " + std::to_string(baseKey.specialization[i].id) + " is set twice!", FATAL);
+				return;
+			}
+		}
+
+		// Compiles in the background, RenderContext::Ready() waits for it
+		defaultState = info.state;
+		graphicsPipeline = getVariant(defaultState);
 	}
 }
\ No newline at end of file
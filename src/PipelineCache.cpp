@@ -0,0 +1,863 @@
+#include "PipelineCache.h"
+
+#include "Device.h"
+#include "DescriptorSet.h"
+
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+
+namespace Render
+{
+	PipelineCache::PipelineCache()
+	{
+	}
+
+	PipelineCache::~PipelineCache()
+	{
+		destroy();
+	}
+
+	void PipelineCache::init(Device* device, PipelineCacheConfig config)
+	{
+		destroy();
+
+		this->device = device;
+		this->config = config;
+
+		loadPipelineCache();
+		loadDynamicState();
+		workers.init(config.compileThreads);
+	}
+
+	void PipelineCache::destroy()
+	{
+		workers.destroy();
+
+		if (device) {
+			for (auto& pipeline : pipelines) {
+				collect(pipeline.second, true);
+				upgrade(pipeline.second, true);
+				vkDestroyPipeline(device->getDevice(), pipeline.second.handle, nullptr);
+			}
+			for (auto& retired : retiredHandles) {
+				vkDestroyPipeline(device->getDevice(), retired.first, nullptr);
+			}
+			destroyLibraries();
+			for (auto& layout : layouts) {
+				vkDestroyPipelineLayout(device->getDevice(), layout.second.handle, nullptr);
+			}
+
+			if (pipelineCache != VK_NULL_HANDLE) {
+				savePipelineCache();
+				vkDestroyPipelineCache(device->getDevice(), pipelineCache, nullptr);
+				pipelineCache = VK_NULL_HANDLE;
+			}
+		}
+		pipelines.clear();
+		layouts.clear();
+		retiredHandles.clear();
+
+		dynamicBasic = false;
+		dynamicExtended = false;
+
+		device = nullptr;
+	}
+
+	void PipelineCache::loadPipelineCache()
+	{
+		std::vector<char> data;
+		if (!config.path.empty()) {
+			std::ifstream file(config.path, std::ios::binary);
+			if (file.is_open()) {
+				data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			}
+		}
+
+		// Data from another driver or device is rejected by the header check, retry empty
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = data.size();
+		cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+		if (vkCreatePipelineCache(device->getDevice(), &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+			cacheInfo.initialDataSize = 0;
+			cacheInfo.pInitialData = nullptr;
+			if (vkCreatePipelineCache(device->getDevice(), &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+				Alert("Failed to create pipeline cache, pipelines compile without one.", WARNING);
+				pipelineCache = VK_NULL_HANDLE;
+			}
+		}
+	}
+
+	void PipelineCache::savePipelineCache()
+	{
+		if (config.path.empty()) return;
+
+		size_t size = 0;
+		if (vkGetPipelineCacheData(device->getDevice(), pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0) return;
+
+		std::vector<char> data(size);
+		if (vkGetPipelineCacheData(device->getDevice(), pipelineCache, &size, data.data()) != VK_SUCCESS) return;
+
+		std::ofstream file(config.path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			Alert("Failed to save pipeline cache to " + config.path, WARNING);
+			return;
+		}
+		file.write(data.data(), static_cast<std::streamsize>(size));
+	}
+
+	void PipelineCache::loadDynamicState()
+	{
+		if (!config.dynamicState) return;
+
+		auto load = [this](const char* name) { return vkGetDeviceProcAddr(device->getDevice(), name); };
+
+		if (device->getFeatures().extendedDynamicState) {
+			m_vkCmdSetCullMode = (PFN_vkCmdSetCullModeEXT)load("vkCmdSetCullModeEXT");
+			m_vkCmdSetFrontFace = (PFN_vkCmdSetFrontFaceEXT)load("vkCmdSetFrontFaceEXT");
+			m_vkCmdSetPrimitiveTopology = (PFN_vkCmdSetPrimitiveTopologyEXT)load("vkCmdSetPrimitiveTopologyEXT");
+			m_vkCmdSetDepthTestEnable = (PFN_vkCmdSetDepthTestEnableEXT)load("vkCmdSetDepthTestEnableEXT");
+			m_vkCmdSetDepthWriteEnable = (PFN_vkCmdSetDepthWriteEnableEXT)load("vkCmdSetDepthWriteEnableEXT");
+			m_vkCmdSetDepthCompareOp = (PFN_vkCmdSetDepthCompareOpEXT)load("vkCmdSetDepthCompareOpEXT");
+
+			dynamicBasic = m_vkCmdSetCullMode && m_vkCmdSetFrontFace && m_vkCmdSetPrimitiveTopology &&
+				m_vkCmdSetDepthTestEnable && m_vkCmdSetDepthWriteEnable && m_vkCmdSetDepthCompareOp;
+		}
+
+		if (device->getFeatures().extendedDynamicState3) {
+			m_vkCmdSetPolygonMode = (PFN_vkCmdSetPolygonModeEXT)load("vkCmdSetPolygonModeEXT");
+			m_vkCmdSetColorBlendEnable = (PFN_vkCmdSetColorBlendEnableEXT)load("vkCmdSetColorBlendEnableEXT");
+			m_vkCmdSetColorBlendEquation = (PFN_vkCmdSetColorBlendEquationEXT)load("vkCmdSetColorBlendEquationEXT");
+
+			dynamicExtended = m_vkCmdSetPolygonMode && m_vkCmdSetColorBlendEnable && m_vkCmdSetColorBlendEquation;
+		}
+	}
+
+	PipelineKey PipelineCache::normalize(const PipelineKey& key)
+	{
+		PipelineKey normalized = key;
+		auto& state = normalized.state;
+		PipelineState defaults{};
+
+		bool meshPipeline = false;
+		for (auto& stage : key.stages) {
+			meshPipeline |= stage.first == VK_SHADER_STAGE_MESH_BIT_EXT;
+		}
+
+		if (dynamicBasic) {
+			state.cullMode = defaults.cullMode;
+			state.frontFace = defaults.frontFace;
+			state.depthTest = defaults.depthTest;
+			state.depthWrite = defaults.depthWrite;
+			state.depthCompare = defaults.depthCompare;
+
+			// Only the topology class is baked, e.g. strips are set on a list pipeline
+			switch (state.topology) {
+				case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+					break;
+				case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+				case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+					state.topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+					break;
+				case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST:
+				case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP:
+				case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN:
+					state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+					break;
+				default:
+					break;
+			}
+			if (meshPipeline) state.topology = defaults.topology;
+		}
+
+		if (dynamicExtended) {
+			state.polygonMode = defaults.polygonMode;
+			state.blend = defaults.blend;
+		}
+
+		return normalized;
+	}
+
+	void PipelineCache::recordState(VkCommandBuffer commandBuffer, const PipelineState& state, bool meshPipeline)
+	{
+		if (dynamicBasic) {
+			m_vkCmdSetCullMode(commandBuffer, state.cullMode);
+			m_vkCmdSetFrontFace(commandBuffer, state.frontFace);
+			if (!meshPipeline) m_vkCmdSetPrimitiveTopology(commandBuffer, state.topology);
+			m_vkCmdSetDepthTestEnable(commandBuffer, state.depthTest ? VK_TRUE : VK_FALSE);
+			m_vkCmdSetDepthWriteEnable(commandBuffer, state.depthWrite ? VK_TRUE : VK_FALSE);
+			m_vkCmdSetDepthCompareOp(commandBuffer, state.depthCompare);
+		}
+
+		if (dynamicExtended) {
+			m_vkCmdSetPolygonMode(commandBuffer, state.polygonMode);
+
+			VkBool32 blendEnable = state.blend == BLEND_OPAQUE ? VK_FALSE : VK_TRUE;
+			m_vkCmdSetColorBlendEnable(commandBuffer, 0, 1, &blendEnable);
+
+			// Same equation as the baked color blend attachment
+			VkColorBlendEquationEXT equation{};
+			equation.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+			equation.dstColorBlendFactor = state.blend == BLEND_ADDITIVE ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+			equation.colorBlendOp = VK_BLEND_OP_ADD;
+			equation.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+			equation.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+			equation.alphaBlendOp = VK_BLEND_OP_ADD;
+			m_vkCmdSetColorBlendEquation(commandBuffer, 0, 1, &equation);
+		}
+	}
+
+	VkPipelineLayout PipelineCache::acquireLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants)
+	{
+		if (!isActive()) return VK_NULL_HANDLE;
+
+		LayoutKey key{ setLayouts, {} };
+		for (auto& range : pushConstants) {
+			key.second.emplace_back(range.stageFlags, range.offset, range.size);
+		}
+
+		auto it = layouts.find(key);
+		if (it != layouts.end()) {
+			it->second.references++;
+			return it->second.handle;
+		}
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstants.size());
+		pipelineLayoutInfo.pPushConstantRanges = pushConstants.empty() ? nullptr : pushConstants.data();
+
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		if (vkCreatePipelineLayout(device->getDevice(), &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS) {
+			Alert("Failed to create pipeline layout!", CRITICAL);
+			return VK_NULL_HANDLE;
+		}
+
+		layouts[key] = { layout, 1 };
+		return layout;
+	}
+
+	void PipelineCache::releaseLayout(VkPipelineLayout layout)
+	{
+		for (auto& entry : layouts) {
+			if (entry.second.handle == layout) {
+				if (entry.second.references > 0) entry.second.references--;
+				return;
+			}
+		}
+	}
+
+	VkPipeline PipelineCache::acquire(const PipelineKey& key)
+	{
+		if (!isActive()) return VK_NULL_HANDLE;
+
+		prepare(key);
+
+		auto& entry = pipelines[key];
+		collect(entry, true);
+		return entry.handle;
+	}
+
+	void PipelineCache::prepare(const PipelineKey& key)
+	{
+		if (!isActive()) return;
+
+		auto it = pipelines.find(key);
+		if (it != pipelines.end()) {
+			it->second.references++;
+			it->second.retired = false;
+			it->second.framesRetired = 0;
+			return;
+		}
+
+		auto& entry = pipelines[key];
+		entry.references = 1;
+		entry.result = std::make_shared<VkPipeline>(VK_NULL_HANDLE);
+
+		if (!workers.isRunning()) {
+			entry.handle = createPipeline(key);
+			entry.failed = entry.handle == VK_NULL_HANDLE;
+			if (entry.failed) Alert("Failed to create graphics pipeline!", CRITICAL);
+			return;
+		}
+
+		// The key is copied, shader modules and layouts outlive the compile since the entry holds a reference
+		auto result = entry.result;
+		entry.compiling = workers.submit([this, key, result]() { *result = createPipeline(key); });
+
+		// Queued behind the fast link, replaces it in advanceFrame() once done
+		if (usesLibraries(key)) {
+			auto optimized = std::make_shared<VkPipeline>(VK_NULL_HANDLE);
+			entry.optimized = optimized;
+			entry.optimizing = workers.submit([this, key, optimized]() { *optimized = linkPipeline(key, true); });
+		}
+	}
+
+	VkPipeline PipelineCache::get(const PipelineKey& key)
+	{
+		auto it = pipelines.find(key);
+		if (it == pipelines.end()) return VK_NULL_HANDLE;
+
+		collect(it->second, false);
+		return it->second.handle;
+	}
+
+	bool PipelineCache::collect(PipelineEntry& entry, bool wait)
+	{
+		if (!entry.compiling.valid()) return entry.handle != VK_NULL_HANDLE;
+
+		if (!wait && entry.compiling.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+
+		entry.compiling.get();
+		entry.handle = *entry.result;
+		entry.result.reset();
+
+		if (entry.handle == VK_NULL_HANDLE) {
+			entry.failed = true;
+			Alert("Failed to create graphics pipeline!", CRITICAL);
+		}
+		return entry.handle != VK_NULL_HANDLE;
+	}
+
+	void PipelineCache::upgrade(PipelineEntry& entry, bool wait)
+	{
+		if (!entry.optimizing.valid()) return;
+		if (!wait && entry.optimizing.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+
+		entry.optimizing.get();
+		VkPipeline optimized = *entry.optimized;
+		entry.optimized.reset();
+		if (optimized == VK_NULL_HANDLE) return; // Keep the fast link
+
+		// Frames in flight may still be bound to the fast link
+		if (entry.handle != VK_NULL_HANDLE) retiredHandles.push_back({ entry.handle, 0 });
+		entry.handle = optimized;
+		entry.failed = false;
+		generation++;
+	}
+
+	void PipelineCache::forgetModule(VkShaderModule module)
+	{
+		if (!isActive()) return;
+
+		// Compiles still reading the module finish first
+		for (auto& pipeline : pipelines) {
+			for (auto& stage : pipeline.first.stages) {
+				if (stage.second == module) {
+					collect(pipeline.second, true);
+					upgrade(pipeline.second, true);
+					break;
+				}
+			}
+		}
+
+		// Destroyed modules' handles can be reused, parts built from them must not be found again
+		std::lock_guard<std::mutex> lock(libraryMutex);
+		for (auto it = libraries.begin(); it != libraries.end();) {
+			bool uses = false;
+			for (auto& stage : it->first.second.stages) {
+				uses |= stage.second == module;
+			}
+
+			if (uses) {
+				staleLibraries.push_back(it->second);
+				it = libraries.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+
+	void PipelineCache::destroyLibraries()
+	{
+		std::lock_guard<std::mutex> lock(libraryMutex);
+		for (auto& library : libraries) {
+			vkDestroyPipeline(device->getDevice(), library.second.get(), nullptr);
+		}
+		for (auto& library : staleLibraries) {
+			vkDestroyPipeline(device->getDevice(), library.get(), nullptr);
+		}
+		libraries.clear();
+		staleLibraries.clear();
+	}
+
+	void PipelineCache::finish()
+	{
+		for (auto& pipeline : pipelines) {
+			collect(pipeline.second, true);
+		}
+	}
+
+	void PipelineCache::release(const PipelineKey& key, bool retire)
+	{
+		// By key, the handle is still null while compiling
+		auto it = pipelines.find(key);
+		if (it == pipelines.end()) return;
+
+		if (it->second.references > 0) it->second.references--;
+		it->second.retired |= retire;
+	}
+
+	bool PipelineCache::isPending(const PipelineKey& key)
+	{
+		auto it = pipelines.find(key);
+		if (it == pipelines.end()) return false;
+
+		// Including the optimized link, it still reads the shader modules
+		collect(it->second, false);
+		upgrade(it->second, false);
+		return it->second.compiling.valid() || it->second.optimizing.valid();
+	}
+
+	bool PipelineCache::hasFailed(const PipelineKey& key)
+	{
+		auto it = pipelines.find(key);
+		if (it == pipelines.end()) return false;
+
+		collect(it->second, false);
+		return it->second.failed;
+	}
+
+	void PipelineCache::advanceFrame()
+	{
+		if (!isActive()) return;
+
+		for (auto it = retiredHandles.begin(); it != retiredHandles.end();) {
+			if (++it->second > MAX_FRAMES_IN_FLIGHT) {
+				vkDestroyPipeline(device->getDevice(), it->first, nullptr);
+				it = retiredHandles.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+
+		for (auto it = pipelines.begin(); it != pipelines.end();) {
+			auto& entry = it->second;
+			upgrade(entry, false);
+			if (entry.retired && entry.references == 0) {
+				collect(entry, false);
+				if (!entry.compiling.valid() && !entry.optimizing.valid() && ++entry.framesRetired > MAX_FRAMES_IN_FLIGHT) {
+					vkDestroyPipeline(device->getDevice(), entry.handle, nullptr);
+					it = pipelines.erase(it);
+					continue;
+				}
+			}
+			++it;
+		}
+	}
+
+	void PipelineCache::trim()
+	{
+		if (!isActive()) return;
+
+		bool compiling = false;
+		for (auto it = pipelines.begin(); it != pipelines.end();) {
+			compiling |= it->second.compiling.valid() || it->second.optimizing.valid();
+			if (it->second.references == 0 && !it->second.compiling.valid() && !it->second.optimizing.valid()) {
+				vkDestroyPipeline(device->getDevice(), it->second.handle, nullptr);
+				it = pipelines.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+
+		// Linked pipelines do not need their parts, they are built again for the next new variant
+		if (!compiling) destroyLibraries();
+
+		// After pipelines, a layout is only unused once every pipeline made with it is gone
+		for (auto it = layouts.begin(); it != layouts.end();) {
+			if (it->second.references == 0) {
+				vkDestroyPipelineLayout(device->getDevice(), it->second.handle, nullptr);
+				it = layouts.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+
+	namespace
+	{
+		// Every create info of one key, pointers point into the object so it never moves
+		struct PipelineCreateState
+		{
+			PipelineCreateState(const PipelineKey& key, VkSampleCountFlagBits defaultSamples, bool dynamicBasic, bool dynamicExtended);
+			PipelineCreateState(const PipelineCreateState&) = delete;
+
+			// parts = 0 for a complete pipeline, otherwise only what those library parts need
+			VkGraphicsPipelineCreateInfo info(VkGraphicsPipelineLibraryFlagsEXT parts = 0);
+
+			bool meshPipeline = false;
+
+			std::vector<VkSpecializationMapEntry> specializationEntries;
+			std::vector<uint32_t> specializationData;
+			VkSpecializationInfo specializationInfo{};
+
+			std::vector<VkPipelineShaderStageCreateInfo> preRasterStages;
+			std::vector<VkPipelineShaderStageCreateInfo> fragmentStages;
+			std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+
+			VkVertexInputBindingDescription bindingDescription{};
+			std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
+			VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+			VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+
+			std::vector<VkDynamicState> dynamicStates;
+			VkPipelineDynamicStateCreateInfo dynamicState{};
+			VkPipelineViewportStateCreateInfo viewportState{};
+
+			VkPipelineRasterizationStateCreateInfo rasterizer{};
+			VkPipelineMultisampleStateCreateInfo multisampling{};
+
+			VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+			VkPipelineColorBlendStateCreateInfo colorBlending{};
+			VkPipelineDepthStencilStateCreateInfo depthStencil{};
+
+			VkPipelineLayout layout = VK_NULL_HANDLE;
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+
+			VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+			VkPipelineRenderingCreateInfoKHR rendering{}; // Without a render pass
+		};
+
+		PipelineCreateState::PipelineCreateState(const PipelineKey& key, VkSampleCountFlagBits defaultSamples, bool dynamicBasic, bool dynamicExtended)
+		{
+			auto& state = key.state;
+
+			// Shared by every stage, the driver folds the values into each module that declares them
+			for (auto& constant : key.specialization) {
+				VkSpecializationMapEntry entry{};
+				entry.constantID = constant.id;
+				entry.offset = static_cast<uint32_t>(specializationData.size() * sizeof(uint32_t));
+				entry.size = sizeof(uint32_t);
+				specializationEntries.push_back(entry);
+				specializationData.push_back(constant.value);
+			}
+
+			specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+			specializationInfo.pMapEntries = specializationEntries.data();
+			specializationInfo.dataSize = specializationData.size() * sizeof(uint32_t);
+			specializationInfo.pData = specializationData.data();
+
+			for (auto& stage : key.stages) {
+				VkPipelineShaderStageCreateInfo shaderStageInfo{};
+				shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+				shaderStageInfo.stage = stage.first;
+				shaderStageInfo.module = stage.second;
+				shaderStageInfo.pName = "main";
+				shaderStageInfo.pSpecializationInfo = specializationEntries.empty() ? nullptr : &specializationInfo;
+				shaderStages.push_back(shaderStageInfo);
+
+				if (stage.first == VK_SHADER_STAGE_FRAGMENT_BIT) {
+					fragmentStages.push_back(shaderStageInfo);
+				}
+				else {
+					preRasterStages.push_back(shaderStageInfo);
+				}
+
+				meshPipeline |= stage.first == VK_SHADER_STAGE_MESH_BIT_EXT;
+			}
+
+			// Verts
+			bindingDescription = Vertex::getBindingDescriptions();
+			attributeDescriptions = Vertex::getAttributeDescriptions();
+
+			vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+			vertexInputInfo.vertexBindingDescriptionCount = 1;
+			vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+			vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+			vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+			// Input assembly
+			inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+			inputAssembly.topology = state.topology;
+			inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+			dynamicStates = {
+				VK_DYNAMIC_STATE_VIEWPORT,
+				VK_DYNAMIC_STATE_SCISSOR
+			};
+			if (dynamicBasic) {
+				dynamicStates.insert(dynamicStates.end(), {
+					VK_DYNAMIC_STATE_CULL_MODE_EXT,
+					VK_DYNAMIC_STATE_FRONT_FACE_EXT,
+					VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+					VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+					VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT
+				});
+				if (!meshPipeline) dynamicStates.push_back(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT);
+			}
+			if (dynamicExtended) {
+				dynamicStates.insert(dynamicStates.end(), {
+					VK_DYNAMIC_STATE_POLYGON_MODE_EXT,
+					VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT,
+					VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT
+				});
+			}
+
+			dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+			dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+			dynamicState.pDynamicStates = dynamicStates.data();
+
+			viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+			viewportState.viewportCount = 1;
+			viewportState.scissorCount = 1;
+
+			// Rasterizer
+			rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+			rasterizer.depthClampEnable = VK_FALSE;
+			rasterizer.rasterizerDiscardEnable = VK_FALSE;
+			rasterizer.polygonMode = state.polygonMode;
+			rasterizer.lineWidth = 1.0f;
+			rasterizer.cullMode = state.cullMode;
+			rasterizer.frontFace = state.frontFace;
+			rasterizer.depthBiasEnable = VK_FALSE;
+
+			multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+			multisampling.sampleShadingEnable = state.minSampleShading > 0.0f && !key.depthOnly ? VK_TRUE : VK_FALSE;
+			multisampling.rasterizationSamples = state.samples != 0 ? state.samples : defaultSamples;
+			multisampling.minSampleShading = state.minSampleShading;
+			multisampling.pSampleMask = nullptr; // Optional
+			multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
+			multisampling.alphaToOneEnable = VK_FALSE; // Optional
+
+			// Color Blending
+			colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+			colorBlendAttachment.blendEnable = state.blend == BLEND_OPAQUE ? VK_FALSE : VK_TRUE;
+			colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA; // Incoming Fragment
+			colorBlendAttachment.dstColorBlendFactor = state.blend == BLEND_ADDITIVE ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA; // Existing Fragment
+			colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+			// Blended sub-buffers with bounds can be drawn back to front, see LayoutConfig::sortDraws
+			colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
+			colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
+			colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
+
+			colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+			colorBlending.logicOpEnable = VK_FALSE;
+			colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
+			colorBlending.attachmentCount = key.depthOnly ? 0 : 1;
+			colorBlending.pAttachments = &colorBlendAttachment;
+
+			depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+			depthStencil.depthTestEnable = state.depthTest ? VK_TRUE : VK_FALSE;
+			depthStencil.depthWriteEnable = state.depthWrite ? VK_TRUE : VK_FALSE;
+			depthStencil.depthCompareOp = state.depthCompare;
+
+			depthStencil.depthBoundsTestEnable = VK_FALSE; // Depth bound test
+			depthStencil.minDepthBounds = 0.0f; // Optional
+			depthStencil.maxDepthBounds = 1.0f; // Optional
+
+			depthStencil.stencilTestEnable = VK_FALSE;
+
+			layout = key.layout;
+			renderPass = key.renderPass;
+
+			colorFormat = key.colorFormat;
+			rendering.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+			rendering.colorAttachmentCount = colorFormat != VK_FORMAT_UNDEFINED ? 1 : 0;
+			rendering.pColorAttachmentFormats = &colorFormat;
+			rendering.depthAttachmentFormat = key.depthFormat;
+		}
+
+		VkGraphicsPipelineCreateInfo PipelineCreateState::info(VkGraphicsPipelineLibraryFlagsEXT parts)
+		{
+			bool complete = parts == 0;
+			bool vertexInput = complete || (parts & VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT);
+			bool preRaster = complete || (parts & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT);
+			bool fragment = complete || (parts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT);
+			bool output = complete || (parts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT);
+
+			auto& stages = complete ? shaderStages : (preRaster ? preRasterStages : fragmentStages);
+
+			VkGraphicsPipelineCreateInfo pipelineInfo{};
+			pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+			if (preRaster || fragment) {
+				pipelineInfo.stageCount = static_cast<uint32_t>(stages.size());
+				pipelineInfo.pStages = stages.data();
+			}
+
+			// Mesh shaders fetch their own vertices
+			pipelineInfo.pVertexInputState = vertexInput && !meshPipeline ? &vertexInputInfo : nullptr;
+			pipelineInfo.pInputAssemblyState = vertexInput && !meshPipeline ? &inputAssembly : nullptr;
+			pipelineInfo.pViewportState = preRaster ? &viewportState : nullptr;
+			pipelineInfo.pRasterizationState = preRaster ? &rasterizer : nullptr;
+			pipelineInfo.pMultisampleState = fragment || output ? &multisampling : nullptr;
+
+			pipelineInfo.pDepthStencilState = fragment ? &depthStencil : nullptr;
+
+			pipelineInfo.pColorBlendState = output ? &colorBlending : nullptr;
+			pipelineInfo.pDynamicState = &dynamicState; // States outside the parts being built are ignored
+
+			pipelineInfo.layout = preRaster || fragment ? layout : VK_NULL_HANDLE;
+			pipelineInfo.renderPass = preRaster || fragment || output ? renderPass : VK_NULL_HANDLE;
+			pipelineInfo.subpass = 0;
+			if (renderPass == VK_NULL_HANDLE && (preRaster || fragment || output)) {
+				pipelineInfo.pNext = &rendering;
+			}
+
+			pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
+			pipelineInfo.basePipelineIndex = -1; // Optional
+
+			return pipelineInfo;
+		}
+	}
+
+	bool PipelineCache::usesLibraries(const PipelineKey& key)
+	{
+		if (!config.pipelineLibraries || !device->getFeatures().graphicsPipelineLibrary) return false;
+
+		// Depth only pipelines are small enough to compile whole
+		if (key.depthOnly) return false;
+
+		// Mesh pipelines have no vertex input part
+		for (auto& stage : key.stages) {
+			if (stage.first == VK_SHADER_STAGE_MESH_BIT_EXT) return false;
+		}
+		return true;
+	}
+
+	VkPipeline PipelineCache::createPipeline(const PipelineKey& key)
+	{
+		if (usesLibraries(key)) return linkPipeline(key, false);
+
+		PipelineCreateState create(key, device->getConfig().desiredMSAASamples, dynamicBasic, dynamicExtended);
+		auto pipelineInfo = create.info();
+
+		// VkPipelineCache is internally synchronized, workers share it
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		if (vkCreateGraphicsPipelines(device->getDevice(), pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+			return VK_NULL_HANDLE;
+		}
+
+		return pipeline;
+	}
+
+	PipelineKey PipelineCache::libraryKey(VkGraphicsPipelineLibraryFlagsEXT part, const PipelineKey& key)
+	{
+		// Only what the part is built from, so variants differing elsewhere share it
+		PipelineKey partKey{};
+		auto& state = key.state;
+		switch (part) {
+			case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+				partKey.state.topology = state.topology;
+				break;
+			case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+				for (auto& stage : key.stages) {
+					if (stage.first != VK_SHADER_STAGE_FRAGMENT_BIT) partKey.stages.push_back(stage);
+				}
+				partKey.specialization = key.specialization;
+				partKey.state.polygonMode = state.polygonMode;
+				partKey.state.cullMode = state.cullMode;
+				partKey.state.frontFace = state.frontFace;
+				partKey.layout = key.layout;
+				partKey.renderPass = key.renderPass;
+				partKey.colorFormat = key.colorFormat;
+				partKey.depthFormat = key.depthFormat;
+				break;
+			case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+				for (auto& stage : key.stages) {
+					if (stage.first == VK_SHADER_STAGE_FRAGMENT_BIT) partKey.stages.push_back(stage);
+				}
+				partKey.specialization = key.specialization;
+				partKey.state.depthTest = state.depthTest;
+				partKey.state.depthWrite = state.depthWrite;
+				partKey.state.depthCompare = state.depthCompare;
+				partKey.state.samples = state.samples;
+				partKey.state.minSampleShading = state.minSampleShading;
+				partKey.layout = key.layout;
+				partKey.renderPass = key.renderPass;
+				partKey.colorFormat = key.colorFormat;
+				partKey.depthFormat = key.depthFormat;
+				break;
+			case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT:
+				partKey.state.blend = state.blend;
+				partKey.state.samples = state.samples;
+				partKey.state.minSampleShading = state.minSampleShading;
+				partKey.renderPass = key.renderPass;
+				partKey.colorFormat = key.colorFormat;
+				partKey.depthFormat = key.depthFormat;
+				break;
+		}
+		return partKey;
+	}
+
+	VkPipeline PipelineCache::getLibrary(VkGraphicsPipelineLibraryFlagsEXT part, const PipelineKey& key)
+	{
+		// The first worker to need a part builds it, the others wait on its future
+		auto partKey = std::make_pair(part, libraryKey(part, key));
+
+		std::shared_future<VkPipeline> existing;
+		std::promise<VkPipeline> promise;
+		{
+			std::lock_guard<std::mutex> lock(libraryMutex);
+			auto it = libraries.find(partKey);
+			if (it != libraries.end()) {
+				existing = it->second;
+			}
+			else {
+				libraries[partKey] = promise.get_future().share();
+			}
+		}
+		if (existing.valid()) return existing.get();
+
+		PipelineCreateState create(partKey.second, device->getConfig().desiredMSAASamples, dynamicBasic, dynamicExtended);
+		auto pipelineInfo = create.info(part);
+
+		// Retained so the optimized link can still inline across parts
+		VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{};
+		libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+		libraryInfo.flags = part;
+		libraryInfo.pNext = pipelineInfo.pNext;
+		pipelineInfo.pNext = &libraryInfo;
+		pipelineInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+		VkPipeline library = VK_NULL_HANDLE;
+		if (vkCreateGraphicsPipelines(device->getDevice(), pipelineCache, 1, &pipelineInfo, nullptr, &library) != VK_SUCCESS) {
+			library = VK_NULL_HANDLE;
+		}
+
+		promise.set_value(library);
+		return library;
+	}
+
+	VkPipeline PipelineCache::linkPipeline(const PipelineKey& key, bool optimize)
+	{
+		std::array<VkPipeline, 4> parts = {
+			getLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT, key),
+			getLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT, key),
+			getLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT, key),
+			getLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT, key)
+		};
+		for (auto part : parts) {
+			if (part == VK_NULL_HANDLE) return VK_NULL_HANDLE;
+		}
+
+		VkPipelineLibraryCreateInfoKHR linkInfo{};
+		linkInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+		linkInfo.libraryCount = static_cast<uint32_t>(parts.size());
+		linkInfo.pLibraries = parts.data();
+
+		// A fast link only stitches the parts together, the optimized one recompiles them as a whole
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.pNext = &linkInfo;
+		pipelineInfo.flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+		pipelineInfo.layout = key.layout;
+		pipelineInfo.basePipelineIndex = -1;
+
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		if (vkCreateGraphicsPipelines(device->getDevice(), pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+			return VK_NULL_HANDLE;
+		}
+
+		return pipeline;
+	}
+}
@@ -1,5 +1,8 @@
 #include "PushConstant.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace Render
 {
     std::vector<VkPushConstantRange> PushConstantInfo::decode(std::vector<PushConstantInfo> info)
@@ -34,37 +37,77 @@ namespace Render
     PushConstant::~PushConstant() {}
 
     void PushConstant::init(PushConstantConstructInfo info) {
-        auto layouts = PushConstantInfo::decode(info.layouts);
+        destroy();
+
+        VkPushConstantRange packed{};
+        for (auto layout : PushConstantInfo::decode(info.layouts)) {
+            pcData.push_back({ nullptr, layout.offset, layout.size });
+            packed.stageFlags |= layout.stageFlags;
+            packed.size = layout.offset + layout.size;
+        }
+        block.resize(packed.size);
 
-        for (auto layout : layouts) {
-            pcData.emplace_back(nullptr, layout);
+        // Draw block follows the PushConstantInfo ranges
+        drawBlock = info.drawBlock;
+        drawOffset = packed.size;
+        if (drawBlock.size > 0) {
+            packed.stageFlags |= drawBlock.stages;
+            packed.size += drawBlock.size;
         }
+
+        if (packed.size > 0) ranges.push_back(packed);
     }
 
     void PushConstant::destroy()
     {
         pcData.clear();
+        block.clear();
+        ranges.clear();
+
+        drawBlock = {};
+        drawOffset = 0;
+        drawData.clear();
     }
 
     void PushConstant::record(VkCommandBuffer commandBuffer, VkPipelineLayout& layout)
     {
-        for (auto data : pcData) {
-            if (data.data) vkCmdPushConstants(commandBuffer, layout, 
-                data.layout.stageFlags, data.layout.offset, data.layout.size, data.data);
+        if (ranges.empty() || block.empty()) return;
+
+        bool any = false;
+        for (auto& data : pcData) {
+            if (data.data) {
+                memcpy(block.data() + data.offset, data.data, data.size);
+                any = true;
+            }
         }
+
+        if (any) vkCmdPushConstants(commandBuffer, layout, ranges[0].stageFlags, 0, static_cast<uint32_t>(block.size()), block.data());
     }
 
-    std::vector<VkPushConstantRange> PushConstant::getPushConstantRanges() {
-        std::vector<VkPushConstantRange> ranges{};
-        for (auto data : pcData) {
-            ranges.push_back(data.layout);
-        }
+    void PushConstant::recordDraw(VkCommandBuffer commandBuffer, VkPipelineLayout& layout, uint32_t index)
+    {
+        if (drawBlock.size == 0 || drawData.empty()) return;
+
+        uint32_t count = static_cast<uint32_t>(drawData.size() / drawBlock.size);
+        index = std::min(index, count - 1);
 
-        return ranges;
+        vkCmdPushConstants(commandBuffer, layout, ranges[0].stageFlags, drawOffset, drawBlock.size, drawData.data() + index * drawBlock.size);
     }
 
     void PushConstant::addPushConstantData(void* data, int layoutIndex)
     {
+        if (layoutIndex < 0 || layoutIndex >= pcData.size()) {
+            Alert("Push constant layout index out of range.", WARNING);
+            return;
+        }
         pcData[layoutIndex].data = data;
     }
+
+    void PushConstant::setDrawBytes(uint32_t index, const void* data)
+    {
+        size_t end = static_cast<size_t>(index + 1) * drawBlock.size;
+        if (drawData.size() < end) drawData.resize(end);
+
+        memcpy(drawData.data() + index * drawBlock.size, data, drawBlock.size);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include "RadixSort.h"
+
+#include <cstring>
+
+namespace Render
+{
+	const std::vector<uint32_t>& RadixSort::sort()
+	{
+		size_t count = keys.size();
+		if (count < 2) return values;
+
+		for (auto& histogram : histograms) histogram.fill(0);
+		for (uint64_t key : keys) {
+			for (uint32_t pass = 0; pass < 8; pass++) {
+				histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+			}
+		}
+
+		scratchKeys.resize(count);
+		scratchValues.resize(count);
+
+		for (uint32_t pass = 0; pass < 8; pass++) {
+			auto& histogram = histograms[pass];
+			uint32_t shift = pass * 8;
+
+			// Every key has the same digit, the order would not change
+			if (histogram[(keys[0] >> shift) & 0xFF] == count) continue;
+
+			uint32_t offset = 0;
+			for (auto& bucket : histogram) {
+				uint32_t size = bucket;
+				bucket = offset;
+				offset += size;
+			}
+
+			for (size_t i = 0; i < count; i++) {
+				uint32_t destination = histogram[(keys[i] >> shift) & 0xFF]++;
+				scratchKeys[destination] = keys[i];
+				scratchValues[destination] = values[i];
+			}
+
+			keys.swap(scratchKeys);
+			values.swap(scratchValues);
+		}
+
+		return values;
+	}
+
+	uint32_t RadixSort::floatKey(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+
+		// Negatives flip entirely so larger magnitudes come first, positives only move above them
+		return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+	}
+}
@@ -32,6 +32,10 @@ namespace Render {
 				reservation.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 				reservation.types = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 			}
+			else if (info[i].type == UNIFORM_BUFFER_DYNAMIC) {
+				reservation.stage = VK_SHADER_STAGE_VERTEX_BIT;
+				reservation.types = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+			}
 
 			sets.push_back(reservation);
 		}
@@ -63,15 +67,20 @@ namespace Render {
 		m_renderDevice.init(deviceConfig);
 		
 		m_renderSwapchain.init(m_renderDevice.getUUID(), { window->getUUID() });
-		m_renderPass.init(m_renderDevice.getUUID(), {m_renderSwapchain.getImageFormats()});
+		m_renderPass.init(m_renderDevice.getUUID(), {m_renderSwapchain.getImageFormats(), m_config.depthPrepass});
+
+		if (!m_renderPass.isDynamic()) {
+			m_renderSwapchain.generateFramebuffers(m_renderPass.getRenderPass(), m_renderPass.getDepthRenderPass());
+		}
 
-		m_renderSwapchain.generateFramebuffers(m_renderPass.getRenderPass());
+		m_renderGraph.init(m_renderDevice.getUUID());
+		buildRenderGraph();
 
 		m_window = window;
 
 		for (auto it = m_layouts.begin(); it != m_layouts.end(); ++it) {
 			if (auto lyt = it->second.lock()) {
-				lyt->Init({m_renderDevice.getUUID(), m_window.lock()->getUUID(), m_renderSwapchain.getUUID(), m_renderPass.getUUID()});
+				lyt->Init({m_renderDevice.getUUID(), m_window.lock()->getUUID(), m_renderSwapchain.getUUID(), m_renderPass.getUUID(), m_config.depthPrepass});
 			}
 			else {
 				m_layouts.erase(it);
@@ -85,6 +94,109 @@ namespace Render {
 		m_layouts.insert({layout->getPriority(), layout});
 	}
 
+	void RenderContext::AddGraphSetup(RenderGraphSetup setup)
+	{
+		m_graphSetups.push_back(setup);
+		if (m_renderGraph.isActive()) {
+			WaitIdle();
+			buildRenderGraph();
+		}
+	}
+
+	void RenderContext::buildRenderGraph()
+	{
+		m_renderGraph.reset();
+
+		auto& formats = m_renderSwapchain.getImageFormats();
+		m_graphTargets = {};
+		// The submit waits for the acquired image at color output, the first barrier has to start there
+		m_graphTargets.backbuffer = m_renderGraph.importImage("Backbuffer", formats[0],
+			{ VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE });
+		m_graphTargets.color = m_renderGraph.importImage("Color", formats[0]);
+		m_graphTargets.depth = m_renderGraph.importImage("Depth", formats[1]);
+		m_renderGraph.setOutput(m_graphTargets.backbuffer, USAGE_PRESENT);
+
+		// Culling dispatches and pipeline swaps, the buffers they write are not graph resources
+		m_renderGraph.addPass("Prepare", [this](DrawInfo& drawInfo) {
+			for (auto it = m_layouts.begin(); it != m_layouts.end(); ++it) {
+				if (auto lyt = it->second.lock()) {
+					lyt->Prepare(drawInfo);
+				}
+			}
+		}, true);
+
+		if (m_config.depthPrepass) {
+			// Opaque depth first, the main pass then shades each pixel once with EQUAL
+			uint32_t prepass = m_renderGraph.addPass("Depth Prepass", [this](DrawInfo& drawInfo) {
+				uint32_t frame = m_renderDevice.getCurrentFrame();
+				m_occlusionQueries.reset(drawInfo, frame);
+
+				m_renderDevice.startDepthPrepass(drawInfo);
+
+				uint32_t slot = 0;
+				for (auto it = m_layouts.begin(); it != m_layouts.end(); ++it, slot++) {
+					auto lyt = it->second.lock();
+					if (lyt && lyt->hasDepthPrepass()) {
+						m_occlusionQueries.begin(drawInfo, frame, slot, OcclusionQueries::PASS_PREPASS);
+						lyt->DrawDepth(drawInfo);
+						m_occlusionQueries.end(drawInfo, frame, slot, OcclusionQueries::PASS_PREPASS);
+					}
+				}
+
+				m_renderDevice.endSwapChainRenderPass(drawInfo);
+				drawInfo.depthPrepass = true;
+			});
+			m_renderGraph.write(prepass, m_graphTargets.depth, USAGE_DEPTH_ATTACHMENT);
+		}
+
+		for (auto& setup : m_graphSetups) {
+			setup(m_renderGraph, m_graphTargets);
+		}
+
+		uint32_t mainPass = m_renderGraph.addPass("Main", [this](DrawInfo& drawInfo) {
+			m_renderDevice.startSwapChainRenderPass(drawInfo);
+
+			uint32_t slot = 0;
+			for (auto it = m_layouts.begin(); it != m_layouts.end(); ++it, slot++) {
+				if (auto lyt = it->second.lock()) {
+					// Only around the sub-buffers drawn with EQUAL, blended ones were never in the pre-pass count
+					bool measured = drawInfo.depthPrepass && lyt->hasDepthPrepass();
+					lyt->Draw(drawInfo, measured ? &m_occlusionQueries : nullptr, slot);
+				}
+				else {
+					m_layouts.erase(it);
+				}
+			}
+
+			m_renderDevice.endSwapChainRenderPass(drawInfo);
+		});
+		// Dynamic rendering without MSAA draws straight into the backbuffer
+		if (!m_renderPass.isDynamic() || m_config.msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+			m_renderGraph.write(mainPass, m_graphTargets.color, USAGE_COLOR_ATTACHMENT);
+		}
+		if (m_config.depthPrepass) {
+			// Keeps the pre-pass alive, transparent layouts still write depth in the main pass
+			m_renderGraph.read(mainPass, m_graphTargets.depth, USAGE_DEPTH_READ);
+		}
+		m_renderGraph.write(mainPass, m_graphTargets.depth, USAGE_DEPTH_ATTACHMENT);
+		m_renderGraph.write(mainPass, m_graphTargets.backbuffer, USAGE_COLOR_ATTACHMENT);
+		for (auto resource : m_graphTargets.mainReads) {
+			m_renderGraph.read(mainPass, resource, USAGE_SAMPLED);
+		}
+
+		compileRenderGraph();
+	}
+
+	void RenderContext::compileRenderGraph()
+	{
+		m_renderGraph.compile(m_renderSwapchain.getExtent());
+
+		auto& color = m_renderSwapchain.getColorBuffer();
+		auto& depth = m_renderSwapchain.getDepthBuffer();
+		m_renderGraph.setImportedImage(m_graphTargets.color, color.getImage(), color.getImageView());
+		m_renderGraph.setImportedImage(m_graphTargets.depth, depth.getImage(), depth.getImageView());
+	}
+
 	void RenderContext::Ready()
 	{
 		for (auto it = m_layouts.begin(); it != m_layouts.end(); ++it) {
@@ -96,6 +208,15 @@ namespace Render {
 			}
 		}
 
+		// Every layout queued its pipeline at Init, they compiled side by side
+		m_renderDevice.getPipelineCache().finish();
+
+		if (m_config.depthPrepass) {
+			// One slot per layout, a frame in flight may still be using the old pool
+			if (m_occlusionQueries.isActive()) WaitIdle();
+			m_occlusionQueries.init(m_renderDevice.getUUID(), static_cast<uint32_t>(m_layouts.size()));
+		}
+
 		m_state.isInitialized = true;
 	}
 
@@ -112,7 +233,10 @@ namespace Render {
 		WaitIdle();
 
 		m_renderSwapchain.constructSwapChain();
-		m_renderSwapchain.generateFramebuffers(m_renderPass.getRenderPass());
+		if (!m_renderPass.isDynamic()) {
+			m_renderSwapchain.generateFramebuffers(m_renderPass.getRenderPass(), m_renderPass.getDepthRenderPass());
+		}
+		compileRenderGraph();
 	}
 
 	void RenderContext::checkSwapChainRecreation() 
@@ -148,18 +272,10 @@ namespace Render {
 		m_renderDevice.beginFrame(drawInfo);
 		if (m_renderSwapchain.shouldRecreate()) return;
 
-		m_renderDevice.startSwapChainRenderPass(drawInfo);
-
-		for (auto it = m_layouts.begin(); it != m_layouts.end(); ++it) {
-			if (auto lyt = it->second.lock()) {
-				lyt->Draw(drawInfo);
-			}
-			else {
-				m_layouts.erase(it);
-			}
-		}
+		auto& backbuffer = m_renderSwapchain.getImageBuffer();
+		m_renderGraph.setImportedImage(m_graphTargets.backbuffer, backbuffer.getImage(), backbuffer.getImageView());
 
-		m_renderDevice.endSwapChainRenderPass(drawInfo);
+		m_renderGraph.execute(drawInfo);
 		m_renderDevice.endFrame(drawInfo);
 	}
 
@@ -168,6 +284,8 @@ namespace Render {
 		m_state.isInitialized = false;
 		m_renderDevice.waitIdle();
 		
+		m_renderGraph.destroy();
+		m_occlusionQueries.destroy();
 		m_renderSwapchain.destroy();
 		m_renderPass.destroy();
 
@@ -0,0 +1,620 @@
+#include "RenderGraph.h"
+
+#include "Device.h"
+
+#include <algorithm>
+#include <map>
+
+#define WRITE_ACCESS (VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | \
+	VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT)
+
+#define ATTACHMENT_USAGE (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT)
+
+namespace Render
+{
+	namespace
+	{
+		VkImageAspectFlags aspectOf(VkFormat format)
+		{
+			switch (format) {
+				case VK_FORMAT_D16_UNORM:
+				case VK_FORMAT_X8_D24_UNORM_PACK32:
+				case VK_FORMAT_D32_SFLOAT:
+					return VK_IMAGE_ASPECT_DEPTH_BIT;
+				case VK_FORMAT_S8_UINT:
+					return VK_IMAGE_ASPECT_STENCIL_BIT;
+				case VK_FORMAT_D16_UNORM_S8_UINT:
+				case VK_FORMAT_D24_UNORM_S8_UINT:
+				case VK_FORMAT_D32_SFLOAT_S8_UINT:
+					return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+				default:
+					return VK_IMAGE_ASPECT_COLOR_BIT;
+			}
+		}
+
+		VkImageUsageFlags imageUsageOf(RenderUsage usage)
+		{
+			switch (usage) {
+				case USAGE_COLOR_ATTACHMENT: return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+				case USAGE_DEPTH_ATTACHMENT:
+				case USAGE_DEPTH_READ: return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+				case USAGE_SAMPLED: return VK_IMAGE_USAGE_SAMPLED_BIT;
+				case USAGE_STORAGE: return VK_IMAGE_USAGE_STORAGE_BIT;
+				case USAGE_TRANSFER_SRC: return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+				case USAGE_TRANSFER_DST: return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+				default: return 0;
+			}
+		}
+	}
+
+	RenderResourceState RenderResourceState::ofUsage(RenderUsage usage)
+	{
+		switch (usage) {
+			case USAGE_COLOR_ATTACHMENT:
+				return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+					VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT };
+			case USAGE_DEPTH_ATTACHMENT:
+				return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+					VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+			case USAGE_DEPTH_READ:
+				return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+					VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT };
+			case USAGE_SAMPLED:
+				return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+					VK_ACCESS_2_SHADER_READ_BIT };
+			case USAGE_STORAGE:
+				return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+					VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT };
+			case USAGE_TRANSFER_SRC:
+				return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT };
+			case USAGE_TRANSFER_DST:
+				return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT };
+			case USAGE_PRESENT:
+			default:
+				// The present semaphore takes it from here
+				return { VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE };
+		}
+	}
+
+	bool RenderResourceState::ofLayout(VkImageLayout layout, RenderResourceState& state)
+	{
+		switch (layout) {
+			case VK_IMAGE_LAYOUT_UNDEFINED: state = {}; return true;
+			case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL: state = ofUsage(USAGE_COLOR_ATTACHMENT); return true;
+			case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL: state = ofUsage(USAGE_DEPTH_ATTACHMENT); return true;
+			case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL: state = ofUsage(USAGE_DEPTH_READ); return true;
+			case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: state = ofUsage(USAGE_SAMPLED); return true;
+			case VK_IMAGE_LAYOUT_GENERAL: state = ofUsage(USAGE_STORAGE); return true;
+			case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: state = ofUsage(USAGE_TRANSFER_SRC); return true;
+			case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: state = ofUsage(USAGE_TRANSFER_DST); return true;
+			case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR: state = ofUsage(USAGE_PRESENT); return true;
+			default: return false;
+		}
+	}
+
+	bool RenderResourceState::isWrite(VkAccessFlags2 access)
+	{
+		return (access & WRITE_ACCESS) != 0;
+	}
+
+	VkPipelineStageFlags RenderResourceState::toLegacyStages(VkPipelineStageFlags2 stages, VkPipelineStageFlags none)
+	{
+		// Every stage the graph uses has the same bit in both APIs
+		return stages == VK_PIPELINE_STAGE_2_NONE ? none : static_cast<VkPipelineStageFlags>(stages);
+	}
+
+	RenderGraph::RenderGraph()
+	{
+	}
+
+	RenderGraph::~RenderGraph()
+	{
+		destroy();
+	}
+
+	void RenderGraph::init(size_t deviceUUID)
+	{
+		device = Request<Device>(deviceUUID, "self");
+		if (device.wait() != Manager::State::YES) {
+			Alert("Device died before it was ready to be used.", FATAL);
+			return;
+		}
+
+		if ((*device).getFeatures().synchronization2) {
+			m_vkCmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2KHR)vkGetDeviceProcAddr((*device).getDevice(), "vkCmdPipelineBarrier2KHR");
+		}
+	}
+
+	void RenderGraph::destroy()
+	{
+		reset();
+		m_vkCmdPipelineBarrier2 = nullptr;
+	}
+
+	void RenderGraph::reset()
+	{
+		if (device) {
+			destroyImages();
+		}
+		resources.clear();
+		passes.clear();
+		order.clear();
+		compiled = false;
+	}
+
+	RenderResource RenderGraph::createImage(const std::string& name, const RenderImageDesc& desc)
+	{
+		Resource resource{};
+		resource.name = name;
+		resource.desc = desc;
+		resource.aspect = aspectOf(desc.format);
+
+		resources.push_back(resource);
+		compiled = false;
+		return static_cast<RenderResource>(resources.size() - 1);
+	}
+
+	RenderResource RenderGraph::importImage(const std::string& name, VkFormat format, RenderResourceState initial)
+	{
+		Resource resource{};
+		resource.name = name;
+		resource.desc.format = format;
+		resource.aspect = aspectOf(format);
+		resource.imported = true;
+		resource.initial = initial;
+		resource.state = initial;
+
+		resources.push_back(resource);
+		compiled = false;
+		return static_cast<RenderResource>(resources.size() - 1);
+	}
+
+	void RenderGraph::setImportedImage(RenderResource resource, VkImage image, VkImageView view)
+	{
+		if (resource >= resources.size() || !resources[resource].imported) {
+			Alert("Only imported render graph images can be replaced.", CRITICAL);
+			return;
+		}
+
+		auto& imported = resources[resource];
+		imported.image = image;
+		imported.view = view;
+		imported.state = imported.initial;
+	}
+
+	void RenderGraph::setOutput(RenderResource resource, RenderUsage usage)
+	{
+		if (resource >= resources.size()) {
+			Alert("Unknown render graph resource marked as output.", CRITICAL);
+			return;
+		}
+
+		resources[resource].isOutput = true;
+		resources[resource].output = usage;
+		compiled = false;
+	}
+
+	uint32_t RenderGraph::addPass(const std::string& name, std::function<void(DrawInfo&)> execute, bool sideEffects)
+	{
+		Pass pass{};
+		pass.name = name;
+		pass.execute = execute;
+		pass.sideEffects = sideEffects;
+
+		passes.push_back(pass);
+		compiled = false;
+		return static_cast<uint32_t>(passes.size() - 1);
+	}
+
+	void RenderGraph::read(uint32_t pass, RenderResource resource, RenderUsage usage)
+	{
+		if (pass >= passes.size() || resource >= resources.size()) {
+			Alert("Render graph read declared on an unknown pass or resource.", CRITICAL);
+			return;
+		}
+
+		passes[pass].accesses.push_back({ resource, usage, false });
+		compiled = false;
+	}
+
+	void RenderGraph::write(uint32_t pass, RenderResource resource, RenderUsage usage)
+	{
+		if (pass >= passes.size() || resource >= resources.size()) {
+			Alert("Render graph write declared on an unknown pass or resource.", CRITICAL);
+			return;
+		}
+
+		passes[pass].accesses.push_back({ resource, usage, true });
+		compiled = false;
+	}
+
+	bool RenderGraph::compile(VkExtent2D extent)
+	{
+		if (!isActive()) return false;
+
+		destroyImages();
+		cull();
+
+		for (auto& resource : resources) {
+			resource.firstPass = UINT32_MAX;
+			resource.lastPass = 0;
+			resource.usage = 0;
+		}
+
+		for (uint32_t position = 0; position < order.size(); position++) {
+			for (auto& access : passes[order[position]].accesses) {
+				auto& resource = resources[access.resource];
+				resource.firstPass = std::min(resource.firstPass, position);
+				resource.lastPass = std::max(resource.lastPass, position);
+				resource.usage |= imageUsageOf(access.usage);
+			}
+		}
+
+		compiled = allocate(extent);
+		if (!compiled) return false;
+
+		uint32_t transient = 0;
+		for (auto& resource : resources) {
+			if (!resource.imported && resource.image != VK_NULL_HANDLE) transient++;
+		}
+
+		Alert("Render graph: " + std::to_string(order.size()) + " of " + std::to_string(passes.size()) + " passes, " +
+			std::to_string(transient) + " transient images in " + std::to_string(blocks.size()) + " memory blocks (" +
+			std::to_string(getTransientMemory() / 1024) + " KB)", INFO);
+		return true;
+	}
+
+	void RenderGraph::cull()
+	{
+		std::vector<uint32_t> needed;
+		for (uint32_t i = 0; i < passes.size(); i++) {
+			auto& pass = passes[i];
+			pass.culled = true;
+
+			bool writesOutput = false;
+			for (auto& access : pass.accesses) {
+				if (access.write && resources[access.resource].isOutput) writesOutput = true;
+			}
+
+			if (pass.sideEffects || writesOutput) {
+				pass.culled = false;
+				needed.push_back(i);
+			}
+		}
+
+		// Every earlier writer of something a needed pass reads is needed too
+		while (!needed.empty()) {
+			uint32_t index = needed.back();
+			needed.pop_back();
+
+			for (auto& access : passes[index].accesses) {
+				if (access.write) continue;
+
+				for (uint32_t writer = 0; writer < index; writer++) {
+					if (!passes[writer].culled) continue;
+
+					for (auto& written : passes[writer].accesses) {
+						if (written.write && written.resource == access.resource) {
+							passes[writer].culled = false;
+							needed.push_back(writer);
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		order.clear();
+		for (uint32_t i = 0; i < passes.size(); i++) {
+			if (!passes[i].culled) order.push_back(i);
+		}
+	}
+
+	bool RenderGraph::allocate(VkExtent2D extent)
+	{
+		auto vkDevice = (*device).getDevice();
+
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties((*device).getPhysicalDevice(), &memProperties);
+
+		auto findType = [&memProperties](uint32_t typeBits, VkMemoryPropertyFlags properties) {
+			for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+				if ((typeBits & (1u << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) return i;
+			}
+			return UINT32_MAX;
+		};
+
+		// Placed in order of first use, so a block's latest resource is the one the next must not overlap
+		std::vector<RenderResource> transients;
+		for (RenderResource i = 0; i < resources.size(); i++) {
+			if (!resources[i].imported && resources[i].firstPass != UINT32_MAX) transients.push_back(i);
+		}
+		std::sort(transients.begin(), transients.end(), [this](RenderResource a, RenderResource b) {
+			return resources[a].firstPass < resources[b].firstPass;
+		});
+
+		// Every resource is bound at the start of its block
+		for (auto id : transients) {
+			auto& resource = resources[id];
+
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.extent.width = resource.desc.extent.width ? resource.desc.extent.width : extent.width;
+			imageInfo.extent.height = resource.desc.extent.height ? resource.desc.extent.height : extent.height;
+			imageInfo.extent.depth = 1;
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.format = resource.desc.format;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageInfo.usage = resource.usage | resource.desc.usage;
+			imageInfo.samples = resource.desc.samples;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			// Never leaves tile memory on devices that can back it lazily
+			bool attachmentOnly = (imageInfo.usage & ~ATTACHMENT_USAGE) == 0;
+			if (attachmentOnly) imageInfo.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+			if (vkCreateImage(vkDevice, &imageInfo, nullptr, &resource.image) != VK_SUCCESS) {
+				Alert("Failed to create render graph image " + resource.name + "!", CRITICAL);
+				return false;
+			}
+
+			VkMemoryRequirements requirements;
+			vkGetImageMemoryRequirements(vkDevice, resource.image, &requirements);
+
+			uint32_t lazyType = attachmentOnly ? findType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) : UINT32_MAX;
+			if (lazyType != UINT32_MAX) {
+				MemoryBlock block{};
+				block.size = requirements.size;
+				block.memoryType = lazyType;
+				block.lazy = true;
+				block.lastPass = resource.lastPass;
+
+				resource.block = static_cast<uint32_t>(blocks.size());
+				blocks.push_back(block);
+				continue;
+			}
+
+			uint32_t memoryType = findType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			if (memoryType == UINT32_MAX) {
+				Alert("No device local memory for render graph image " + resource.name + "!", CRITICAL);
+				return false;
+			}
+
+			// Smallest free block that already fits, otherwise the largest free one grows
+			uint32_t chosen = UINT32_MAX;
+			for (uint32_t i = 0; i < blocks.size(); i++) {
+				auto& block = blocks[i];
+				if (block.lazy || block.memoryType != memoryType || block.lastPass >= resource.firstPass) continue;
+				if (chosen == UINT32_MAX) {
+					chosen = i;
+					continue;
+				}
+
+				auto& best = blocks[chosen];
+				bool fits = block.size >= requirements.size;
+				bool bestFits = best.size >= requirements.size;
+				if ((fits && (!bestFits || block.size < best.size)) || (!fits && !bestFits && block.size > best.size)) chosen = i;
+			}
+
+			if (chosen == UINT32_MAX) {
+				MemoryBlock block{};
+				block.memoryType = memoryType;
+				chosen = static_cast<uint32_t>(blocks.size());
+				blocks.push_back(block);
+			}
+
+			auto& block = blocks[chosen];
+			block.size = std::max(block.size, requirements.size);
+			block.lastPass = resource.lastPass;
+			resource.block = chosen;
+		}
+
+		for (auto& block : blocks) {
+			VkMemoryAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = block.size;
+			allocInfo.memoryTypeIndex = block.memoryType;
+
+			if (vkAllocateMemory(vkDevice, &allocInfo, nullptr, &block.memory) != VK_SUCCESS) {
+				Alert("Failed to allocate render graph memory!", CRITICAL);
+				return false;
+			}
+		}
+
+		for (auto id : transients) {
+			auto& resource = resources[id];
+			vkBindImageMemory(vkDevice, resource.image, blocks[resource.block].memory, 0);
+
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = resource.image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = resource.desc.format;
+			viewInfo.subresourceRange.aspectMask = (resource.aspect & VK_IMAGE_ASPECT_DEPTH_BIT) ? VK_IMAGE_ASPECT_DEPTH_BIT : resource.aspect; // Sampled as depth
+			viewInfo.subresourceRange.baseMipLevel = 0;
+			viewInfo.subresourceRange.levelCount = 1;
+			viewInfo.subresourceRange.baseArrayLayer = 0;
+			viewInfo.subresourceRange.layerCount = 1;
+
+			if (vkCreateImageView(vkDevice, &viewInfo, nullptr, &resource.view) != VK_SUCCESS) {
+				Alert("Failed to create render graph image view " + resource.name + "!", CRITICAL);
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void RenderGraph::destroyImages()
+	{
+		auto vkDevice = (*device).getDevice();
+
+		for (auto& resource : resources) {
+			if (resource.imported) continue;
+
+			if (resource.view != VK_NULL_HANDLE) vkDestroyImageView(vkDevice, resource.view, nullptr);
+			if (resource.image != VK_NULL_HANDLE) vkDestroyImage(vkDevice, resource.image, nullptr);
+			resource.view = VK_NULL_HANDLE;
+			resource.image = VK_NULL_HANDLE;
+			resource.block = UINT32_MAX;
+		}
+
+		for (auto& block : blocks) {
+			if (block.memory != VK_NULL_HANDLE) vkFreeMemory(vkDevice, block.memory, nullptr);
+		}
+		blocks.clear();
+
+		compiled = false;
+	}
+
+	VkDeviceSize RenderGraph::getTransientMemory()
+	{
+		VkDeviceSize total = 0;
+		for (auto& block : blocks) {
+			if (!block.lazy) total += block.size;
+		}
+		return total;
+	}
+
+	void RenderGraph::execute(DrawInfo& info)
+	{
+		if (!compiled) {
+			Alert("Render graph executed before it was compiled.", CRITICAL);
+			return;
+		}
+
+		std::vector<bool> touched(resources.size(), false);
+		std::vector<VkImageMemoryBarrier2> barriers;
+
+		for (auto index : order) {
+			auto& pass = passes[index];
+
+			// One state per image, a write's layout wins when the pass also reads it
+			std::map<RenderResource, RenderResourceState> wanted;
+			for (auto& access : pass.accesses) {
+				auto state = RenderResourceState::ofUsage(access.usage);
+				auto it = wanted.find(access.resource);
+				if (it == wanted.end()) {
+					wanted[access.resource] = state;
+					continue;
+				}
+
+				if (access.write) it->second.layout = state.layout;
+				it->second.stages |= state.stages;
+				it->second.access |= state.access;
+			}
+
+			barriers.clear();
+			for (auto& image : wanted) {
+				VkImageMemoryBarrier2 barrier{};
+				if (transition(image.first, image.second, touched, barrier)) barriers.push_back(barrier);
+			}
+			recordBarriers(info.currentCommandBuffer, barriers);
+
+			pass.execute(info);
+		}
+
+		barriers.clear();
+		for (RenderResource i = 0; i < resources.size(); i++) {
+			if (!resources[i].isOutput || resources[i].image == VK_NULL_HANDLE) continue;
+
+			VkImageMemoryBarrier2 barrier{};
+			if (transition(i, RenderResourceState::ofUsage(resources[i].output), touched, barrier)) barriers.push_back(barrier);
+		}
+		recordBarriers(info.currentCommandBuffer, barriers);
+	}
+
+	bool RenderGraph::transition(RenderResource id, const RenderResourceState& wanted, std::vector<bool>& touched, VkImageMemoryBarrier2& barrier)
+	{
+		auto& resource = resources[id];
+		if (resource.image == VK_NULL_HANDLE) return false; // Imported and never set
+
+		// Transients start every frame undefined, after whatever last used their memory
+		auto current = resource.state;
+		if (!resource.imported) {
+			current = blocks[resource.block].state;
+			if (!touched[id]) current.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		}
+		touched[id] = true;
+
+		auto store = [this, &resource](const RenderResourceState& state) {
+			resource.state = state;
+			if (!resource.imported) blocks[resource.block].state = state;
+		};
+
+		// Reads after reads in the same layout only widen the stages a later write waits on
+		if (current.layout == wanted.layout && !RenderResourceState::isWrite(current.access) && !RenderResourceState::isWrite(wanted.access)) {
+			current.stages |= wanted.stages;
+			current.access |= wanted.access;
+			store(current);
+			return false;
+		}
+
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+		barrier.srcStageMask = current.stages;
+		barrier.srcAccessMask = current.access & WRITE_ACCESS; // Reads have nothing to make available
+		barrier.dstStageMask = wanted.stages;
+		barrier.dstAccessMask = wanted.access;
+		barrier.oldLayout = current.layout;
+		barrier.newLayout = wanted.layout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = resource.image;
+		barrier.subresourceRange.aspectMask = resource.aspect;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+		store(wanted);
+		return true;
+	}
+
+	void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const std::vector<VkImageMemoryBarrier2>& barriers)
+	{
+		if (barriers.empty()) return;
+
+		if (m_vkCmdPipelineBarrier2) {
+			VkDependencyInfo dependency{};
+			dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+			dependency.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size());
+			dependency.pImageMemoryBarriers = barriers.data();
+
+			m_vkCmdPipelineBarrier2(commandBuffer, &dependency);
+			return;
+		}
+
+		// Synchronization 1 has one stage mask per call, the union of every barrier's
+		VkPipelineStageFlags2 srcStages = VK_PIPELINE_STAGE_2_NONE;
+		VkPipelineStageFlags2 dstStages = VK_PIPELINE_STAGE_2_NONE;
+		std::vector<VkImageMemoryBarrier> legacy(barriers.size());
+		for (size_t i = 0; i < barriers.size(); i++) {
+			auto& barrier = barriers[i];
+			srcStages |= barrier.srcStageMask;
+			dstStages |= barrier.dstStageMask;
+
+			legacy[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			legacy[i].srcAccessMask = static_cast<VkAccessFlags>(barrier.srcAccessMask);
+			legacy[i].dstAccessMask = static_cast<VkAccessFlags>(barrier.dstAccessMask);
+			legacy[i].oldLayout = barrier.oldLayout;
+			legacy[i].newLayout = barrier.newLayout;
+			legacy[i].srcQueueFamilyIndex = barrier.srcQueueFamilyIndex;
+			legacy[i].dstQueueFamilyIndex = barrier.dstQueueFamilyIndex;
+			legacy[i].image = barrier.image;
+			legacy[i].subresourceRange = barrier.subresourceRange;
+		}
+
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			RenderResourceState::toLegacyStages(srcStages, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT),
+			RenderResourceState::toLegacyStages(dstStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT),
+			0,
+			0, nullptr,
+			0, nullptr,
+			static_cast<uint32_t>(legacy.size()), legacy.data()
+		);
+	}
+}
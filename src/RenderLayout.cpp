@@ -1,7 +1,32 @@
 #include "RenderLayout.h"
 
+#include <algorithm>
+#include <numeric>
+
 namespace Render
 {
+    namespace
+    {
+        bool sameState(const PipelineState& a, const PipelineState& b)
+        {
+            return !(a < b) && !(b < a);
+        }
+
+        // Depth from the pre-pass is final for these, the main pass only has to match it
+        bool inDepthPrepass(const PipelineState& state)
+        {
+            return state.blend == BLEND_OPAQUE && state.depthTest && state.depthWrite &&
+                (state.depthCompare == VK_COMPARE_OP_LESS || state.depthCompare == VK_COMPARE_OP_LESS_OR_EQUAL);
+        }
+
+        PipelineState afterDepthPrepass(PipelineState state)
+        {
+            state.depthCompare = VK_COMPARE_OP_EQUAL;
+            state.depthWrite = false;
+            return state;
+        }
+    }
+
     RenderLayout::RenderLayout(LayoutConfig config) : config(config)
     {
         
@@ -21,11 +46,52 @@ namespace Render
         }
         this->info = info;
 
-        m_shaders.init(info.deviceUUID, { config.vertexShader, config.fragmentShader });
+        if (config.bindless && !(*device).getBindlessHeap().isActive()) {
+            Alert("Render layout asked for bindless descriptors but the device has no bindless heap.", WARNING);
+            config.bindless = false;
+        }
 
+        ShaderConstructInfo shaderInfo = { config.vertexShader, config.fragmentShader };
         PipelineConstructInfo constructInfo = { info.renderPassUUID, m_shaders.getUUID(), m_pushConstant.getUUID()};
+        constructInfo.bindless = config.bindless;
+        constructInfo.frameSet = config.frameSet;
+        constructInfo.state = config.pipelineState;
+        constructInfo.specialization = config.specializationConstants;
+
+        if (config.meshlets) {
+            bool useMeshShaders = !config.meshShader.empty() && (*device).getFeatures().meshShader;
+            m_meshletCuller.init(info.deviceUUID, { useMeshShaders ? "" : config.meshletCullShader });
+
+            if (useMeshShaders) {
+                shaderInfo.taskShaderPath = config.taskShader;
+                shaderInfo.meshShaderPath = config.meshShader;
+                constructInfo.meshletSetLayout = m_meshletCuller.getDescriptorSetLayout();
+            }
+        }
+
+        m_pushConstant.init({ config.pushConstants, config.drawConstants });
+
+        m_shaders.init(info.deviceUUID, shaderInfo);
 		m_renderPipeline.init(info.deviceUUID, constructInfo);
 
+        m_prepassActive = config.depthPrepass && info.depthPrepass && !config.meshlets;
+        if (config.depthPrepass && info.depthPrepass && config.meshlets) {
+            Alert("Meshlet layouts are not drawn in the depth pre-pass.", WARNING);
+        }
+        if (m_prepassActive) {
+            m_prepassShaders.init(info.deviceUUID, { config.prepassVertexShader.empty() ? config.vertexShader : config.prepassVertexShader, "" });
+
+            PipelineConstructInfo prepassInfo = constructInfo;
+            prepassInfo.shaderUUID = m_prepassShaders.getUUID();
+            prepassInfo.depthOnly = true;
+            m_prepassPipeline.init(info.deviceUUID, prepassInfo);
+
+            // Compiled with the default variant, so the first frames are not left without a main pass pipeline
+            if (inDepthPrepass(config.pipelineState)) {
+                m_renderPipeline.getVariant(afterDepthPrepass(config.pipelineState));
+            }
+        }
+
 		m_masterBufferData.init(info.deviceUUID);
     }
 
@@ -33,22 +99,32 @@ namespace Render
     {
 		for (auto& descriptorSet : m_descriptorSets) {
 			if (auto ptr = descriptorSet.lock()) {
-				(*device).createDescriptorSets(ptr);
+				if (!config.bindless) (*device).createDescriptorSets(ptr);
 			}
 			else {
 				Alert("One or more Descriptor Sets have expired.", WARNING);
 			}
 		}
 
-		m_masterBufferData.finalize();
+		m_masterBufferData.finalize(config.meshlets);
+
+        if (config.meshlets) {
+            m_meshletCuller.ready(m_masterBufferData);
+        }
     }
 
     void RenderLayout::Destroy()
     {
         m_shaders.destroy();
 		m_renderPipeline.destroy();
+        m_prepassShaders.destroy();
+        m_prepassPipeline.destroy();
+        m_prepassActive = false;
+        m_prepassRecorded = false;
+        m_prepassDrawn.clear();
 
 		m_masterBufferData.destroy();
+        m_meshletCuller.destroy();
 		m_pushConstant.destroy();
 
 		for (auto& descriptorSet : m_descriptorSets) {
@@ -60,6 +136,12 @@ namespace Render
 			}
 		}
 
+		for (auto& uniform : m_uniforms) {
+			if (auto ptr = uniform.lock()) {
+				ptr->destroy();
+			}
+		}
+
 		if (auto canvas = m_cnvs.lock()) {
 			canvas->destroy();
 		}
@@ -76,6 +158,20 @@ namespace Render
         m_masterBufferData.loadData(*buffer);
     }
 
+    void RenderLayout::Load(std::shared_ptr<Uniform>& uniform)
+    {
+        uniform->init(info.deviceUUID);
+        if (!uniform->isInRing()) {
+            Alert("Sub-buffer uniforms need a UNIFORM_BUFFER_DYNAMIC reservation, the descriptor set's own uniform is used instead.", WARNING);
+        }
+        m_uniforms.push_back(uniform);
+    }
+
+    void RenderLayout::LoadMeshFile(const std::string& path)
+    {
+        m_masterBufferData.loadFile(path);
+    }
+
 	void RenderLayout::Load(std::shared_ptr<Canvas>& canvas)
     {
         CanvasConstructInfo constructInfo{
@@ -88,25 +184,222 @@ namespace Render
 		m_cnvs = canvas;
     }
 
-    void RenderLayout::Draw(DrawInfo& drawInfo)
+    void RenderLayout::Prepare(DrawInfo& drawInfo)
     {
-        // Start Record
-		m_renderPipeline.record(drawInfo);
-
-		m_pushConstant.record(drawInfo, m_renderPipeline.getPipelineLayout());
+        // Before anything is recorded, so the whole frame uses one pipeline
+        if (m_shaders.reload()) {
+            m_renderPipeline.reload(m_shaders);
+        }
+        if (m_renderPipeline.swap()) {
+            m_shaders.releaseRetired();
+        }
+        if (m_prepassActive) {
+            if (m_prepassShaders.reload()) {
+                m_prepassPipeline.reload(m_prepassShaders);
+            }
+            if (m_prepassPipeline.swap()) {
+                m_prepassShaders.releaseRetired();
+            }
+        }
 
-		auto numSubBuffers = m_masterBufferData.bind(drawInfo);
+        if (config.meshlets) {
+            m_meshletCuller.record(drawInfo, (*device).getCurrentFrame());
+        }
+    }
 
-		for (int i = 0; i < numSubBuffers; i++) {
-			if (auto descriptor = m_descriptorSets[i].lock()) {
-				descriptor->record(drawInfo, m_renderPipeline.getPipelineLayout(), (*device).getCurrentFrame());
+    void RenderLayout::Draw(DrawInfo& drawInfo, OcclusionQueries* queries, uint32_t querySlot)
+    {
+        // Start Record
+		if (!m_renderPipeline.record(drawInfo)) {
+			// Pipeline still compiling, skip this layout for the frame instead of stalling on it
+			if (auto canvas = m_cnvs.lock()) {
+				canvas->record(drawInfo);
 			}
-			m_masterBufferData.recordSubBuffer(drawInfo, i);
+            m_prepassRecorded = false;
+            m_prepassDrawn.clear();
+			return;
 		}
 
+        recordSubBuffers(drawInfo, m_renderPipeline, false, queries, querySlot);
+        m_prepassRecorded = false;
+        m_prepassDrawn.clear();
+
 		if (auto canvas = m_cnvs.lock()) {
 			canvas->record(drawInfo);
 		}
 		// End Record
     }
+
+    void RenderLayout::DrawDepth(DrawInfo& drawInfo)
+    {
+        m_prepassRecorded = false;
+        m_prepassDrawn.clear();
+        if (!m_prepassActive || !m_prepassPipeline.record(drawInfo)) return;
+
+        recordSubBuffers(drawInfo, m_prepassPipeline, true);
+        m_prepassRecorded = true;
+    }
+
+    void RenderLayout::recordSubBuffers(DrawInfo& drawInfo, Pipeline& pipeline, bool depthPrepass, OcclusionQueries* queries, uint32_t querySlot)
+    {
+		m_pushConstant.record(drawInfo, pipeline.getPipelineLayout());
+
+		if (config.frameSet) {
+			(*device).getFrameGlobals().record(drawInfo, pipeline.getPipelineLayout(), (*device).getCurrentFrame());
+		}
+
+		auto numSubBuffers = m_masterBufferData.bind(drawInfo);
+        bool culled = config.meshlets && m_meshletCuller.isActive();
+
+        if (culled && pipeline.isMeshPipeline()) {
+            m_meshletCuller.bind(drawInfo, pipeline.getPipelineLayout(), (*device).getCurrentFrame(), pipeline.getMeshletSet());
+        }
+
+        // Resources are updated and sub-buffers sorted once a frame, before the first pass that uses them
+        bool update = depthPrepass || !m_prepassRecorded;
+        if (update) sortSubBuffers(numSubBuffers);
+
+		if (config.bindless) {
+			// One bind for every sub-buffer, shaders index the heap themselves
+            if (update) {
+			    for (auto& descriptorSet : m_descriptorSets) {
+				    if (auto ptr = descriptorSet.lock()) {
+					    ptr->updateResources((*device).getCurrentFrame());
+				    }
+			    }
+            }
+			(*device).getBindlessHeap().record(drawInfo, pipeline.getPipelineLayout(), (*device).getCurrentFrame(), pipeline.getObjectSet());
+		}
+
+		uint32_t frame = (*device).getCurrentFrame();
+        if (update) {
+		    for (auto& uniform : m_uniforms) {
+			    if (auto ptr = uniform.lock()) {
+				    if (ptr->consumeDirty(frame)) ptr->update(frame);
+			    }
+		    }
+        }
+
+		// Sub-buffers past the last descriptor set share it, e.g. meshes remapped into one TextureAtlas.
+		// Sub-buffers with their own uniform rebind the same set with only the first dynamic offset changed
+		DescriptorSet* boundSet = nullptr;
+		std::vector<uint32_t> setOffsets;
+		std::vector<uint32_t> dynamicOffsets;
+		PipelineState recordedState = config.pipelineState;
+        auto recordDraw = [&](uint32_t i, PipelineState state) {
+			// Same layout for every variant, bound sets and push constants stay valid
+			if (!sameState(state, recordedState)) {
+				pipeline.record(drawInfo, state);
+				recordedState = state;
+			}
+
+			if (!config.bindless && !m_descriptorSets.empty()) {
+				auto descriptor = m_descriptorSets[std::min<size_t>(i, m_descriptorSets.size() - 1)].lock();
+				if (descriptor) {
+					bool rebind = descriptor.get() != boundSet;
+					if (rebind) {
+						setOffsets = descriptor->getDynamicOffsets(frame);
+						dynamicOffsets = setOffsets;
+					}
+
+					if (!dynamicOffsets.empty()) {
+						uint32_t offset = setOffsets[0];
+						if (i < m_uniforms.size()) {
+							if (auto uniform = m_uniforms[i].lock()) uniform->getDynamicOffset(frame, offset);
+						}
+						if (offset != dynamicOffsets[0]) {
+							dynamicOffsets[0] = offset;
+							rebind = true;
+						}
+					}
+
+					if (rebind) {
+						descriptor->record(drawInfo, pipeline.getPipelineLayout(), frame, pipeline.getObjectSet(),
+							dynamicOffsets.data(), static_cast<uint32_t>(dynamicOffsets.size()));
+						boundSet = descriptor.get();
+					}
+				}
+			}
+
+            m_pushConstant.recordDraw(drawInfo, pipeline.getPipelineLayout(), i);
+
+            if (!culled) {
+			    m_masterBufferData.recordSubBuffer(drawInfo, i);
+            }
+            else if (pipeline.isMeshPipeline()) {
+                m_meshletCuller.recordMeshTasks(drawInfo, pipeline.getPipelineLayout(), pipeline.getMeshletPushConstantOffset(), i);
+            }
+            else {
+                m_meshletCuller.recordSubBuffer(drawInfo, (*device).getCurrentFrame(), i);
+            }
+        };
+
+        if (depthPrepass) {
+            m_prepassDrawn.assign(numSubBuffers, false);
+            for (uint32_t i : m_drawOrder) {
+                PipelineState state = drawState(i);
+
+                // Both pipelines must be compiled, a sub-buffer only in one pass would vanish or be shaded twice
+                bool drawn = inDepthPrepass(state) && m_prepassPipeline.getVariant(state) != VK_NULL_HANDLE &&
+                    m_renderPipeline.getVariant(afterDepthPrepass(state)) != VK_NULL_HANDLE;
+                m_prepassDrawn[i] = drawn;
+                if (drawn) recordDraw(i, state);
+            }
+            return;
+        }
+
+        // Sub-buffers the pre-pass drew go first and alone inside the query, so the main pass count covers
+        // exactly the fragments the pre-pass counted. Everything else, blended ones included, follows in draw order
+        bool measured = queries != nullptr && std::find(m_prepassDrawn.begin(), m_prepassDrawn.end(), true) != m_prepassDrawn.end();
+        if (measured) queries->begin(drawInfo, frame, querySlot, OcclusionQueries::PASS_MAIN);
+        for (uint32_t i : m_drawOrder) {
+            if (i < m_prepassDrawn.size() && m_prepassDrawn[i]) recordDraw(i, afterDepthPrepass(drawState(i)));
+        }
+        if (measured) queries->end(drawInfo, frame, querySlot, OcclusionQueries::PASS_MAIN);
+
+        for (uint32_t i : m_drawOrder) {
+            if (i >= m_prepassDrawn.size() || !m_prepassDrawn[i]) recordDraw(i, drawState(i));
+        }
+    }
+
+    PipelineState RenderLayout::drawState(uint32_t subBuffer)
+    {
+        auto state = m_drawStates.find(subBuffer);
+        return state != m_drawStates.end() ? state->second : config.pipelineState;
+    }
+
+    void RenderLayout::sortSubBuffers(uint32_t numSubBuffers)
+    {
+        m_drawOrder.resize(numSubBuffers);
+        std::iota(m_drawOrder.begin(), m_drawOrder.end(), 0u);
+
+        // The view is only written for layouts with the frame set
+        if (!config.sortDraws || !config.frameSet) return;
+
+        // View space depth looking down -z. Opaque by their nearest point so occluders go first,
+        // blended by their center after every opaque one, farthest first
+        const glm::mat4& view = (*device).getFrameGlobals().getData().view;
+
+        m_drawSort.clear();
+        for (auto& bounds : m_drawBounds) {
+            uint32_t i = bounds.first;
+            const glm::vec4& sphere = bounds.second;
+            if (i >= numSubBuffers) break;
+
+            float depth = -(view * glm::vec4(glm::vec3(sphere), 1.0f)).z;
+
+            uint64_t key = drawState(i).blend == BLEND_OPAQUE ?
+                RadixSort::floatKey(depth - sphere.w) :
+                (1ull << 32) | static_cast<uint32_t>(~RadixSort::floatKey(depth));
+            m_drawSort.push(key, i);
+        }
+
+        // Sorted sub-buffers fill the positions they had in load order, the map walks those ascending
+        const auto& sorted = m_drawSort.sort();
+        size_t next = 0;
+        for (auto& bounds : m_drawBounds) {
+            if (next == sorted.size()) break;
+            m_drawOrder[bounds.first] = sorted[next++];
+        }
+    }
 }
\ No newline at end of file
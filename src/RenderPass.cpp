@@ -16,18 +16,32 @@ namespace Render
         device = Request<Device>(deviceUUID, "self");
         if (device.wait() != Manager::State::YES) {
             Alert("Device died before it was ready to be used.", FATAL);
+            return;
+        }
+
+        formats = info.swapChainImageFormats;
+        if ((*device).getFeatures().dynamicRendering) return;
+
+        renderPass = constructRenderPass(info.swapChainImageFormats, VK_ATTACHMENT_LOAD_OP_CLEAR);
+        if (info.depthPrepass) {
+            depthRenderPass = constructDepthRenderPass(info.swapChainImageFormats[1]);
+            loadDepthRenderPass = constructRenderPass(info.swapChainImageFormats, VK_ATTACHMENT_LOAD_OP_LOAD);
         }
-        constructRenderPass(info.swapChainImageFormats);
     }
 
     void RenderPass::destroy()
     {
-        if (device) {
-            vkDestroyRenderPass((*device).getDevice(), renderPass, nullptr);
+        if (!device) return;
+
+        for (auto pass : { &renderPass, &depthRenderPass, &loadDepthRenderPass }) {
+            if (*pass != VK_NULL_HANDLE) {
+                vkDestroyRenderPass((*device).getDevice(), *pass, nullptr);
+                *pass = VK_NULL_HANDLE;
+            }
         }
     }
 
-    void RenderPass::constructRenderPass(std::array<VkFormat, 2>& swapChainImageFormats)
+    VkRenderPass RenderPass::constructRenderPass(std::array<VkFormat, 2>& swapChainImageFormats, VkAttachmentLoadOp depthLoadOp)
     {
         auto msaaSamples = (*device).getConfig().desiredMSAASamples;
 
@@ -40,7 +54,8 @@ namespace Render
 		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		// Layouts between passes belong to the RenderGraph, the pass keeps what it was given
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 		VkAttachmentReference colorAttachmentRef{};
@@ -50,11 +65,11 @@ namespace Render
 		VkAttachmentDescription depthAttachment{};
 		depthAttachment.format = swapChainImageFormats[1];
 		depthAttachment.samples = msaaSamples;
-		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.loadOp = depthLoadOp;
 		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 		VkAttachmentReference depthAttachmentRef{};
@@ -68,8 +83,8 @@ namespace Render
 		colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 		VkAttachmentReference colorAttachmentResolveRef{};
 		colorAttachmentResolveRef.attachment = 2;
@@ -82,15 +97,6 @@ namespace Render
 		subpass.pDepthStencilAttachment = &depthAttachmentRef;
 		subpass.pResolveAttachments = &colorAttachmentResolveRef;
 
-		VkSubpassDependency dependency{};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-		dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-
 		std::array<VkAttachmentDescription, 3> attachments = { colorAttachment, depthAttachment, colorAttachmentResolve };
 		VkRenderPassCreateInfo renderPassInfo{};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -98,18 +104,56 @@ namespace Render
 		renderPassInfo.pAttachments = attachments.data();
 		renderPassInfo.subpassCount = 1;
 		renderPassInfo.pSubpasses = &subpass;
-		renderPassInfo.dependencyCount = 1;
-		renderPassInfo.pDependencies = &dependency;
+		renderPassInfo.dependencyCount = 0; // The graph's barriers before and after the pass
 
 		if (device.wait() != Manager::State::YES) {
 			Alert("Device died before it was ready to be used.", FATAL);
-			return;
+			return VK_NULL_HANDLE;
 		}
 
-		if (vkCreateRenderPass((*device).getDevice(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+		VkRenderPass pass = VK_NULL_HANDLE;
+		if (vkCreateRenderPass((*device).getDevice(), &renderPassInfo, nullptr, &pass) != VK_SUCCESS) {
 			Alert("Failed to create render pass!", FATAL);
-			return;
+			return VK_NULL_HANDLE;
+		}
+		return pass;
+    }
+
+    VkRenderPass RenderPass::constructDepthRenderPass(VkFormat depthFormat)
+    {
+		VkAttachmentDescription depthAttachment{};
+		depthAttachment.format = depthFormat;
+		depthAttachment.samples = (*device).getConfig().desiredMSAASamples;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // Loaded by the main pass
+		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference depthAttachmentRef{};
+		depthAttachmentRef.attachment = 0;
+		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 0;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = 1;
+		renderPassInfo.pAttachments = &depthAttachment;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = 0;
+
+		VkRenderPass pass = VK_NULL_HANDLE;
+		if (vkCreateRenderPass((*device).getDevice(), &renderPassInfo, nullptr, &pass) != VK_SUCCESS) {
+			Alert("Failed to create depth pre-pass render pass!", FATAL);
+			return VK_NULL_HANDLE;
 		}
+		return pass;
     }
 
 }
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "SamplerCache.h"
+
+#include "Device.h"
+
+#include <algorithm>
+
+namespace Render
+{
+	SamplerCache::SamplerCache()
+	{
+	}
+
+	SamplerCache::~SamplerCache()
+	{
+		destroy();
+	}
+
+	void SamplerCache::init(Device* device)
+	{
+		destroy();
+
+		this->device = device;
+	}
+
+	void SamplerCache::destroy()
+	{
+		if (device) {
+			for (auto& entry : entries) {
+				vkDestroySampler(device->getDevice(), entry.second.sampler, nullptr);
+			}
+		}
+		entries.clear();
+		keys.clear();
+
+		device = nullptr;
+	}
+
+	VkSampler SamplerCache::acquire(const SamplerKey& key)
+	{
+		if (!isActive()) {
+			Alert("Sampler requested before the cache was initialized.", CRITICAL);
+			return VK_NULL_HANDLE;
+		}
+
+		auto it = entries.find(key);
+		if (it != entries.end()) {
+			it->second.references++;
+			return it->second.sampler;
+		}
+
+		auto& limits = device->getProperties().limits;
+		if (entries.size() >= limits.maxSamplerAllocationCount) {
+			Alert("Device sampler limit reached, " + std::to_string(entries.size()) + " distinct samplers.", CRITICAL);
+			return VK_NULL_HANDLE;
+		}
+
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = key.magFilter;
+		samplerInfo.minFilter = key.minFilter;
+
+		samplerInfo.addressModeU = key.addressMode;
+		samplerInfo.addressModeV = key.addressMode;
+		samplerInfo.addressModeW = key.addressMode;
+
+		float anisotropy = key.maxAnisotropy < 0.0f ? limits.maxSamplerAnisotropy : std::min(key.maxAnisotropy, limits.maxSamplerAnisotropy);
+		samplerInfo.anisotropyEnable = anisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+		samplerInfo.maxAnisotropy = std::max(anisotropy, 1.0f);
+
+		samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+		samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+		samplerInfo.compareEnable = VK_FALSE;
+		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+
+		samplerInfo.mipmapMode = key.mipmapMode;
+		samplerInfo.minLod = key.minLod; // "Level of detail"
+		samplerInfo.maxLod = key.maxLod;
+		samplerInfo.mipLodBias = key.mipLodBias;
+
+		VkSampler sampler = VK_NULL_HANDLE;
+		if (vkCreateSampler(device->getDevice(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+			Alert("Failed to create texture sampler!", CRITICAL);
+			return VK_NULL_HANDLE;
+		}
+
+		entries[key] = { sampler, 1 };
+		keys[sampler] = key;
+		return sampler;
+	}
+
+	void SamplerCache::release(VkSampler sampler)
+	{
+		if (!isActive() || sampler == VK_NULL_HANDLE) return;
+
+		auto key = keys.find(sampler);
+		if (key == keys.end()) {
+			Alert("Released a sampler the cache does not own.", WARNING);
+			return;
+		}
+
+		auto& entry = entries[key->second];
+		if (entry.references > 0) entry.references--;
+	}
+
+	void SamplerCache::trim()
+	{
+		if (!isActive()) return;
+
+		for (auto it = entries.begin(); it != entries.end();) {
+			if (it->second.references == 0) {
+				vkDestroySampler(device->getDevice(), it->second.sampler, nullptr);
+				keys.erase(it->second.sampler);
+				it = entries.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+}
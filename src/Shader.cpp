@@ -17,102 +17,164 @@ namespace Render
 
 	void Shader::init(size_t deviceUUID, ShaderConstructInfo info)
 	{
-		vertexShaderPath = info.vertexShaderPath;
-		fragmentShaderPath = info.fragmentShaderPath;
-
 		device = Request<Device>(deviceUUID, "self");
+		if (device.wait() != Manager::State::YES) {
+			Alert("Device died before it was ready to be used.", CRITICAL);
+			return;
+		}
+
+		modules.clear();
+		if (!info.computeShaderPath.empty()) {
+			modules.push_back({ VK_SHADER_STAGE_COMPUTE_BIT, info.computeShaderPath });
+		}
+		else if (!info.meshShaderPath.empty() && (*device).getFeatures().meshShader) {
+			if (!info.taskShaderPath.empty()) {
+				modules.push_back({ VK_SHADER_STAGE_TASK_BIT_EXT, info.taskShaderPath });
+			}
+			modules.push_back({ VK_SHADER_STAGE_MESH_BIT_EXT, info.meshShaderPath });
+			modules.push_back({ VK_SHADER_STAGE_FRAGMENT_BIT, info.fragmentShaderPath });
+		}
+		else {
+			modules.push_back({ VK_SHADER_STAGE_VERTEX_BIT, info.vertexShaderPath });
+			if (!info.fragmentShaderPath.empty()) {
+				modules.push_back({ VK_SHADER_STAGE_FRAGMENT_BIT, info.fragmentShaderPath });
+			}
+		}
+
 		initShader();
 	}
 
 	void Shader::destroy()
 	{
 		if (device) {
-			if (vertShaderModule != VK_NULL_HANDLE) {
-				vkDestroyShaderModule((*device).getDevice(), vertShaderModule, nullptr);
-				vertShaderModule = VK_NULL_HANDLE;
+			auto& shaderCache = (*device).getShaderCache();
+			for (auto& shaderModule : modules) {
+				if (shaderModule.module != VK_NULL_HANDLE) {
+					shaderCache.release(shaderModule.module);
+					shaderModule.module = VK_NULL_HANDLE;
+				}
+			}
+			releaseRetired();
+
+			if (listener >= 0) shaderCache.removeListener(static_cast<uint32_t>(listener));
+		}
+		listener = -1;
+		reloadPending = false;
+	}
+
+	bool Shader::reload()
+	{
+		if (!reloadPending || !device) return false;
+		reloadPending = false;
+
+		auto& shaderCache = (*device).getShaderCache();
+		bool changed = false;
+		for (auto& shaderModule : modules) {
+			VkShaderModule module = shaderCache.acquire(shaderModule.path);
+			if (module == VK_NULL_HANDLE) {
+				// Invalidated rather than reloaded, read it again here
+				bool error = false;
+				auto code = readFile(shaderModule.path, error);
+				if (error) {
+					Alert("Failed to reload shader file: " + shaderModule.path + ", keeping the previous module.", WARNING);
+					continue;
+				}
+				module = shaderCache.insert(shaderModule.path, code);
+				if (module == VK_NULL_HANDLE) continue;
 			}
-			if (fragShaderModule != VK_NULL_HANDLE) {
-				vkDestroyShaderModule((*device).getDevice(), fragShaderModule, nullptr);
-				fragShaderModule = VK_NULL_HANDLE;
+
+			if (module == shaderModule.module) {
+				shaderCache.release(module);
+				continue;
 			}
+
+			retired.push_back(shaderModule.module);
+			shaderModule.module = module;
+			changed = true;
 		}
+
+		if (changed) bindShaderStages();
+		return changed;
 	}
 
-	void Shader::initShader() 
+	void Shader::releaseRetired()
 	{
-		ERROR_VOLATILE(loadVertexShaderFromFile());
-		ERROR_VOLATILE(loadFragmentShaderFromFile());
+		if (!device) return;
 
-		bool error = false;
-		
+		for (auto module : retired) {
+			(*device).getShaderCache().release(module);
+		}
+		retired.clear();
+	}
+
+	bool Shader::hasStage(VkShaderStageFlagBits stage)
+	{
+		for (auto& shaderModule : modules) {
+			if (shaderModule.stage == stage) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void Shader::initShader() 
+	{
 		if (device.wait() != Manager::State::YES) {
 			Alert("Device died before it was ready to be used.", CRITICAL);
 			return;
 		}
 
-		vertShaderModule = createShaderModule(vertexShaderCode, error);
-		if (error) {
-			Alert("Failed to create vertex shader module!", FATAL);
-			return;
+		// Paths already in the cache are not read again
+		auto& shaderCache = (*device).getShaderCache();
+		if (listener < 0) {
+			listener = static_cast<int32_t>(shaderCache.addListener([this](const std::string& path) {
+				for (auto& shaderModule : modules) {
+					if (path.empty() || path == ShaderCache::canonicalPath(shaderModule.path)) {
+						reloadPending = true;
+					}
+				}
+			}));
 		}
 
-		fragShaderModule = createShaderModule(fragmentShaderCode, error);
-		if (error) {
-			Alert("Failed to create vertex shader module!", FATAL);
-			return;
-		}
+		for (auto& shaderModule : modules) {
+			(*device).getShaderWatcher().watch(shaderModule.path);
 
-		ERROR_VOLATILE(bindShaderStages());
-	}
+			shaderModule.module = shaderCache.acquire(shaderModule.path);
+			if (shaderModule.module != VK_NULL_HANDLE) continue;
 
-	VkShaderModule Shader::createShaderModule(const std::vector<char>& code, bool& error) 
-	{
-		VkShaderModuleCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+			ERROR_VOLATILE(loadShaderFromFile(shaderModule));
 
-		VkShaderModule shaderModule;
-		if (vkCreateShaderModule((*device).getDevice(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-			error = true;
-			return {};
+			shaderModule.module = shaderCache.insert(shaderModule.path, shaderModule.code);
+			shaderModule.code.clear();
+			if (shaderModule.module == VK_NULL_HANDLE) {
+				Alert("Failed to create shader module: " + shaderModule.path, FATAL);
+				return;
+			}
 		}
-		error = false;
-		return shaderModule;
-	}
 
-	void Shader::bindShaderStages() 
-	{
-		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertShaderStageInfo.module = vertShaderModule;
-		vertShaderStageInfo.pName = "main";
-
-		VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragShaderStageInfo.module = fragShaderModule;
-		fragShaderStageInfo.pName = "main";
-
-		shaderStages = { vertShaderStageInfo, fragShaderStageInfo };
+		ERROR_VOLATILE(bindShaderStages());
 	}
 
-	void Shader::loadVertexShaderFromFile() 
+	void Shader::bindShaderStages() 
 	{
-		bool error = false;
-		vertexShaderCode = readFile(vertexShaderPath, error);
-		if (error) {
-			Alert("Failed to read vertex shader file: " + vertexShaderPath, FATAL);
+		shaderStages.clear();
+		for (auto& shaderModule : modules) {
+			VkPipelineShaderStageCreateInfo shaderStageInfo{};
+			shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			shaderStageInfo.stage = shaderModule.stage;
+			shaderStageInfo.module = shaderModule.module;
+			shaderStageInfo.pName = "main";
+
+			shaderStages.push_back(shaderStageInfo);
 		}
 	}
 
-	void Shader::loadFragmentShaderFromFile() 
+	void Shader::loadShaderFromFile(ShaderModule& shaderModule) 
 	{
 		bool error = false;
-		fragmentShaderCode = readFile(fragmentShaderPath, error);
+		shaderModule.code = readFile(shaderModule.path, error);
 		if (error) {
-			Alert("Failed to read fragment shader file: " + fragmentShaderPath, FATAL);
+			Alert("Failed to read shader file: " + shaderModule.path, FATAL);
 		}
 	}
 
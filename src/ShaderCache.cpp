@@ -0,0 +1,206 @@
+#include "ShaderCache.h"
+
+#include "Device.h"
+
+#include <filesystem>
+
+namespace Render
+{
+	ShaderCache::ShaderCache()
+	{
+	}
+
+	ShaderCache::~ShaderCache()
+	{
+		destroy();
+	}
+
+	void ShaderCache::init(Device* device)
+	{
+		destroy();
+
+		this->device = device;
+	}
+
+	void ShaderCache::destroy()
+	{
+		if (device) {
+			for (auto& entry : entries) {
+				vkDestroyShaderModule(device->getDevice(), entry.second.module, nullptr);
+			}
+		}
+		entries.clear();
+		paths.clear();
+		modules.clear();
+		listeners.clear();
+
+		device = nullptr;
+	}
+
+	std::string ShaderCache::canonicalPath(const std::string& path)
+	{
+		std::error_code error;
+		auto canonical = std::filesystem::weakly_canonical(path, error);
+		return error ? path : canonical.string();
+	}
+
+	ShaderCache::ContentKey ShaderCache::hashCode(const std::vector<char>& code)
+	{
+		// FNV-1a
+		uint64_t hash = 14695981039346656037ull;
+		for (char byte : code) {
+			hash = (hash ^ static_cast<uint8_t>(byte)) * 1099511628211ull;
+		}
+		return { hash, code.size() };
+	}
+
+	VkShaderModule ShaderCache::acquire(const std::string& path)
+	{
+		if (!isActive()) return VK_NULL_HANDLE;
+
+		auto it = paths.find(canonicalPath(path));
+		if (it == paths.end()) return VK_NULL_HANDLE;
+
+		auto& entry = entries[it->second];
+		entry.references++;
+		return entry.module;
+	}
+
+	VkShaderModule ShaderCache::insert(const std::string& path, const std::vector<char>& code)
+	{
+		if (!isActive()) return VK_NULL_HANDLE;
+
+		auto canonical = canonicalPath(path);
+		auto key = hashCode(code);
+
+		// Same path with new contents, e.g. inserted again after a reload without invalidate()
+		auto previous = paths.find(canonical);
+		if (previous != paths.end() && previous->second != key) {
+			auto old = previous->second;
+			paths.erase(previous);
+			forgetPath(old);
+		}
+
+		auto it = entries.find(key);
+		if (it == entries.end()) {
+			VkShaderModuleCreateInfo createInfo{};
+			createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+			createInfo.codeSize = code.size();
+			createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+			VkShaderModule module = VK_NULL_HANDLE;
+			if (vkCreateShaderModule(device->getDevice(), &createInfo, nullptr, &module) != VK_SUCCESS) {
+				Alert("Failed to create shader module: " + path, CRITICAL);
+				return VK_NULL_HANDLE;
+			}
+
+			it = entries.insert({ key, { module, 0, 0 } }).first;
+			modules[module] = key;
+		}
+
+		if (paths.find(canonical) == paths.end()) {
+			paths[canonical] = key;
+			it->second.paths++;
+		}
+
+		it->second.references++;
+		return it->second.module;
+	}
+
+	void ShaderCache::release(VkShaderModule module)
+	{
+		if (!isActive() || module == VK_NULL_HANDLE) return;
+
+		auto it = modules.find(module);
+		if (it == modules.end()) {
+			Alert("Released a shader module the cache does not own.", WARNING);
+			return;
+		}
+
+		auto key = it->second;
+		auto& entry = entries[key];
+		if (entry.references > 0) entry.references--;
+
+		destroyIfUnused(key);
+	}
+
+	void ShaderCache::invalidate(const std::string& path)
+	{
+		if (!isActive()) return;
+
+		if (path.empty()) {
+			auto forgotten = paths;
+			paths.clear();
+			for (auto& entry : forgotten) {
+				forgetPath(entry.second);
+			}
+		}
+		else {
+			auto it = paths.find(canonicalPath(path));
+			if (it != paths.end()) {
+				auto key = it->second;
+				paths.erase(it);
+				forgetPath(key);
+			}
+		}
+
+		notify(path);
+	}
+
+	void ShaderCache::reload(const std::string& path, const std::vector<char>& code)
+	{
+		if (!isActive()) return;
+
+		auto canonical = canonicalPath(path);
+		auto previous = paths.find(canonical);
+		if (previous != paths.end() && previous->second == hashCode(code)) return;
+
+		// Replaces whatever the path held, Shaders keep their old module until they acquire the new one
+		VkShaderModule module = insert(canonical, code);
+		if (module == VK_NULL_HANDLE) return;
+		release(module);
+
+		notify(canonical);
+	}
+
+	void ShaderCache::notify(const std::string& path)
+	{
+		// Copied, a listener may remove itself
+		auto current = listeners;
+		for (auto& listener : current) {
+			listener.second(path);
+		}
+	}
+
+	uint32_t ShaderCache::addListener(Listener listener)
+	{
+		listeners[nextListener] = listener;
+		return nextListener++;
+	}
+
+	void ShaderCache::removeListener(uint32_t id)
+	{
+		listeners.erase(id);
+	}
+
+	void ShaderCache::forgetPath(const ContentKey& key)
+	{
+		auto it = entries.find(key);
+		if (it == entries.end()) return;
+
+		if (it->second.paths > 0) it->second.paths--;
+		destroyIfUnused(key);
+	}
+
+	void ShaderCache::destroyIfUnused(const ContentKey& key)
+	{
+		// Pipelines do not need their modules after creation, a module with no users and no path is dead
+		auto it = entries.find(key);
+		if (it == entries.end() || it->second.references > 0 || it->second.paths > 0) return;
+
+		device->getPipelineCache().forgetModule(it->second.module);
+		vkDestroyShaderModule(device->getDevice(), it->second.module, nullptr);
+		modules.erase(it->second.module);
+		entries.erase(it);
+	}
+}
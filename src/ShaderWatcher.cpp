@@ -0,0 +1,181 @@
+#include "ShaderWatcher.h"
+
+#include "Device.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#define SPIRV_MAGIC 0x07230203
+
+namespace Render
+{
+	ShaderWatcher::ShaderWatcher()
+	{
+	}
+
+	ShaderWatcher::~ShaderWatcher()
+	{
+		destroy();
+	}
+
+	void ShaderWatcher::init(Device* device)
+	{
+		destroy();
+
+#ifdef __linux__
+		notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (notifyFd < 0) {
+			Alert("Failed to start inotify, shader hot reload is disabled.", WARNING);
+			return;
+		}
+#endif
+
+		this->device = device;
+
+		stopping = false;
+		thread = std::thread(&ShaderWatcher::run, this);
+	}
+
+	void ShaderWatcher::destroy()
+	{
+		stopping = true;
+		if (thread.joinable()) thread.join();
+
+#ifdef __linux__
+		if (notifyFd >= 0) {
+			close(notifyFd);
+			notifyFd = -1;
+		}
+		directories.clear();
+#else
+		writeTimes.clear();
+#endif
+		files.clear();
+		changed.clear();
+
+		device = nullptr;
+	}
+
+	void ShaderWatcher::watch(const std::string& path)
+	{
+		if (!isActive()) return;
+
+		std::error_code error;
+		auto canonical = std::filesystem::weakly_canonical(path, error);
+		if (error) return;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!files.insert(canonical.string()).second) return;
+
+#ifdef __linux__
+		// Directories, not files: compilers and editors usually replace the file by renaming over it
+		auto directory = canonical.parent_path().string();
+		for (auto& watched : directories) {
+			if (watched.second == directory) return;
+		}
+
+		int descriptor = inotify_add_watch(notifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (descriptor < 0) {
+			Alert("Failed to watch " + directory + " for shader changes.", WARNING);
+			return;
+		}
+		directories[descriptor] = directory;
+#else
+		writeTimes[canonical.string()] = std::filesystem::last_write_time(canonical, error).time_since_epoch().count();
+#endif
+	}
+
+	void ShaderWatcher::poll()
+	{
+		if (!isActive()) return;
+
+		std::map<std::string, std::vector<char>> ready;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			ready.swap(changed);
+		}
+
+		for (auto& file : ready) {
+			Alert("Reloading shader " + file.first, INFO);
+			device->getShaderCache().reload(file.first, file.second);
+		}
+	}
+
+	void ShaderWatcher::run()
+	{
+		while (!stopping) {
+#ifdef __linux__
+			pollfd descriptor{ notifyFd, POLLIN, 0 };
+			if (::poll(&descriptor, 1, 100) <= 0) continue;
+
+			alignas(inotify_event) char buffer[4096];
+			ssize_t length = ::read(notifyFd, buffer, sizeof(buffer));
+			if (length <= 0) continue;
+
+			std::set<std::string> paths;
+			for (char* ptr = buffer; ptr < buffer + length;) {
+				auto event = reinterpret_cast<inotify_event*>(ptr);
+				ptr += sizeof(inotify_event) + event->len;
+				if (event->len == 0) continue;
+
+				std::lock_guard<std::mutex> lock(mutex);
+				auto directory = directories.find(event->wd);
+				if (directory == directories.end()) continue;
+
+				auto path = (std::filesystem::path(directory->second) / event->name).string();
+				if (files.count(path)) paths.insert(path);
+			}
+
+			// One read per file however many events the write produced
+			for (auto& path : paths) {
+				read(path);
+			}
+#else
+			std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+			std::vector<std::string> paths;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				for (auto& file : writeTimes) {
+					std::error_code error;
+					auto time = std::filesystem::last_write_time(file.first, error).time_since_epoch().count();
+					if (!error && time != file.second) {
+						file.second = time;
+						paths.push_back(file.first);
+					}
+				}
+			}
+
+			for (auto& path : paths) {
+				read(path);
+			}
+#endif
+		}
+	}
+
+	void ShaderWatcher::read(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open()) return;
+
+		std::vector<char> code((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		// Half written files come around again with the next close
+		uint32_t magic = 0;
+		if (code.size() < sizeof(magic) || code.size() % 4 != 0) return;
+		std::memcpy(&magic, code.data(), sizeof(magic));
+		if (magic != SPIRV_MAGIC) return;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		changed[path] = std::move(code);
+	}
+}
@@ -192,7 +192,7 @@ namespace Render
 		colorBuffer->createImageView(imageFormats[0], VK_IMAGE_ASPECT_COLOR_BIT, 1);
 	}
 
-	void SwapChain::generateFramebuffers(VkRenderPass& renderPass)
+	void SwapChain::generateFramebuffers(VkRenderPass& renderPass, VkRenderPass depthRenderPass)
 	{
 		if (device.wait() != Manager::State::YES) {
 			Alert("Device died before it was ready to be used.", FATAL);
@@ -201,6 +201,10 @@ namespace Render
 		for (auto framebuffer : swapChainFramebuffers) {
 			vkDestroyFramebuffer((*device).getDevice(), framebuffer, nullptr);
 		}
+		if (depthFramebuffer != VK_NULL_HANDLE) {
+			vkDestroyFramebuffer((*device).getDevice(), depthFramebuffer, nullptr);
+			depthFramebuffer = VK_NULL_HANDLE;
+		}
 
 		swapChainFramebuffers.resize(swapChainImageBuffers.size());
 
@@ -225,6 +229,22 @@ namespace Render
 				return;
 			}
 		}
+
+		if (depthRenderPass == VK_NULL_HANDLE) return;
+
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = depthRenderPass;
+		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.pAttachments = &depthBuffer->getImageView();
+		framebufferInfo.width = swapChainExtent.width;
+		framebufferInfo.height = swapChainExtent.height;
+		framebufferInfo.layers = 1;
+
+		if (vkCreateFramebuffer((*device).getDevice(), &framebufferInfo, nullptr, &depthFramebuffer) != VK_SUCCESS) {
+			Alert("Failed to create the depth pre-pass framebuffer!", FATAL);
+			return;
+		}
 	}
 
 	void SwapChain::cleanupSwapChain()
@@ -244,8 +264,10 @@ namespace Render
 			for (auto framebuffer : swapChainFramebuffers) {
 				vkDestroyFramebuffer((*device).getDevice(), framebuffer, nullptr);
 			}
+			if (depthFramebuffer != VK_NULL_HANDLE) vkDestroyFramebuffer((*device).getDevice(), depthFramebuffer, nullptr);
 		}
 		swapChainFramebuffers.clear();
+		depthFramebuffer = VK_NULL_HANDLE;
 		if (device && swapChain) {
 			vkDestroySwapchainKHR((*device).getDevice(), swapChain, nullptr);
 			swapChain = VK_NULL_HANDLE;
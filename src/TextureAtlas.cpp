@@ -0,0 +1,303 @@
+#include "TextureAtlas.h"
+
+#include "Device.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Render
+{
+	void SkylinePacker::reset(uint32_t size)
+	{
+		this->size = size;
+		skyline.clear();
+		skyline.push_back({ 0, 0, size });
+	}
+
+	bool SkylinePacker::pack(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y)
+	{
+		size_t bestIndex = skyline.size();
+		uint32_t bestTop = UINT32_MAX;
+		uint32_t bestWidth = UINT32_MAX;
+
+		// Lowest resulting top edge wins, the narrower segment breaks ties
+		for (size_t i = 0; i < skyline.size(); i++) {
+			uint32_t top;
+			if (!fits(i, width, height, top)) continue;
+
+			if (top < bestTop || (top == bestTop && skyline[i].width < bestWidth)) {
+				bestIndex = i;
+				bestTop = top;
+				bestWidth = skyline[i].width;
+			}
+		}
+		if (bestIndex == skyline.size()) return false;
+
+		x = skyline[bestIndex].x;
+		y = bestTop;
+		insert(bestIndex, x, y + height, width);
+		return true;
+	}
+
+	bool SkylinePacker::fits(size_t index, uint32_t width, uint32_t height, uint32_t& top)
+	{
+		if (skyline[index].x + width > size) return false;
+
+		top = 0;
+		uint32_t remaining = width;
+		for (size_t i = index; remaining > 0; i++) { // Nodes cover the whole layer width
+			top = std::max(top, skyline[i].y);
+			if (top + height > size) return false;
+			remaining -= std::min(remaining, skyline[i].width);
+		}
+		return true;
+	}
+
+	void SkylinePacker::insert(size_t index, uint32_t x, uint32_t y, uint32_t width)
+	{
+		skyline.insert(skyline.begin() + index, { x, y, width });
+
+		// Trim the segments now under the new one
+		for (size_t i = index + 1; i < skyline.size();) {
+			uint32_t end = skyline[index].x + skyline[index].width;
+			if (skyline[i].x >= end) break;
+
+			uint32_t shrink = end - skyline[i].x;
+			if (skyline[i].width <= shrink) {
+				skyline.erase(skyline.begin() + i);
+				continue;
+			}
+			skyline[i].x += shrink;
+			skyline[i].width -= shrink;
+			break;
+		}
+
+		for (size_t i = 0; i + 1 < skyline.size();) {
+			if (skyline[i].y == skyline[i + 1].y) {
+				skyline[i].width += skyline[i + 1].width;
+				skyline.erase(skyline.begin() + i + 1);
+			}
+			else {
+				i++;
+			}
+		}
+	}
+
+	TextureAtlas::TextureAtlas(TextureAtlasConfig config) : config(config)
+	{
+		viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+	}
+
+	TextureAtlas::~TextureAtlas()
+	{
+		destroy();
+	}
+
+	void TextureAtlas::init(size_t deviceUUID)
+	{
+		ImageBuffer::init(deviceUUID);
+
+		upload();
+	}
+
+	void TextureAtlas::destroy()
+	{
+		if (device && bindlessIndex != BINDLESS_INVALID_INDEX) {
+			(*device).getBindlessHeap().removeTexture(bindlessIndex);
+			bindlessIndex = BINDLESS_INVALID_INDEX;
+		}
+
+		ImageBuffer::destroy();
+
+		if (device) {
+			if (imageSampler != VK_NULL_HANDLE) {
+				(*device).getSamplerCache().release(imageSampler);
+				imageSampler = VK_NULL_HANDLE;
+			}
+		}
+	}
+
+	uint32_t TextureAtlas::addTexture(const std::string& path)
+	{
+		if (image != VK_NULL_HANDLE) {
+			Alert("Texture atlas is already uploaded, " + path + " was not added.", WARNING);
+			return TEXTURE_ATLAS_INVALID_ENTRY;
+		}
+
+		auto file = Request<FILETYPE>(FILE_Request, path, {Manager::FileFlags::IMAGE | Manager::FileFlags::READ, 4});
+		if (file.wait() != Manager::State::YES) {
+			Alert("Failed to load atlas image " + path, CRITICAL);
+			return TEXTURE_ATLAS_INVALID_ENTRY;
+		}
+		auto imageFile = dynamic_cast<Manager::ImageFile*>(*file);
+
+		uint32_t width = static_cast<uint32_t>(imageFile->width);
+		uint32_t height = static_cast<uint32_t>(imageFile->height);
+		uint32_t paddedWidth = width + config.padding * 2;
+		uint32_t paddedHeight = height + config.padding * 2;
+
+		if (std::max(width, height) > config.maxEntrySize || std::max(paddedWidth, paddedHeight) > config.layerSize) {
+			Alert(path + " is too large for the texture atlas, load it as a TextureImage.", WARNING);
+			imageFile->close();
+			return TEXTURE_ATLAS_INVALID_ENTRY;
+		}
+
+		uint32_t x = 0, y = 0;
+		size_t layer = 0;
+		while (layer < layers.size() && !layers[layer].packer.pack(paddedWidth, paddedHeight, x, y)) {
+			layer++;
+		}
+		if (layer == layers.size()) {
+			if (layers.size() >= config.maxLayers) {
+				Alert("Texture atlas is full, " + path + " was not added.", WARNING);
+				imageFile->close();
+				return TEXTURE_ATLAS_INVALID_ENTRY;
+			}
+
+			layers.emplace_back();
+			layers.back().packer.reset(config.layerSize);
+			layers.back().pixels.resize(static_cast<size_t>(config.layerSize) * config.layerSize * 4);
+			layers.back().packer.pack(paddedWidth, paddedHeight, x, y);
+		}
+
+		blit(layers[layer], static_cast<const unsigned char*>(imageFile->pixels), width, height, x, y);
+		imageFile->close();
+
+		float texel = 1.0f / static_cast<float>(config.layerSize);
+		entries.push_back({
+			static_cast<uint32_t>(layer),
+			glm::vec2(x + config.padding, y + config.padding) * texel,
+			glm::vec2(width, height) * texel
+		});
+
+		return static_cast<uint32_t>(entries.size() - 1);
+	}
+
+	void TextureAtlas::blit(Layer& layer, const unsigned char* pixels, uint32_t width, uint32_t height, uint32_t x, uint32_t y)
+	{
+		// The padding repeats the entry's edge pixels so filtering never reads a neighbour
+		uint32_t padding = config.padding;
+		for (uint32_t row = 0; row < height + padding * 2; row++) {
+			uint32_t srcRow = std::min(row > padding ? row - padding : 0, height - 1);
+			unsigned char* dst = layer.pixels.data() + (static_cast<size_t>(y + row) * config.layerSize + x) * 4;
+			const unsigned char* src = pixels + static_cast<size_t>(srcRow) * width * 4;
+
+			for (uint32_t column = 0; column < padding; column++) {
+				memcpy(dst + column * 4, src, 4);
+				memcpy(dst + (padding + width + column) * 4, src + (width - 1) * 4, 4);
+			}
+			memcpy(dst + padding * 4, src, static_cast<size_t>(width) * 4);
+		}
+	}
+
+	void TextureAtlas::remap(VertexBufferData& data, uint32_t entry)
+	{
+		if (entry >= entries.size()) {
+			Alert("Texture atlas entry out of range.", WARNING);
+			return;
+		}
+		auto& region = entries[entry];
+
+		for (auto& vertex : data.getVertices()) {
+			vertex.texCoord = region.offset + glm::clamp(vertex.texCoord, 0.0f, 1.0f) * region.scale;
+		}
+		data.setMaterialIndex(region.layer);
+	}
+
+	void TextureAtlas::upload()
+	{
+		if (layers.empty()) {
+			Alert("Texture atlas has no entries.", WARNING);
+			return;
+		}
+
+		if (device.wait() != Manager::State::YES) {
+			Alert("Device died before it was ready to be used.", FATAL);
+			return;
+		}
+
+		// Past this level the padding shrinks below a texel and entries bleed into each other
+		uint32_t fullChain = static_cast<uint32_t>(std::floor(std::log2(config.layerSize))) + 1;
+		uint32_t paddedChain = static_cast<uint32_t>(std::floor(std::log2(std::max(config.padding, 1u)))) + 1;
+		mipLevels = std::min(fullChain, paddedChain);
+
+		VkDeviceSize layerBytes = static_cast<VkDeviceSize>(config.layerSize) * config.layerSize * 4;
+		imageSize = layerBytes * layers.size();
+
+		VkBuffer stagingBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+		(*device).createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+		std::vector<VkBufferImageCopy> regions(layers.size());
+		void* data;
+		vkMapMemory((*device).getDevice(), stagingBufferMemory, 0, imageSize, 0, &data);
+		for (size_t i = 0; i < layers.size(); i++) {
+			memcpy(static_cast<char*>(data) + layerBytes * i, layers[i].pixels.data(), static_cast<size_t>(layerBytes));
+
+			regions[i].bufferOffset = layerBytes * i;
+			regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			regions[i].imageSubresource.mipLevel = 0;
+			regions[i].imageSubresource.baseArrayLayer = static_cast<uint32_t>(i);
+			regions[i].imageSubresource.layerCount = 1;
+			regions[i].imageOffset = { 0, 0, 0 };
+			regions[i].imageExtent = { config.layerSize, config.layerSize, 1 };
+
+			layers[i].pixels.clear();
+			layers[i].pixels.shrink_to_fit();
+		}
+		vkUnmapMemory((*device).getDevice(), stagingBufferMemory);
+
+		createImage(config.layerSize, config.layerSize, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, static_cast<uint32_t>(layers.size()));
+
+		transitionImageLayout(VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+		copyBufferToImage(stagingBuffer, image, regions);
+		generateMipmaps(VK_FORMAT_R8G8B8A8_SRGB, config.layerSize, config.layerSize, mipLevels);
+
+		vkDestroyBuffer((*device).getDevice(), stagingBuffer, nullptr);
+		vkFreeMemory((*device).getDevice(), stagingBufferMemory, nullptr);
+
+		createImageView(VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+		createSampler();
+
+		// A 2D array view, bindless shaders sample it through bindlessTextureArrays, never bindlessTextures
+		bindlessIndex = (*device).getBindlessHeap().addTexture(imageView, imageSampler);
+	}
+
+	void TextureAtlas::createSampler()
+	{
+		// Entries never wrap, repeating would sample the neighbouring entry
+		SamplerKey key{};
+		key.addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		key.maxLod = static_cast<float>(mipLevels);
+
+		auto& samplerCache = (*device).getSamplerCache();
+		samplerCache.release(imageSampler);
+
+		imageSampler = samplerCache.acquire(key);
+		if (imageSampler == VK_NULL_HANDLE) {
+			Alert("Failed to create texture atlas sampler!", FATAL);
+			return;
+		}
+	}
+
+	VkWriteDescriptorSet TextureAtlas::createWrite(int frame, VkDescriptorSet& descriptorSet)
+	{
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = imageView;
+		imageInfo.sampler = imageSampler;
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = descriptorSet;
+		descriptorWrite.dstBinding = 1;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &imageInfo;
+
+		return descriptorWrite;
+	}
+}
@@ -0,0 +1,129 @@
+#include "TextureCache.h"
+
+#include "Device.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace Render
+{
+	TextureCache::TextureCache()
+	{
+	}
+
+	TextureCache::~TextureCache()
+	{
+		destroy();
+	}
+
+	void TextureCache::init(Device* device, TextureCacheConfig config)
+	{
+		destroy();
+
+		this->device = device;
+		this->config = config;
+		this->config.evictionFrames = std::max<uint32_t>(config.evictionFrames, MAX_FRAMES_IN_FLIGHT);
+	}
+
+	void TextureCache::destroy()
+	{
+		if (device) {
+			for (auto& entry : entries) {
+				destroyTexture(entry.second.texture);
+			}
+		}
+		entries.clear();
+
+		device = nullptr;
+	}
+
+	std::string TextureCache::makeKey(const std::string& path)
+	{
+		std::error_code error;
+		auto canonical = std::filesystem::weakly_canonical(path, error);
+		if (error) return "";
+
+		if (!config.hashContents) return "path:" + canonical.string();
+
+		std::ifstream file(canonical, std::ios::binary);
+		if (!file.is_open()) return "";
+
+		// FNV-1a, reading is cheap next to a decode and upload
+		uint64_t hash = 14695981039346656037ull;
+		uint64_t size = 0;
+		char chunk[1 << 16];
+		while (file.read(chunk, sizeof(chunk)) || file.gcount() > 0) {
+			auto count = file.gcount();
+			for (std::streamsize i = 0; i < count; i++) {
+				hash = (hash ^ static_cast<uint8_t>(chunk[i])) * 1099511628211ull;
+			}
+			size += count;
+		}
+
+		std::stringstream key;
+		key << "hash:" << std::hex << hash << ":" << size;
+		return key.str();
+	}
+
+	bool TextureCache::acquire(const std::string& key, CachedTexture& texture)
+	{
+		if (!isActive() || key.empty()) return false;
+
+		auto it = entries.find(key);
+		if (it == entries.end()) return false;
+
+		it->second.references++;
+		it->second.framesUnused = 0;
+		texture = it->second.texture;
+		return true;
+	}
+
+	bool TextureCache::insert(const std::string& key, const CachedTexture& texture)
+	{
+		if (!isActive() || key.empty()) return false;
+
+		auto it = entries.find(key);
+		if (it != entries.end()) {
+			// Loaded twice before either was cached, keep the first
+			Alert("Texture cache already holds " + key + ", the duplicate image stays with its texture.", WARNING);
+			return false;
+		}
+
+		entries[key] = { texture, 1, 0 };
+		return true;
+	}
+
+	void TextureCache::release(const std::string& key)
+	{
+		if (!isActive() || key.empty()) return;
+
+		auto it = entries.find(key);
+		if (it == entries.end()) return;
+
+		if (it->second.references > 0) it->second.references--;
+		it->second.framesUnused = 0;
+	}
+
+	void TextureCache::advanceFrame()
+	{
+		for (auto it = entries.begin(); it != entries.end();) {
+			if (it->second.references == 0 && ++it->second.framesUnused >= config.evictionFrames) {
+				destroyTexture(it->second.texture);
+				it = entries.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+
+	void TextureCache::destroyTexture(CachedTexture& texture)
+	{
+		vkDestroyImageView(device->getDevice(), texture.view, nullptr);
+		vkDestroyImage(device->getDevice(), texture.image, nullptr);
+		vkFreeMemory(device->getDevice(), texture.memory, nullptr);
+		texture = {};
+	}
+}
@@ -0,0 +1,405 @@
+#include "TextureFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#define TEXTURE_FILE_COPY_ALIGNMENT 16 // Multiple of every BC block size and of 4
+
+#define DDS_MAGIC 0x20534444 // "DDS "
+#define DDS_FOURCC(a, b, c, d) (static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24))
+#define DDS_PIXEL_FORMAT_FOURCC 0x4
+#define DDS_CAPS2_CUBEMAP 0x200
+#define DDS_CAPS2_VOLUME 0x200000
+#define DDS_DX10_MISC_TEXTURECUBE 0x4
+#define DDS_DX10_DIMENSION_TEXTURE3D 4
+
+namespace Render
+{
+	namespace
+	{
+		const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+		struct KTX2Header {
+			uint8_t identifier[12];
+			uint32_t vkFormat;
+			uint32_t typeSize;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth;
+			uint32_t layerCount;
+			uint32_t faceCount;
+			uint32_t levelCount;
+			uint32_t supercompressionScheme;
+
+			uint32_t dfdByteOffset;
+			uint32_t dfdByteLength;
+			uint32_t kvdByteOffset;
+			uint32_t kvdByteLength;
+			uint64_t sgdByteOffset;
+			uint64_t sgdByteLength;
+		};
+
+		struct KTX2Level {
+			uint64_t byteOffset;
+			uint64_t byteLength;
+			uint64_t uncompressedByteLength;
+		};
+
+		struct DDSPixelFormat {
+			uint32_t size;
+			uint32_t flags;
+			uint32_t fourCC;
+			uint32_t rgbBitCount;
+			uint32_t rBitMask;
+			uint32_t gBitMask;
+			uint32_t bBitMask;
+			uint32_t aBitMask;
+		};
+
+		struct DDSHeader {
+			uint32_t magic;
+			uint32_t size;
+			uint32_t flags;
+			uint32_t height;
+			uint32_t width;
+			uint32_t pitchOrLinearSize;
+			uint32_t depth;
+			uint32_t mipMapCount;
+			uint32_t reserved1[11];
+			DDSPixelFormat pixelFormat;
+			uint32_t caps;
+			uint32_t caps2;
+			uint32_t caps3;
+			uint32_t caps4;
+			uint32_t reserved2;
+		};
+
+		struct DDSHeaderDX10 {
+			uint32_t dxgiFormat;
+			uint32_t resourceDimension;
+			uint32_t miscFlag;
+			uint32_t arraySize;
+			uint32_t miscFlags2;
+		};
+
+		static_assert(sizeof(KTX2Header) == 80, "KTX2 header must match the spec");
+		static_assert(sizeof(DDSHeader) == 128, "DDS header must match the spec");
+
+		VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		// Full mip chain of a width x height image, larger counts would shift the extent by 32 or more
+		uint32_t maxLevelCount(uint32_t width, uint32_t height)
+		{
+			uint32_t count = 1;
+			for (uint32_t extent = std::max(width, height); extent > 1; extent >>= 1) count++;
+			return count;
+		}
+
+		uint64_t levelSize(uint32_t width, uint32_t height, uint32_t blockSize)
+		{
+			return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+		}
+
+		bool endsWith(const std::string& path, const std::string& extension)
+		{
+			if (path.size() < extension.size()) return false;
+			return std::equal(extension.rbegin(), extension.rend(), path.rbegin(), [](char a, char b) {
+				return a == std::tolower(static_cast<unsigned char>(b));
+			});
+		}
+	}
+
+	TextureFile::TextureFile()
+	{
+	}
+
+	TextureFile::~TextureFile()
+	{
+		close();
+	}
+
+	bool TextureFile::isSupportedPath(const std::string& path)
+	{
+		return endsWith(path, ".ktx2") || endsWith(path, ".dds");
+	}
+
+	bool TextureFile::open(const std::string& path)
+	{
+		close();
+		filePath = path;
+
+		file.open(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open()) {
+			Alert("Failed to open texture file: " + path, CRITICAL);
+			return false;
+		}
+		fileSize = static_cast<uint64_t>(file.tellg());
+		file.seekg(0);
+
+		bool parsed = endsWith(path, ".dds") ? parseDDS() : parseKTX2();
+		if (!parsed) {
+			close();
+			return false;
+		}
+
+		for (auto& level : levels) {
+			if (level.size > fileSize || level.fileOffset > fileSize - level.size) {
+				Alert("Texture file is truncated: " + path, CRITICAL);
+				close();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void TextureFile::close()
+	{
+		if (file.is_open()) file.close();
+		file.clear();
+
+		fileSize = 0;
+		format = VK_FORMAT_UNDEFINED;
+		levels.clear();
+	}
+
+	bool TextureFile::parseKTX2()
+	{
+		KTX2Header header{};
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(KTX2Header)) ||
+			memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+			Alert("Not a KTX2 file: " + filePath, CRITICAL);
+			return false;
+		}
+
+		if (header.supercompressionScheme != 0) {
+			Alert("Supercompressed KTX2 files are not supported: " + filePath, CRITICAL);
+			return false;
+		}
+		if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1) {
+			Alert("Only single layer 2D KTX2 textures are supported: " + filePath, CRITICAL);
+			return false;
+		}
+
+		format = static_cast<VkFormat>(header.vkFormat);
+		if (getBlockSize(format) == 0) {
+			Alert("KTX2 texture is not BC1, BC3, BC5 or BC7: " + filePath, CRITICAL);
+			return false;
+		}
+
+		if (header.pixelWidth == 0 || header.pixelHeight == 0) {
+			Alert("KTX2 texture has no extent: " + filePath, CRITICAL);
+			return false;
+		}
+
+		uint32_t levelCount = std::max(header.levelCount, 1u); // 0 asks for runtime mips, which BCn can't blit
+		if (levelCount > maxLevelCount(header.pixelWidth, header.pixelHeight)) {
+			Alert("KTX2 texture has more levels than its extent allows: " + filePath, CRITICAL);
+			return false;
+		}
+
+		std::vector<KTX2Level> index(levelCount);
+		if (!file.read(reinterpret_cast<char*>(index.data()), levelCount * sizeof(KTX2Level))) {
+			Alert("KTX2 level index is truncated: " + filePath, CRITICAL);
+			return false;
+		}
+
+		for (uint32_t i = 0; i < levelCount; i++) {
+			TextureFileLevel level{};
+			level.fileOffset = index[i].byteOffset;
+			level.size = index[i].byteLength;
+			level.width = std::max(header.pixelWidth >> i, 1u);
+			level.height = std::max(header.pixelHeight >> i, 1u);
+
+			// The copy reads exactly the level's blocks, any other length is a broken index
+			if (level.size != levelSize(level.width, level.height, getBlockSize(format))) {
+				Alert("KTX2 level size does not match its extent: " + filePath, CRITICAL);
+				return false;
+			}
+			levels.push_back(level);
+		}
+		return true;
+	}
+
+	bool TextureFile::parseDDS()
+	{
+		DDSHeader header{};
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(DDSHeader)) || header.magic != DDS_MAGIC) {
+			Alert("Not a DDS file: " + filePath, CRITICAL);
+			return false;
+		}
+
+		// Only face or slice 0 would be uploaded, the same files are rejected as in the KTX2 path
+		if (header.caps2 & DDS_CAPS2_CUBEMAP) {
+			Alert("DDS cubemaps are not supported: " + filePath, CRITICAL);
+			return false;
+		}
+		if ((header.caps2 & DDS_CAPS2_VOLUME) || header.depth > 1) {
+			Alert("DDS volume textures are not supported: " + filePath, CRITICAL);
+			return false;
+		}
+
+		uint64_t dataOffset = sizeof(DDSHeader);
+		format = VK_FORMAT_UNDEFINED;
+
+		if (header.pixelFormat.flags & DDS_PIXEL_FORMAT_FOURCC) {
+			switch (header.pixelFormat.fourCC) {
+				// Legacy headers carry no color space, color data is treated as sRGB like RGBA8 textures
+				case DDS_FOURCC('D', 'X', 'T', '1'): format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK; break;
+				case DDS_FOURCC('D', 'X', 'T', '5'): format = VK_FORMAT_BC3_SRGB_BLOCK; break;
+				case DDS_FOURCC('A', 'T', 'I', '2'):
+				case DDS_FOURCC('B', 'C', '5', 'U'): format = VK_FORMAT_BC5_UNORM_BLOCK; break;
+				case DDS_FOURCC('B', 'C', '5', 'S'): format = VK_FORMAT_BC5_SNORM_BLOCK; break;
+				case DDS_FOURCC('D', 'X', '1', '0'): {
+					DDSHeaderDX10 extended{};
+					if (!file.read(reinterpret_cast<char*>(&extended), sizeof(DDSHeaderDX10))) {
+						Alert("DDS DX10 header is truncated: " + filePath, CRITICAL);
+						return false;
+					}
+					if (extended.arraySize > 1) {
+						Alert("DDS texture arrays are not supported: " + filePath, CRITICAL);
+						return false;
+					}
+					if (extended.miscFlag & DDS_DX10_MISC_TEXTURECUBE) {
+						Alert("DDS cubemaps are not supported: " + filePath, CRITICAL);
+						return false;
+					}
+					if (extended.resourceDimension == DDS_DX10_DIMENSION_TEXTURE3D) {
+						Alert("DDS volume textures are not supported: " + filePath, CRITICAL);
+						return false;
+					}
+					format = formatFromDXGI(extended.dxgiFormat);
+					dataOffset += sizeof(DDSHeaderDX10);
+					break;
+				}
+				default: break;
+			}
+		}
+
+		if (getBlockSize(format) == 0) {
+			Alert("DDS texture is not BC1, BC3, BC5 or BC7: " + filePath, CRITICAL);
+			return false;
+		}
+
+		if (header.width == 0 || header.height == 0) {
+			Alert("DDS texture has no extent: " + filePath, CRITICAL);
+			return false;
+		}
+
+		uint32_t levelCount = std::max(header.mipMapCount, 1u);
+		if (levelCount > maxLevelCount(header.width, header.height)) {
+			Alert("DDS texture has more levels than its extent allows: " + filePath, CRITICAL);
+			return false;
+		}
+
+		uint32_t blockSize = getBlockSize(format);
+		for (uint32_t i = 0; i < levelCount; i++) {
+			TextureFileLevel level{};
+			level.width = std::max(header.width >> i, 1u);
+			level.height = std::max(header.height >> i, 1u);
+			level.fileOffset = dataOffset;
+			level.size = levelSize(level.width, level.height, blockSize);
+
+			dataOffset += level.size;
+			levels.push_back(level);
+		}
+		return true;
+	}
+
+	VkDeviceSize TextureFile::getDataSize(uint32_t firstLevel)
+	{
+		VkDeviceSize size = 0;
+		for (uint32_t i = firstLevel; i < levels.size(); i++) {
+			size = alignUp(size, TEXTURE_FILE_COPY_ALIGNMENT) + levels[i].size;
+		}
+		return size;
+	}
+
+	bool TextureFile::readLevels(void* dst, std::vector<VkBufferImageCopy>& regions, uint32_t firstLevel)
+	{
+		if (!file.is_open()) {
+			Alert("Texture file read before it was opened!", CRITICAL);
+			return false;
+		}
+
+		regions.clear();
+		auto out = static_cast<char*>(dst);
+
+		VkDeviceSize offset = 0;
+		for (uint32_t i = firstLevel; i < levels.size(); i++) {
+			auto& level = levels[i];
+			offset = alignUp(offset, TEXTURE_FILE_COPY_ALIGNMENT);
+
+			if (!readLevel(i, out + offset)) return false;
+
+			VkBufferImageCopy region{};
+			region.bufferOffset = offset;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = i;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = { 0, 0, 0 };
+			region.imageExtent = { level.width, level.height, 1 };
+			regions.push_back(region);
+
+			offset += level.size;
+		}
+		return true;
+	}
+
+	bool TextureFile::readLevel(uint32_t level, void* dst)
+	{
+		if (!file.is_open() || level >= levels.size()) {
+			Alert("Texture level read before the file was opened!", CRITICAL);
+			return false;
+		}
+
+		file.clear();
+		file.seekg(static_cast<std::streamoff>(levels[level].fileOffset));
+		if (!file.read(static_cast<char*>(dst), static_cast<std::streamsize>(levels[level].size))) {
+			Alert("Failed to read texture level from " + filePath, CRITICAL);
+			return false;
+		}
+		return true;
+	}
+
+	uint32_t TextureFile::getBlockSize(VkFormat format)
+	{
+		switch (format) {
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+				return 8;
+			case VK_FORMAT_BC3_UNORM_BLOCK:
+			case VK_FORMAT_BC3_SRGB_BLOCK:
+			case VK_FORMAT_BC5_UNORM_BLOCK:
+			case VK_FORMAT_BC5_SNORM_BLOCK:
+			case VK_FORMAT_BC7_UNORM_BLOCK:
+			case VK_FORMAT_BC7_SRGB_BLOCK:
+				return 16;
+			default:
+				return 0;
+		}
+	}
+
+	VkFormat TextureFile::formatFromDXGI(uint32_t dxgiFormat)
+	{
+		switch (dxgiFormat) {
+			case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK; // DXGI_FORMAT_BC1_UNORM
+			case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+			case 77: return VK_FORMAT_BC3_UNORM_BLOCK; // DXGI_FORMAT_BC3_UNORM
+			case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+			case 83: return VK_FORMAT_BC5_UNORM_BLOCK; // DXGI_FORMAT_BC5_UNORM
+			case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+			case 98: return VK_FORMAT_BC7_UNORM_BLOCK; // DXGI_FORMAT_BC7_UNORM
+			case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+			default: return VK_FORMAT_UNDEFINED;
+		}
+	}
+}
@@ -2,6 +2,18 @@
 
 #include "Device.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+
+// Private to this file, the manager may link its own copy
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
 namespace Render
 {
     TextureImage::TextureImage()
@@ -15,18 +27,111 @@ namespace Render
 
     void TextureImage::init(size_t deviceUUID)
     {
+        // Already uploaded by loadBatch() before its descriptor set was loaded
+        if (image != VK_NULL_HANDLE && loadedPath == filePath) return;
+
         ImageBuffer::init(deviceUUID);
 
         loadFromFile();
     }
 
+    void TextureImage::loadBatch(size_t deviceUUID, const std::vector<std::shared_ptr<TextureImage>>& textures)
+    {
+        // Workers push what they finished, the lock is held while notifying so nothing outlives this call
+        struct Decoded
+        {
+            std::mutex mutex;
+            std::condition_variable condition;
+            std::vector<TextureImage*> ready;
+        } decoded;
+
+        // Every device is checked before the first job, nothing returns while workers still hold decoded
+        std::vector<std::shared_ptr<TextureImage>> loading;
+        for (auto& texture : textures) {
+            if (!texture || (texture->image != VK_NULL_HANDLE && texture->loadedPath == texture->filePath)) continue;
+
+            texture->ImageBuffer::init(deviceUUID);
+            if (texture->device.wait() != Manager::State::YES) {
+                texture->Alert("Device died before it was ready to be used.", FATAL);
+                return;
+            }
+            loading.push_back(texture);
+        }
+
+        size_t submitted = 0;
+        std::vector<std::shared_ptr<TextureImage>> repeated;
+        std::set<std::string> paths;
+
+        for (auto& texture : loading) {
+            // Later textures with the same path are loaded after the first is cached, so they never decode
+            if (!paths.insert(texture->filePath).second) {
+                repeated.push_back(texture);
+                continue;
+            }
+
+            if (!texture->requestDecode()) continue;
+
+            auto& workers = (*texture->device).getTextureStreamer().getWorkers();
+            if (workers.isRunning()) {
+                auto* ptr = texture.get();
+                workers.submit([ptr, &decoded]() {
+                    ptr->decode();
+
+                    std::lock_guard<std::mutex> lock(decoded.mutex);
+                    decoded.ready.push_back(ptr);
+                    decoded.condition.notify_one();
+                });
+                submitted++;
+            }
+            else {
+                texture->decode();
+                texture->upload();
+            }
+        }
+
+        // Upload in the order decodes finish, the queue is busy while the workers keep decoding
+        std::vector<TextureImage*> ready;
+        while (submitted > 0) {
+            {
+                std::unique_lock<std::mutex> lock(decoded.mutex);
+                decoded.condition.wait(lock, [&decoded]() { return !decoded.ready.empty(); });
+                ready.swap(decoded.ready);
+            }
+
+            for (auto* texture : ready) {
+                texture->upload();
+            }
+            submitted -= ready.size();
+            ready.clear();
+        }
+
+        for (auto& texture : repeated) {
+            texture->loadFromFile();
+        }
+    }
+
     void TextureImage::destroy()
     {
+        stopStreaming();
+
+        if (device && bindlessIndex != BINDLESS_INVALID_INDEX) {
+            (*device).getBindlessHeap().removeTexture(bindlessIndex);
+            bindlessIndex = BINDLESS_INVALID_INDEX;
+        }
+
+        if (device && isCached) {
+            (*device).getTextureCache().release(cacheKey);
+            image = VK_NULL_HANDLE;
+            imageMemory = VK_NULL_HANDLE;
+            imageView = VK_NULL_HANDLE;
+            isCached = false;
+        }
+
         ImageBuffer::destroy();
 
         if (device) {
             if (imageSampler != VK_NULL_HANDLE) {
-                vkDestroySampler((*device).getDevice(), imageSampler, nullptr); 
+                (*device).getSamplerCache().release(imageSampler);
                 imageSampler = VK_NULL_HANDLE;
             }
         }
@@ -34,30 +139,93 @@ namespace Render
     
     void TextureImage::loadFromFile()
     {
-        file = Request<FILETYPE>(FILE_Request, filePath, {Manager::FileFlags::IMAGE | Manager::FileFlags::READ, 4});
+        if (device.wait() != Manager::State::YES) {
+            Alert("Device died before it was ready to be used.", FATAL);
+            return;
+        }
 
-        if (file.wait() != Manager::State::YES) {
+        if (!requestDecode()) return;
+
+        decode();
+        upload();
+    }
+
+    bool TextureImage::requestDecode()
+    {
+        // Calling thread only, the cache and the device are never touched from workers
+        loadedPath = filePath;
+        cacheKey = (*device).getTextureCache().makeKey(filePath);
+        if (loadFromCache()) return false;
+
+        isDecoded = false;
+        streamLevels = (*device).getTextureStreamer().isActive();
+        return true;
+    }
+
+    void TextureImage::decode()
+    {
+        // Runs on worker threads, file IO and decoding into decodedData only
+        decodedData.clear();
+        decodedRegions.clear();
+
+        if (TextureFile::isSupportedPath(filePath)) {
+            if (!streamFile.open(filePath)) return;
+
+            // Only the mip tail is read now when a streamer can bring in the rest
+            residentLevel = 0;
+            if (streamLevels) {
+                while (residentLevel + 1 < streamFile.getLevelCount() && streamFile.getDataSize(residentLevel) > TEXTURE_STREAM_INITIAL_BYTES) {
+                    residentLevel++;
+                }
+            }
+
+            decodedData.resize(static_cast<size_t>(streamFile.getDataSize(residentLevel)));
+            isDecoded = streamFile.readLevels(decodedData.data(), decodedRegions, residentLevel);
+            if (!isDecoded || residentLevel == 0) streamFile.close();
+            return;
+        }
+
+        int fileWidth = 0, fileHeight = 0, channels = 0;
+        stbi_uc* pixels = stbi_load(filePath.c_str(), &fileWidth, &fileHeight, &channels, STBI_rgb_alpha);
+        if (pixels == nullptr) return;
+
+        width = static_cast<uint32_t>(fileWidth);
+        height = static_cast<uint32_t>(fileHeight);
+        decodedData.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+        stbi_image_free(pixels);
+        isDecoded = true;
+    }
+
+    void TextureImage::upload()
+    {
+        if (!isDecoded) {
             Alert("Failed to load image from file!", CRITICAL);
+            decodedData.clear();
             return;
         }
-        auto imageFile = dynamic_cast<Manager::ImageFile*>(*file);
+        isDecoded = false;
 
-        imageSize = static_cast<VkDeviceSize>(imageFile->width) *
-                    static_cast<VkDeviceSize>(imageFile->height) *
-                    4;
+        if (TextureFile::isSupportedPath(filePath)) {
+            loadCompressedFromFile();
+            storeInCache();
+            return;
+        }
 
-        mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(imageFile->width, imageFile->height)))) + 1;
+        imageSize = static_cast<VkDeviceSize>(decodedData.size());
+        mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
 
-        loadImageToMemory(imageSize, imageFile);
+        loadImageToMemory(imageSize, decodedData.data());
+        decodedData.clear();
+        decodedData.shrink_to_fit();
 
-        createImage(imageFile->width, imageFile->height, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+        createImage(width, height, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
             VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
         transitionImageLayout(VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
-        copyBufferToImage(stagingBuffer, image, static_cast<uint32_t>(imageFile->width), static_cast<uint32_t>(imageFile->height));
+        copyBufferToImage(stagingBuffer, image, width, height);
 
-        generateMipmaps(VK_FORMAT_R8G8B8A8_SRGB, imageFile->width, imageFile->height, mipLevels);
+        generateMipmaps(VK_FORMAT_R8G8B8A8_SRGB, width, height, mipLevels);
 
         vkDestroyBuffer((*device).getDevice(), stagingBuffer, nullptr);
         vkFreeMemory((*device).getDevice(), stagingBufferMemory, nullptr);
@@ -66,53 +234,235 @@ namespace Render
         createImageView(VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
         createSampler();
 
-        imageFile->close();
+        bindlessIndex = (*device).getBindlessHeap().addTexture(imageView, imageSampler);
+
+        storeInCache();
     }
 
-    void TextureImage::loadImageToMemory(VkDeviceSize imageSize, Manager::ImageFile* file)
+    bool TextureImage::loadFromCache()
+    {
+        CachedTexture cached{};
+        if (!(*device).getTextureCache().acquire(cacheKey, cached)) return false;
+
+        image = cached.image;
+        imageMemory = VK_NULL_HANDLE;
+        imageView = cached.view;
+        isCached = true;
+
+        format = cached.format;
+        width = cached.width;
+        height = cached.height;
+        mipLevels = cached.mipLevels;
+        residentLevel = 0;
+
+        createSampler();
+
+        bindlessIndex = (*device).getBindlessHeap().addTexture(imageView, imageSampler);
+        return true;
+    }
+
+    void TextureImage::storeInCache()
+    {
+        // Streaming replaces the view level by level, only fully resident images are shared
+        if (image == VK_NULL_HANDLE || imageView == VK_NULL_HANDLE || isStreaming()) return;
+
+        CachedTexture cached{ image, imageMemory, imageView, format, width, height, mipLevels };
+        isCached = (*device).getTextureCache().insert(cacheKey, cached);
+    }
+
+    void TextureImage::loadCompressedFromFile()
     {
         if (device.wait() != Manager::State::YES) {
 			Alert("Device died before it was ready to be used.", FATAL);
             return;
 		}
 
-        (*device).createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+        format = streamFile.getFormat();
 
-        void* data;
-        vkMapMemory((*device).getDevice(), stagingBufferMemory, 0, imageSize, 0, &data);
-        memcpy(data, file->pixels, static_cast<size_t>(imageSize));
-        vkUnmapMemory((*device).getDevice(), stagingBufferMemory);
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties((*device).getPhysicalDevice(), format, &formatProperties);
+        if (!(*device).getFeatures().textureCompressionBC ||
+            !(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+            Alert("Device can not sample the BC format of " + filePath, CRITICAL);
+            streamFile.close();
+            decodedData.clear();
+            return;
+        }
+
+        mipLevels = streamFile.getLevelCount();
+        width = streamFile.getWidth();
+        height = streamFile.getHeight();
+        imageSize = static_cast<VkDeviceSize>(decodedData.size());
+
+        // decode() read every resident level, packed for a single copy command
+        loadImageToMemory(imageSize, decodedData.data());
+        decodedData.clear();
+        decodedData.shrink_to_fit();
+
+        createImage(width, height, mipLevels, VK_SAMPLE_COUNT_1_BIT, format, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        transitionImageLayout(format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels - residentLevel, residentLevel);
+        copyBufferToImage(stagingBuffer, image, decodedRegions);
+        transitionImageLayout(format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels - residentLevel, residentLevel);
+        decodedRegions.clear();
+
+        vkDestroyBuffer((*device).getDevice(), stagingBuffer, nullptr);
+        vkFreeMemory((*device).getDevice(), stagingBufferMemory, nullptr);
+        stagingBuffer = VK_NULL_HANDLE, stagingBufferMemory = VK_NULL_HANDLE;
+
+        createImageView(format, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels - residentLevel, residentLevel);
+        createSampler();
+
+        bindlessIndex = (*device).getBindlessHeap().addTexture(imageView, imageSampler);
+
+        if (residentLevel > 0) {
+            streamer = &(*device).getTextureStreamer();
+            streamer->add(this);
+        }
     }
 
-    void TextureImage::createSampler()
+    void TextureImage::stopStreaming()
+    {
+        if (pendingLoad.valid()) {
+            pendingLoad.wait();
+            pendingLoad = {};
+        }
+        pendingData.clear();
+        pendingValid = false;
+
+        if (streamer != nullptr && device) { // The streamer is owned by the device
+            streamer->remove(this);
+        }
+        streamer = nullptr;
+        streamedBytes = 0;
+        streamFile.close();
+    }
+
+    uint32_t TextureImage::getWantedLevel()
+    {
+        if (screenSize <= 0.0f || mipLevels == 0) return 0;
+
+        float ratio = static_cast<float>(std::max(width, height)) / screenSize;
+        if (ratio <= 1.0f) return 0;
+
+        return std::min(static_cast<uint32_t>(std::floor(std::log2(ratio))), mipLevels - 1);
+    }
+
+    float TextureImage::getStreamPriority()
+    {
+        float residentSize = static_cast<float>(std::max(std::max(width, height) >> residentLevel, 1u));
+        float wantedSize = screenSize > 0.0f ? screenSize : static_cast<float>(std::max(width, height));
+        return wantedSize / residentSize;
+    }
+
+    VkDeviceSize TextureImage::getNextLevelSize()
+    {
+        if (residentLevel == 0) return 0;
+        return streamFile.getLevels()[residentLevel - 1].size;
+    }
+
+    bool TextureImage::isNextLevelLoading()
     {
-        VkSamplerCreateInfo samplerInfo{};
-        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-        samplerInfo.magFilter = VK_FILTER_LINEAR;
-        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        return pendingLoad.valid() && pendingLoad.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+    }
+
+    bool TextureImage::isNextLevelLoaded()
+    {
+        if (!pendingLoad.valid() || isNextLevelLoading()) return false;
+        return pendingValid;
+    }
+
+    void TextureImage::loadNextLevel(WorkerPool& workers)
+    {
+        if (residentLevel == 0) return;
+        if (pendingLoad.valid()) {
+            if (!isNextLevelLoading() && !pendingValid) {
+                Alert("Stopped streaming " + filePath + ", a level could not be read.", WARNING);
+                stopStreaming();
+            }
+            return;
+        }
 
-        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        uint32_t level = residentLevel - 1;
+        pendingData.resize(static_cast<size_t>(getNextLevelSize()));
+        pendingValid = false;
 
-        VkPhysicalDeviceProperties properties{};
-        vkGetPhysicalDeviceProperties((*device).getPhysicalDevice(), &properties); // Expose this struct instead of physicalDevice
+        pendingLoad = workers.submit([this, level]() {
+            pendingValid = streamFile.readLevel(level, pendingData.data());
+        });
+    }
+
+    VkImageView TextureImage::recordNextLevel(VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, VkDeviceSize offset, void* stagingData)
+    {
+        uint32_t level = residentLevel - 1;
+        auto& levelInfo = streamFile.getLevels()[level];
+
+        memcpy(stagingData, pendingData.data(), pendingData.size());
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = offset;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = { 0, 0, 0 };
+        region.imageExtent = { levelInfo.width, levelInfo.height, 1 };
 
-        samplerInfo.anisotropyEnable = VK_TRUE;
-        samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+        recordLayoutTransition(commandBuffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, level, 1);
+        vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        recordLayoutTransition(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, level, 1);
 
-        samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-        samplerInfo.unnormalizedCoordinates = VK_FALSE;
+        streamedBytes += pendingData.size();
+        residentLevel = level;
+
+        pendingLoad = {};
+        pendingData.clear();
+        pendingData.shrink_to_fit();
+        pendingValid = false;
+
+        // Descriptor sets pick the new view up the next time each frame binds them
+        VkImageView replaced = imageView;
+        imageView = VK_NULL_HANDLE;
+        createImageView(format, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels - residentLevel, residentLevel);
+        requestRewrite();
+        (*device).getBindlessHeap().updateTexture(bindlessIndex, imageView, imageSampler);
+
+        if (residentLevel == 0) {
+            streamFile.close(); // Stays registered so its bytes count against the resident budget
+        }
 
-        samplerInfo.compareEnable = VK_FALSE;
-        samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+        return replaced;
+    }
+
+    void TextureImage::loadImageToMemory(VkDeviceSize imageSize, const void* pixels)
+    {
+        if (device.wait() != Manager::State::YES) {
+			Alert("Device died before it was ready to be used.", FATAL);
+            return;
+		}
+
+        (*device).createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+        void* data;
+        vkMapMemory((*device).getDevice(), stagingBufferMemory, 0, imageSize, 0, &data);
+        memcpy(data, pixels, static_cast<size_t>(imageSize));
+        vkUnmapMemory((*device).getDevice(), stagingBufferMemory);
+    }
+
+    void TextureImage::createSampler()
+    {
+        // Streaming swaps views with more levels, so the LOD is never clamped
+        SamplerKey key{};
+        key.addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        key.maxLod = VK_LOD_CLAMP_NONE;
 
-        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-        samplerInfo.minLod = 0.0f; // "Level of detail"
-        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
-        samplerInfo.mipLodBias = 0.0f;
+        auto& samplerCache = (*device).getSamplerCache();
+        samplerCache.release(imageSampler);
 
-        if (vkCreateSampler((*device).getDevice(), &samplerInfo, nullptr, &imageSampler) != VK_SUCCESS) {
+        imageSampler = samplerCache.acquire(key);
+        if (imageSampler == VK_NULL_HANDLE) {
             Alert("Failed to create texture sampler!", FATAL);
             return;
         }
@@ -0,0 +1,176 @@
+#include "TextureStreamer.h"
+
+#include "Device.h"
+
+#include <algorithm>
+
+#define TEXTURE_STREAM_ALIGNMENT 16 // Multiple of every BC block size and of 4
+
+namespace Render
+{
+	TextureStreamer::TextureStreamer()
+	{
+	}
+
+	TextureStreamer::~TextureStreamer()
+	{
+		destroy();
+	}
+
+	void TextureStreamer::init(Device* device, TextureStreamerConfig config)
+	{
+		destroy();
+
+		this->device = device;
+		this->config = config;
+
+		workers.init(config.workerThreads);
+	}
+
+	void TextureStreamer::destroy()
+	{
+		workers.destroy();
+
+		if (device) {
+			releaseRetired(true);
+			for (auto& staging : stagingBuffers) {
+				destroyStaging(staging);
+			}
+		}
+
+		textures.clear();
+		residentBytes = 0;
+		device = nullptr;
+	}
+
+	void TextureStreamer::add(TextureImage* texture)
+	{
+		if (std::find(textures.begin(), textures.end(), texture) == textures.end()) {
+			textures.push_back(texture);
+		}
+	}
+
+	void TextureStreamer::remove(TextureImage* texture)
+	{
+		if (std::find(textures.begin(), textures.end(), texture) != textures.end()) {
+			residentBytes -= std::min(residentBytes, texture->getStreamedBytes());
+		}
+		textures.erase(std::remove(textures.begin(), textures.end(), texture), textures.end());
+	}
+
+	void TextureStreamer::retire(VkImageView view)
+	{
+		if (view != VK_NULL_HANDLE) {
+			retired.push_back({ view, MAX_FRAMES_IN_FLIGHT });
+		}
+	}
+
+	void TextureStreamer::releaseRetired(bool all)
+	{
+		for (auto it = retired.begin(); it != retired.end();) {
+			if (all || --it->framesLeft == 0) {
+				vkDestroyImageView(device->getDevice(), it->view, nullptr);
+				it = retired.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+
+	void TextureStreamer::record(VkCommandBuffer commandBuffer, uint32_t frame)
+	{
+		if (!isActive()) return;
+
+		releaseRetired(false);
+
+		std::vector<TextureImage*> queue;
+		for (auto texture : textures) {
+			if (texture->getResidentLevel() > texture->getWantedLevel()) {
+				queue.push_back(texture);
+			}
+		}
+		if (queue.empty()) return;
+
+		std::sort(queue.begin(), queue.end(), [](TextureImage* a, TextureImage* b) {
+			return a->getStreamPriority() > b->getStreamPriority();
+		});
+
+		uint32_t maxLoads = std::max(workers.getThreadCount(), 1u) * 2;
+		uint32_t loads = 0;
+		for (auto texture : queue) {
+			if (texture->isNextLevelLoading()) loads++;
+		}
+
+		VkDeviceSize offset = 0;
+		bool hasBudget = true;
+
+		for (auto texture : queue) {
+			VkDeviceSize size = texture->getNextLevelSize();
+			if (config.residentBudget != 0 && residentBytes + size > config.residentBudget) continue;
+
+			if (!texture->isNextLevelLoaded()) {
+				if (!texture->isNextLevelLoading() && loads < maxLoads) {
+					texture->loadNextLevel(workers);
+					loads++;
+				}
+				continue;
+			}
+			if (!hasBudget) continue;
+
+			VkDeviceSize start = (offset + TEXTURE_STREAM_ALIGNMENT - 1) / TEXTURE_STREAM_ALIGNMENT * TEXTURE_STREAM_ALIGNMENT;
+			if (start + size > config.uploadBudget && offset != 0) { // A level larger than the budget gets a frame to itself
+				hasBudget = false;
+				continue;
+			}
+			// Copies recorded above still read the buffer, it only grows before the frame's first upload
+			auto& staging = stagingBuffers[frame];
+			if (offset != 0 && start + size > staging.size) {
+				hasBudget = false;
+				continue;
+			}
+			if (!reserveStaging(frame, start + size)) return;
+
+			retire(texture->recordNextLevel(commandBuffer, staging.buffer, start, static_cast<char*>(staging.mapped) + start));
+
+			residentBytes += size;
+			offset = start + size;
+			hasBudget = offset < config.uploadBudget;
+		}
+	}
+
+	bool TextureStreamer::reserveStaging(uint32_t frame, VkDeviceSize size)
+	{
+		auto& staging = stagingBuffers[frame];
+		if (staging.size >= size) return true;
+
+		// Only before the frame's first upload is recorded. The previous uploads from it
+		// finished, its fence was waited on in beginFrame
+		destroyStaging(staging);
+
+		staging.size = std::max(size, config.uploadBudget);
+		device->createBuffer(staging.size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging.buffer, staging.memory);
+
+		if (staging.buffer == VK_NULL_HANDLE ||
+			vkMapMemory(device->getDevice(), staging.memory, 0, staging.size, 0, &staging.mapped) != VK_SUCCESS) {
+			Alert("Failed to create texture streaming staging buffer.", CRITICAL);
+			staging.mapped = nullptr;
+			destroyStaging(staging);
+			return false;
+		}
+		return true;
+	}
+
+	void TextureStreamer::destroyStaging(StagingBuffer& staging)
+	{
+		if (staging.buffer != VK_NULL_HANDLE) {
+			vkDestroyBuffer(device->getDevice(), staging.buffer, nullptr);
+		}
+		if (staging.memory != VK_NULL_HANDLE) {
+			if (staging.mapped != nullptr) vkUnmapMemory(device->getDevice(), staging.memory);
+			vkFreeMemory(device->getDevice(), staging.memory, nullptr);
+		}
+		staging = {};
+	}
+}
@@ -4,6 +4,8 @@
 
 #include "Device.h"
 
+#include <array>
+
 namespace Render
 {
 	Uniform::Uniform()
@@ -19,11 +21,27 @@ namespace Render
 	{
 		device = Request<Device>(deviceUUID, "self");
 		createUniforms();
+
+		markDirty(); // New buffers hold nothing yet
 	}
 
 	void Uniform::destroy()
 	{
 		if (device) {
+			if (bindlessIndex != BINDLESS_INVALID_INDEX) {
+				(*device).getBindlessHeap().removeBuffer(bindlessIndex);
+				bindlessIndex = BINDLESS_INVALID_INDEX;
+			}
+
+			if (inRing) {
+				(*device).getUniformRing().free(ringOffset, sizeof(UniformData));
+				inRing = false;
+
+				uniforms.clear();
+				uniformsMemory.clear();
+				uniformsMapped.clear();
+			}
+
 			for (size_t i = 0; i < uniforms.size(); i++) {
 				vkDestroyBuffer((*device).getDevice(), uniforms[i], nullptr);
 				uniforms[i] = VK_NULL_HANDLE;
@@ -39,6 +57,14 @@ namespace Render
 		memcpy(uniformsMapped[frame], &buffer, sizeof(buffer));
 	}
 
+	bool Uniform::getDynamicOffset(int frame, uint32_t& offset)
+	{
+		if (!inRing) return false;
+
+		offset = static_cast<uint32_t>((*device).getUniformRing().getFrameOffset(frame) + ringOffset);
+		return true;
+	}
+
 	void Uniform::createUniforms()
 	{
 		VkDeviceSize bufferSize = sizeof(buffer);
@@ -51,15 +77,41 @@ namespace Render
 			Alert("Device died before it was ready to be used.", FATAL);
 			return;
 		}
+		// The bindless heap reads every buffer as a storage buffer
+		auto& bindlessHeap = (*device).getBindlessHeap();
+
+		// Same slice in every frame's region, no buffers of our own
+		auto& ring = (*device).getUniformRing();
+		if (ring.isActive() && ring.allocate(bufferSize, ringOffset)) {
+			inRing = true;
+
+			std::array<VkDeviceSize, MAX_FRAMES_IN_FLIGHT> offsets;
+			for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+				uniforms[i] = ring.getBuffer();
+				uniformsMemory[i] = VK_NULL_HANDLE;
+				uniformsMapped[i] = ring.getMapped(i, ringOffset);
+				offsets[i] = ring.getFrameOffset(i) + ringOffset;
+			}
+
+			bindlessIndex = bindlessHeap.addBuffer(uniforms.data(), bufferSize, offsets.data());
+			return;
+		}
+
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+		if (bindlessHeap.isActive()) usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			(*device).createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniforms[i], uniformsMemory[i]);
+			(*device).createBuffer(bufferSize, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniforms[i], uniformsMemory[i]);
 
 			vkMapMemory((*device).getDevice(), uniformsMemory[i], 0, bufferSize, 0, &uniformsMapped[i]);
 		}
+
+		bindlessIndex = bindlessHeap.addBuffer(uniforms.data(), bufferSize);
 	}
 
 	VkWriteDescriptorSet Uniform::createWrite(int frame, VkDescriptorSet& descriptorSet)
 	{
+		// Dynamic descriptors add the offset from getDynamicOffset() at bind time
 		bufferInfo.buffer = uniforms[frame];
 		bufferInfo.offset = 0;
 		bufferInfo.range = sizeof(UniformData);
@@ -69,7 +121,7 @@ namespace Render
 		descriptorWrite.dstSet = descriptorSet;
 		descriptorWrite.dstBinding = 0;
 		descriptorWrite.dstArrayElement = 0;
-		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		descriptorWrite.descriptorType = inRing ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		descriptorWrite.descriptorCount = 1;
 		descriptorWrite.pBufferInfo = &bufferInfo;
 		descriptorWrite.pImageInfo = nullptr; // Optional
@@ -0,0 +1,112 @@
+#include "UniformRing.h"
+
+#include "Device.h"
+
+#include <algorithm>
+
+namespace Render
+{
+	UniformRing::UniformRing()
+	{
+	}
+
+	UniformRing::~UniformRing()
+	{
+		destroy();
+	}
+
+	void UniformRing::init(Device* device, VkDeviceSize frameSize)
+	{
+		destroy();
+
+		this->device = device;
+
+		// Bindless reads the same slices as storage buffers
+		auto& limits = device->getProperties().limits;
+		alignment = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 1);
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+		if (device->getBindlessHeap().isActive()) {
+			alignment = std::max<VkDeviceSize>(alignment, limits.minStorageBufferOffsetAlignment);
+			usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		}
+
+		this->frameSize = align(frameSize);
+
+		device->createBuffer(this->frameSize * MAX_FRAMES_IN_FLIGHT, usage,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, memory);
+
+		if (buffer == VK_NULL_HANDLE ||
+			vkMapMemory(device->getDevice(), memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+			Alert("Failed to create the uniform ring buffer.", CRITICAL);
+			mapped = nullptr;
+			destroy();
+			return;
+		}
+	}
+
+	void UniformRing::destroy()
+	{
+		if (device) {
+			if (mapped != nullptr) {
+				vkUnmapMemory(device->getDevice(), memory);
+				mapped = nullptr;
+			}
+			if (buffer != VK_NULL_HANDLE) {
+				vkDestroyBuffer(device->getDevice(), buffer, nullptr);
+				buffer = VK_NULL_HANDLE;
+			}
+			if (memory != VK_NULL_HANDLE) {
+				vkFreeMemory(device->getDevice(), memory, nullptr);
+				memory = VK_NULL_HANDLE;
+			}
+		}
+
+		freeSlices.clear();
+		head = 0;
+		used = 0;
+		frameSize = 0;
+		device = nullptr;
+	}
+
+	bool UniformRing::allocate(VkDeviceSize size, VkDeviceSize& offset)
+	{
+		if (!isActive()) return false;
+
+		size = align(size);
+
+		// Uniforms are nearly all the same size, an exact fit is the common case
+		auto it = std::find_if(freeSlices.begin(), freeSlices.end(), [size](const Slice& slice) { return slice.size >= size; });
+		if (it != freeSlices.end()) {
+			offset = it->offset;
+			if (it->size > size) {
+				it->offset += size;
+				it->size -= size;
+			}
+			else {
+				freeSlices.erase(it);
+			}
+			used += size;
+			return true;
+		}
+
+		if (head + size > frameSize) {
+			Alert("Uniform ring is full, raise DeviceConfig::uniformRingSize.", CRITICAL);
+			return false;
+		}
+
+		offset = head;
+		head += size;
+		used += size;
+		return true;
+	}
+
+	void UniformRing::free(VkDeviceSize offset, VkDeviceSize size)
+	{
+		if (!isActive()) return;
+
+		// Each frame only writes its own region after its fence, a slice can be reused right away
+		size = align(size);
+		freeSlices.push_back({ offset, size });
+		used -= std::min(used, size);
+	}
+}
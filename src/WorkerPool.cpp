@@ -0,0 +1,79 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+namespace Render
+{
+	WorkerPool::WorkerPool()
+	{
+	}
+
+	WorkerPool::~WorkerPool()
+	{
+		destroy();
+	}
+
+	void WorkerPool::init(uint32_t threadCount)
+	{
+		destroy();
+
+		if (threadCount == 0) {
+			threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+		}
+
+		stopping = false;
+		for (uint32_t i = 0; i < threadCount; i++) {
+			threads.emplace_back(&WorkerPool::run, this);
+		}
+	}
+
+	void WorkerPool::destroy()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		condition.notify_all();
+
+		for (auto& thread : threads) {
+			if (thread.joinable()) thread.join();
+		}
+		threads.clear();
+	}
+
+	std::future<void> WorkerPool::submit(std::function<void()> job)
+	{
+		std::packaged_task<void()> task(std::move(job));
+		auto future = task.get_future();
+
+		if (threads.empty()) { // Not initialized, run inline
+			task();
+			return future;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push(std::move(task));
+		}
+		condition.notify_one();
+
+		return future;
+	}
+
+	void WorkerPool::run()
+	{
+		while (true) {
+			std::packaged_task<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+				if (jobs.empty()) return; // Stopping and drained
+
+				task = std::move(jobs.front());
+				jobs.pop();
+			}
+			task();
+		}
+	}
+}